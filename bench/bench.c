@@ -0,0 +1,401 @@
+//
+// Created by morten on 27.10.17.
+//
+
+/*
+ *  Benchmark:
+ *      Generates a synthetic tree (size, depth, fanout and string/integer ratio are configurable)
+ *      and times the API on it- throughput and latency percentiles per operation.
+ *
+ *      Results are written as JSON (file given by -j, or stdout), a summary goes to stderr.
+ *      Enumerate prints its output- stdout is sent to /dev/null meanwhile.
+ *
+ *  Usage: bench [-n leaves] [-d depth] [-f fanout] [-s string percent] [-m operations] [-r seed] [-a] [-c] [-t] [-j file]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "tree.h"
+
+// Defines length of generated keys (incl. terminator)
+#define KEYLENGTH 24
+
+// Benchmark settings
+typedef struct _CONFIG {
+    unsigned long   leaves;             // Value holding nodes
+    unsigned long   depth;              // Levels of parents below root
+    unsigned long   fanout;             // Children of each parent (deepest parents hold the leaves)
+    unsigned long   strings;            // Percent of leaves holding strings
+    unsigned long   operations;         // Operations per lookup/update benchmark
+    unsigned long   seed;
+    unsigned int    options;            // InitTreeEx options
+    const char      *json;              // Results file (NULL for stdout)
+} CONFIG;
+
+// Generated workload
+typedef struct _WORKLOAD {
+    char            *parents;           // Keys of parents (KEYLENGTH each, level by level)
+    unsigned long   numParents,
+                    firstDeepest;       // First parent of deepest level
+    char            *leaves;            // Keys of leaves (KEYLENGTH each)
+    unsigned long   *picks;             // Random leaves picked for operations
+} WORKLOAD;
+
+// Timings of one operation
+typedef struct _RESULT {
+    const char      *name;
+    unsigned long   ops;
+    double          seconds;            // Total (incl. timer overhead)
+    unsigned long   *latencies;         // Nanoseconds per op (sorted when reported)
+} RESULT;
+
+static unsigned long state;
+
+// Pseudo random number (xorshift, reproducible by seed)
+static unsigned long Random() {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// Nanoseconds of monotonic clock
+static unsigned long Now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (unsigned long) time.tv_sec * 1000000000UL + (unsigned long) time.tv_nsec;
+}
+
+// Key of leaf (even leaves below string percent hold strings)
+#define LEAF(workload, i)       (&(workload)->leaves[(i) * KEYLENGTH])
+#define PARENT(workload, i)     (&(workload)->parents[(i) * KEYLENGTH])
+#define ISSTRING(config, i)     ((((i) * 7919) % 100) < (config)->strings)
+
+// Generate keys of parents and leaves (keys are unique across tree)
+static int Generate(const CONFIG *config, WORKLOAD *workload) {
+    unsigned long level, width = 1, i;
+
+    // Parents level by level (fanout^1 + ... + fanout^depth)
+    workload->numParents = 0;
+    for (level = 0; level < config->depth; ++level) {
+        width *= config->fanout;
+        workload->numParents += width;
+    }
+    workload->firstDeepest = workload->numParents - ((config->depth) ? (width) : (0));
+
+    workload->parents = malloc (KEYLENGTH * (workload->numParents + 1));
+    workload->leaves = malloc (KEYLENGTH * config->leaves);
+    workload->picks = malloc (sizeof(unsigned long) * config->operations);
+    if (!workload->parents || !workload->leaves || !workload->picks) {
+        fprintf(stderr, "\nBench error: allocating memory failed!\n");
+        return ERROR;
+    }
+
+    for (i = 0; i < workload->numParents; ++i) {
+        snprintf(PARENT(workload, i), KEYLENGTH, "p%lu", i);
+    }
+    for (i = 0; i < config->leaves; ++i) {
+        snprintf(LEAF(workload, i), KEYLENGTH, "k%lu", i);
+    }
+    for (i = 0; i < config->operations; ++i) {
+        workload->picks[i] = Random() % config->leaves;
+    }
+    return OK;
+}
+
+// Parent key of parent i (root for first level)
+static char *ParentOf(const CONFIG *config, const WORKLOAD *workload, const unsigned long i) {
+    return (i < config->fanout) ? ("root") : (PARENT(workload, i / config->fanout - 1));
+}
+
+// Parent key of leaf i (spread over deepest parents)
+static char *LeafParent(const CONFIG *config, const WORKLOAD *workload, const unsigned long i) {
+    if (!config->depth) {
+        return "root";
+    }
+    return PARENT(workload, workload->firstDeepest + i % (workload->numParents - workload->firstDeepest));
+}
+
+// Start timing operation
+static int Begin(RESULT *result, const char *name, const unsigned long ops) {
+    result->name = name;
+    result->ops = ops;
+    result->latencies = malloc (sizeof(unsigned long) * ((ops) ? (ops) : (1)));
+    if (!result->latencies) {
+        fprintf(stderr, "\nBench error: allocating memory failed!\n");
+        return ERROR;
+    }
+    return OK;
+}
+
+// Compare latencies (for qsort)
+static int CompareLatency(const void *x, const void *y) {
+    unsigned long a = *(const unsigned long *) x,
+                  b = *(const unsigned long *) y;
+    return (a > b) - (a < b);
+}
+
+// Latency at percentile (latencies must be sorted)
+static unsigned long Percentile(const RESULT *result, const double percentile) {
+    unsigned long i = (unsigned long) (percentile / 100.0 * (double) result->ops);
+    return (result->ops) ? (result->latencies[(i < result->ops) ? (i) : (result->ops - 1)]) : (0);
+}
+
+// Write results as JSON
+static void Report(FILE *file, const CONFIG *config, RESULT *results, const unsigned long numResults) {
+    unsigned long i;
+
+    fprintf(file, "{\n  \"config\": {\"leaves\": %lu, \"depth\": %lu, \"fanout\": %lu, \"stringPercent\": %lu, "
+                  "\"operations\": %lu, \"seed\": %lu, \"arena\": %s, \"concurrent\": %s, \"art\": %s, \"keyInline\": %d},\n"
+                  "  \"results\": [\n",
+            config->leaves, config->depth, config->fanout, config->strings, config->operations, config->seed,
+            (config->options & TREEARENA) ? ("true") : ("false"),
+            (config->options & TREECONCURRENT) ? ("true") : ("false"),
+            (config->options & TREEART) ? ("true") : ("false"), KEYINLINE);
+
+    for (i = 0; i < numResults; ++i) {
+        RESULT *result = &results[i];
+        qsort(result->latencies, result->ops, sizeof(unsigned long), CompareLatency);
+
+        fprintf(file, "    {\"op\": \"%s\", \"ops\": %lu, \"seconds\": %.6f, \"opsPerSecond\": %.0f, "
+                      "\"p50Ns\": %lu, \"p90Ns\": %lu, \"p99Ns\": %lu, \"p999Ns\": %lu, \"maxNs\": %lu}%s\n",
+                result->name, result->ops, result->seconds,
+                (result->seconds > 0) ? ((double) result->ops / result->seconds) : (0.0),
+                Percentile(result, 50), Percentile(result, 90), Percentile(result, 99), Percentile(result, 99.9),
+                (result->ops) ? (result->latencies[result->ops - 1]) : (0), (i + 1 < numResults) ? (",") : (""));
+
+        fprintf(stderr, "%-20s %10lu ops %12.0f ops/s   p50 %8lu ns   p99 %8lu ns   max %10lu ns\n",
+                result->name, result->ops, (result->seconds > 0) ? ((double) result->ops / result->seconds) : (0.0),
+                Percentile(result, 50), Percentile(result, 99), (result->ops) ? (result->latencies[result->ops - 1]) : (0));
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+// Time a single call per op- wraps statement in clock reads
+#define TIMED(result, op, statement) do {           \
+        unsigned long start_ = Now();               \
+        statement;                                  \
+        (result)->latencies[op] = Now() - start_;   \
+    } while (0)
+
+int main(int argc, char **argv) {
+    CONFIG config = { .leaves = 100000, .depth = 2, .fanout = 16, .strings = 50,
+                      .operations = 100000, .seed = 42, .options = 0, .json = NULL };
+    int option;
+
+    while ((option = getopt(argc, argv, "n:d:f:s:m:r:actj:")) != -1) {
+        switch (option) {
+            case 'n': config.leaves = strtoul(optarg, NULL, 10); break;
+            case 'd': config.depth = strtoul(optarg, NULL, 10); break;
+            case 'f': config.fanout = strtoul(optarg, NULL, 10); break;
+            case 's': config.strings = strtoul(optarg, NULL, 10); break;
+            case 'm': config.operations = strtoul(optarg, NULL, 10); break;
+            case 'r': config.seed = strtoul(optarg, NULL, 10); break;
+            case 'a': config.options |= TREEARENA; break;
+            case 'c': config.options |= TREECONCURRENT; break;
+            case 't': config.options |= TREEART; break;
+            case 'j': config.json = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n leaves] [-d depth] [-f fanout] [-s string percent] "
+                                "[-m operations] [-r seed] [-a] [-c] [-t] [-j file]\n", argv[0]);
+                return ERROR;
+        }
+    }
+    if (!config.leaves || !config.fanout || config.strings > 100) {
+        fprintf(stderr, "\nBench error: leaves and fanout must be above 0, string percent at most 100.\n");
+        return ERROR;
+    }
+
+    state = (config.seed) ? (config.seed) : (1);
+    WORKLOAD workload;
+    if (Generate(&config, &workload) != OK) {
+        return ERROR;
+    }
+
+    RESULT results[10];
+    unsigned long numResults = 0, i, total;
+    char value[64],
+         fileName[] = "/tmp/benchXXXXXX";
+    NODE *root = InitTreeEx(config.options);
+    if (!root) {
+        return ERROR;
+    }
+
+    // Parents (not timed)
+    for (i = 0; i < workload.numParents; ++i) {
+        AddNode(&root, ParentOf(&config, &workload, i), PARENT(&workload, i));
+    }
+
+    // AddNode (leaves)
+    RESULT *result = &results[numResults++];
+    if (Begin(result, "AddNode", config.leaves) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    for (i = 0; i < config.leaves; ++i) {
+        TIMED(result, i, AddNode(&root, LeafParent(&config, &workload, i), LEAF(&workload, i)));
+    }
+    result->seconds = (double) (Now() - total) / 1e9;
+
+    // Values (not timed)
+    for (i = 0; i < config.leaves; ++i) {
+        if (ISSTRING(&config, i)) {
+            snprintf(value, sizeof(value), "value of %lu", i);
+            SetString(&root, LEAF(&workload, i), value);
+        }
+        else {
+            SetInt(&root, LEAF(&workload, i), i);
+        }
+    }
+
+    // Picks of each type (leaf i is a string leaf or an integer leaf)
+    unsigned long *integers = malloc (sizeof(unsigned long) * config.operations),
+                  *strings = malloc (sizeof(unsigned long) * config.operations),
+                  numIntegers = 0,
+                  numStrings = 0;
+    if (!integers || !strings) {
+        fprintf(stderr, "\nBench error: allocating memory failed!\n");
+        return ERROR;
+    }
+    for (i = 0; i < config.operations; ++i) {
+        if (ISSTRING(&config, workload.picks[i])) {
+            strings[numStrings++] = workload.picks[i];
+        }
+        else {
+            integers[numIntegers++] = workload.picks[i];
+        }
+    }
+
+    // GetInt (values are summed, so lookups can't be optimized away)
+    volatile unsigned long sum = 0;
+    result = &results[numResults++];
+    if (Begin(result, "GetInt", numIntegers) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    for (i = 0; i < numIntegers; ++i) {
+        TIMED(result, i, sum += GetInt(&root, LEAF(&workload, integers[i])));
+    }
+    result->seconds = (double) (Now() - total) / 1e9;
+
+    // GetString
+    result = &results[numResults++];
+    if (Begin(result, "GetString", numStrings) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    for (i = 0; i < numStrings; ++i) {
+        TIMED(result, i, sum += (unsigned long) GetString(&root, LEAF(&workload, strings[i]))[0]);
+    }
+    result->seconds = (double) (Now() - total) / 1e9;
+
+    // SetString
+    result = &results[numResults++];
+    if (Begin(result, "SetString", numStrings) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    for (i = 0; i < numStrings; ++i) {
+        TIMED(result, i, SetString(&root, LEAF(&workload, strings[i]), (i & 1) ? ("odd value") : ("an even longer value")));
+    }
+    result->seconds = (double) (Now() - total) / 1e9;
+
+    // Enumerate (each deepest parent, output discarded)
+    unsigned long numEnumerated = (config.depth) ? (workload.numParents - workload.firstDeepest) : (1);
+    if (numEnumerated > config.operations) {
+        numEnumerated = config.operations;
+    }
+    result = &results[numResults++];
+    if (Begin(result, "Enumerate", numEnumerated) != OK) {
+        return ERROR;
+    }
+    fflush(stdout);
+    int out = dup(STDOUT_FILENO),
+        null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    total = Now();
+    for (i = 0; i < numEnumerated; ++i) {
+        TIMED(result, i, Enumerate(&root, (config.depth) ? (PARENT(&workload, workload.firstDeepest + i)) : ("root")));
+        fflush(stdout);
+    }
+    result->seconds = (double) (Now() - total) / 1e9;
+    dup2(out, STDOUT_FILENO);
+    close(out);
+    close(null);
+
+    // DeserializeTextFile (whole tree, one op- from snapshot of tree)
+    int file = mkstemp(fileName);
+    if (file < 0 || SerializeTextFile(&root, fileName) != OK) {
+        fprintf(stderr, "\nBench error: writing snapshot failed.\n");
+        return ERROR;
+    }
+    close(file);
+
+    NODE *loaded = InitTreeEx(config.options);
+    result = &results[numResults++];
+    if (!loaded || Begin(result, "DeserializeTextFile", 1) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    TIMED(result, 0, DeserializeTextFile(&loaded, fileName));
+    result->seconds = (double) (Now() - total) / 1e9;
+    unlink(fileName);
+
+    // Delete (distinct leaves, already deleted picks are skipped)
+    char *deleted = calloc (config.leaves, 1);
+    if (!deleted) {
+        return ERROR;
+    }
+    unsigned long numDeleted = 0;
+    result = &results[numResults++];
+    if (Begin(result, "Delete", config.operations) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    for (i = 0; i < config.operations; ++i) {
+        unsigned long leaf = workload.picks[i];
+        if (!deleted[leaf]) {
+            deleted[leaf] = TRUE;
+            TIMED(result, numDeleted, Delete(&root, LEAF(&workload, leaf)));
+            numDeleted++;
+        }
+    }
+    result->seconds = (double) (Now() - total) / 1e9;
+    result->ops = numDeleted;
+
+    // DeinitTree (whole tree, one op- loaded tree is full size)
+    result = &results[numResults++];
+    if (Begin(result, "DeinitTree", 1) != OK) {
+        return ERROR;
+    }
+    total = Now();
+    TIMED(result, 0, DeinitTree(&loaded));
+    result->seconds = (double) (Now() - total) / 1e9;
+    DeinitTree(&root);
+
+    // Report
+    FILE *json = (config.json) ? (fopen(config.json, "w")) : (stdout);
+    if (!json) {
+        fprintf(stderr, "\nBench error: problem creating file '%s'.\n", config.json);
+        return ERROR;
+    }
+    Report(json, &config, results, numResults);
+    if (json != stdout) {
+        fclose(json);
+    }
+
+    for (i = 0; i < numResults; ++i) {
+        free(results[i].latencies);
+    }
+    free(integers);
+    free(strings);
+    free(deleted);
+    free(workload.parents);
+    free(workload.leaves);
+    free(workload.picks);
+    return OK;
+}
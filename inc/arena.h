@@ -0,0 +1,63 @@
+/*********************************************************************
+ * Filename:    arena.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API for the per-tree arena allocator
+*********************************************************************/
+
+#ifndef N_ARENA
+#define N_ARENA
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+
+/************************* MACROS & DEFINES *************************/
+// Size of chunks handed out by bump allocation
+#define ARENACHUNK      (1024 * 1024)
+
+// Allocations are aligned (and small size classes spaced) by this many bytes
+#define ARENAALIGN      16
+
+// Largest small size class (small classes are multiples of ARENAALIGN, fits fixed-size nodes exactly)
+#define ARENASMALL      256
+
+// Largest size class (above small, classes are powers of two- above this, blocks are allocated one by one)
+#define ARENALARGE      (64 * 1024)
+
+// Number of size classes (small classes + power of two classes)
+#define ARENACLASSES    (ARENASMALL / ARENAALIGN + 8)
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Arena:
+ *      Nodes, keys, strings and children of a tree are carved out of large chunks by bumping a cursor.
+ *      Freed memory goes to a free list per size class and is reused by the next allocation of that class.
+ *      Sizes are not stored with allocations- callers hand the size back when freeing (it's always known).
+ *      Destroying the arena releases every chunk at once, rather than every allocation one by one.
+ */
+
+// Arena of chunks, free lists and oversized blocks
+typedef struct _ARENA {
+    struct  _CHUNK  *chunks;                    // Chunks (newest first)
+    char            *cursor;                    // Next free byte in newest chunk
+    size_t          left;                       // Bytes left in newest chunk
+    void            *freeLists[ARENACLASSES];   // Freed allocations per size class
+    struct  _BLOCK  *blocks;                    // Blocks above largest size class
+    unsigned long   allocated;                  // Bytes in use (rounded to size class)
+} ARENA;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+ARENA *ArenaCreate ();
+
+void ArenaDestroy (ARENA *arena);
+
+void ArenaAdopt (ARENA *arena, ARENA *other);
+
+void *ArenaAlloc (ARENA *arena, size_t size);
+
+void ArenaFree (ARENA *arena, void *memory, size_t size);
+
+void *ArenaRealloc (ARENA *arena, void *memory, size_t oldSize, size_t newSize);
+
+#endif   // N_ARENA
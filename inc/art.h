@@ -0,0 +1,98 @@
+/*********************************************************************
+ * Filename:    art.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of adaptive radix trees (full paths to nodes)
+*********************************************************************/
+
+#ifndef N_ART
+#define N_ART
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Defines number of bytes of compressed path held by inner nodes (longer paths are checked against a leaf below)
+#define ARTPREFIX 12
+
+// Leaves are tagged by lowest bit of child pointers
+#define ArtIsLeaf(child)    (((unsigned long) (child)) & 1UL)
+#define ArtLeaf(child)      ((ARTLEAF *) (((unsigned long) (child)) & ~1UL))
+#define ArtTag(leaf)        ((void *) (((unsigned long) (leaf)) | 1UL))
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Adaptive radix trees (TREEART):
+ *      Full dotted paths (excl. root key, ie. "strings.en.button_cancel") are keys, nodes of tree are values.
+ *      A path is resolved one byte per level, so lookups cost O(path length) however large the tree is.
+ *
+ *      Inner nodes grow and shrink with their children: 4 and 16 children are held as sorted keys and children,
+ *      48 as a byte per key indexing children, 256 as children only. Chains of single children are compressed into
+ *      the prefix of the node below (only ARTPREFIX bytes are kept, the rest is checked against a leaf).
+ *
+ *      Paths hold no null bytes, so every path ends in a virtual null byte- no path is a prefix of another then.
+ */
+
+// Kinds of inner nodes
+enum artType { art4, art16, art48, art256 };
+
+// Leaf (path and node)
+typedef struct _ARTLEAF {
+    NODE            *node;
+    size_t          length;
+    char            key[];
+} ARTLEAF;
+
+// Header of inner node
+typedef struct _ARTINNER {
+    unsigned char   type;               // enum artType
+    unsigned short  numChildren;
+    unsigned int    prefixLength;       // Bytes of compressed path (ARTPREFIX at most are held)
+    unsigned char   prefix[ARTPREFIX];
+} ARTINNER;
+
+typedef struct _ART4 {
+    ARTINNER        inner;
+    unsigned char   keys[4];            // Sorted
+    void            *children[4];
+} ART4;
+
+typedef struct _ART16 {
+    ARTINNER        inner;
+    unsigned char   keys[16];           // Sorted
+    void            *children[16];
+} ART16;
+
+typedef struct _ART48 {
+    ARTINNER        inner;
+    unsigned char   index[256];         // Child of key + 1       (0 if none)
+    void            *children[48];
+} ART48;
+
+typedef struct _ART256 {
+    ARTINNER        inner;
+    void            *children[256];
+} ART256;
+
+// Adaptive radix tree
+typedef struct _ART {
+    void            *root;              // Inner node or tagged leaf (NULL if empty)
+    unsigned long   size;               // Number of leaves
+} ART;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+ART *ArtCreate ();
+
+void ArtDestroy (ART *art);
+
+NODE *ArtLookup (const ART *art, const char *key, size_t length);
+
+int ArtInsert (ART *art, const char *key, size_t length, NODE *node);
+
+NODE *ArtRemove (ART *art, const char *key, size_t length);
+
+unsigned long ArtRemovePrefix (ART *art, const char *prefix, size_t length);
+
+#endif   // N_ART
@@ -0,0 +1,69 @@
+/*********************************************************************
+ * Filename:    handle.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of node handles (generation checked slots)
+*********************************************************************/
+
+#ifndef N_HANDLE
+#define N_HANDLE
+
+/*************************** HEADER FILES ***************************/
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Initial amount of slots in handle table (doubles when full)
+#define HANDLESLOTS 16
+
+// Defines max number of slots (nodes hold their slot in an unsigned short)
+#define HANDLELIMIT 65535
+
+// Compose and take apart handles (slot in low half, generation in high half)
+#define HandleOf(slot, generation)  (((HANDLE) (generation) << 32) | (HANDLE) (slot))
+#define HandleSlot(handle)          ((unsigned int) ((handle) & 0xffffffffUL))
+#define HandleGeneration(handle)    ((unsigned int) ((handle) >> 32))
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Handles:
+ *      A handle names a slot of the handle table of a tree and the generation of the slot when it was handed out.
+ *      The slot points at the node, the node holds its slot (one slot per node, however often it's resolved).
+ *      Freeing the node bumps the generation of its slot- handles handed out before no longer match and are stale.
+ *      So a handle is checked and followed in constant time, without walking keys.
+ *
+ *      Slot 0 is never used, so handle 0 is no handle (and nodes holding slot 0 have none).
+ *      Freed slots are reused, their generation tells old handles apart.
+ *
+ *      Slots are released from several threads at once when subtrees are freed in parallel, so releasing is lock free.
+ *      Taking slots is for writers only. Grown tables of concurrent trees are retired (readers may still hold the old).
+ */
+
+// Slot of handle table
+typedef struct _HANDLESLOT {
+    struct  _NODE   *node;              // Node of slot           (NULL if free)
+    unsigned int    generation;         // Bumped as node is freed
+    unsigned int    next;               // Next free slot         (0 ends list)
+} HANDLESLOT;
+
+// Handle table (one per tree, created by first ResolveHandle)
+typedef struct _HANDLES {
+    HANDLESLOT      *slots;
+    unsigned int    capacity,           // Number of slots        (incl. slot 0)
+                    used,               // Slots holding nodes
+                    free;               // First free slot        (0 if none- next is taken from capacity)
+    unsigned int    taken;              // Slots taken from capacity so far (incl. slot 0)
+} HANDLES;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+HANDLES *HandlesCreate ();
+
+void HandlesDestroy (HANDLES *handles);
+
+HANDLE HandleTake (HANDLES *handles, NODE *node, HANDLESLOT **retired);
+
+void HandleRelease (HANDLES *handles, NODE *node);
+
+NODE *HandleNode (HANDLES *handles, HANDLE handle);
+
+#endif   // N_HANDLE
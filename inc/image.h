@@ -0,0 +1,107 @@
+/*********************************************************************
+ * Filename:    image.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API and format of read-only tree images
+*********************************************************************/
+
+#ifndef N_IMAGE
+#define N_IMAGE
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include <stdint.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+#define IMAGEMAGIC      "DTKV"
+#define IMAGEVERSION    2
+
+// Marks node without string value
+#define IMAGENONE       UINT64_MAX
+
+// Defines average number of paths per bucket of perfect hash
+#define IMAGEBUCKET     4
+
+// Defines number of seeds tried per bucket before building the perfect hash is given up (paths are walked then)
+#define IMAGESEEDS      65536
+
+// Marks bucket holding a single path (rest of seed is its slot)
+#define IMAGEDIRECT     0x80000000U
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Image format (offset based, no pointers- may be mapped straight from file):
+ *      Header, node table, key slots, bucket seeds, path slots and string pool, each section aligned to 8 bytes.
+ *      Nodes are laid out in breadth first order, so children of a node are one sorted range of the table.
+ *      Key slots are an open addressing table of node indices (+1, 0 is empty) by key hash (unique keys only).
+ *
+ *      Full paths (excl. root key) are a minimal perfect hash, built once (hash and displace):
+ *      the path hash picks a bucket, the seed of the bucket picks the slot holding the node (one slot per path).
+ *      Seeds are searched largest bucket first, buckets of a single path take a free slot as is (IMAGEDIRECT).
+ *      Any path hashes to some slot, so the path is checked against the keys of the node and its parents.
+ *      Keys and strings are null terminated in the pool, so they can be handed out without copying.
+ *
+ *  Integers are stored in host byte order- images are not portable between architectures.
+ */
+
+// Image header (start of image)
+typedef struct _IMAGEHEADER {
+    char            magic[4];           // IMAGEMAGIC
+    uint32_t        version;            // IMAGEVERSION
+    uint64_t        size;               // Size of whole image
+    uint64_t        numNodes;           // Nodes in node table (root is node 0)
+    uint64_t        numSlots;           // Key slots (power of two, 0 without unique keys)
+    uint64_t        poolSize;           // Bytes in string pool
+    uint64_t        nodes;              // Offset of node table
+    uint64_t        slots;              // Offset of key slots
+    uint64_t        pool;               // Offset of string pool
+    uint64_t        numPaths;           // Path slots (nodes but root, 0 without perfect hash)
+    uint64_t        numBuckets;         // Buckets of perfect hash
+    uint64_t        buckets;            // Offset of bucket seeds
+    uint64_t        paths;              // Offset of path slots
+} IMAGEHEADER;
+
+// Image node
+typedef struct _IMAGENODE {
+    uint64_t        integer;            // Integer value
+    uint64_t        key;                // Pool offset of key
+    uint64_t        string;             // Pool offset of string value (IMAGENONE if none)
+    uint32_t        keyLength;          // Length of key
+    uint32_t        parent;             // Index of parent (root is its own parent)
+    uint32_t        firstChild;         // Index of first child
+    uint32_t        numChildren;        // Number of children
+} IMAGENODE;
+
+// Opened image
+typedef struct _IMAGE {
+    const   IMAGEHEADER *header;
+    const   IMAGENODE   *nodes;
+    const   uint32_t    *slots;
+    const   uint32_t    *buckets;
+    const   uint32_t    *paths;
+    const   char        *pool;
+    void                *memory;        // Start of image
+    size_t              size;           // Size of image
+    short int           mapped;         // Mapped from file (else allocated)
+} IMAGE;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+IMAGE *ImageBuild (NODE *root);
+
+int ImageWrite (const IMAGE *image, const char *fileName);
+
+IMAGE *ImageOpen (const char *fileName);
+
+void ImageClose (IMAGE *image);
+
+long ImageFind (const IMAGE *image, long from, const char *targetKey);
+
+long ImageFindChild (const IMAGE *image, long parent, const char *key, size_t length);
+
+long ImageFindPath (const IMAGE *image, const char *path, size_t length);
+
+enum nodeType ImageNodeType (const IMAGE *image, long node);
+
+#endif   // N_IMAGE
@@ -0,0 +1,67 @@
+/*********************************************************************
+ * Filename:    index.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API for the global key index (key -> node)
+*********************************************************************/
+
+#ifndef N_INDEX
+#define N_INDEX
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Initial amount of slots in index (must be a power of two)
+#define INDEXSLOTS 64
+
+// Marks a slot whose node has been removed (probing must continue past it)
+#define TOMBSTONE ((NODE *) 1)
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Open addressing with linear probing:
+ *      Slots and bookkeeping live in a single allocation, so replacing the whole index is one pointer store.
+ *      Removed slots are marked as tombstones rather than shifted, entries never move until the index is rebuilt.
+ */
+
+// Index slot (hash is cached to avoid strcmp on mismatches)
+typedef struct _INDEXSLOT {
+    unsigned long   hash;               // Hash of node key
+    struct  _NODE   *node;              // Indexed node (NULL if empty, TOMBSTONE if removed)
+} INDEXSLOT;
+
+// Index of keys to nodes
+typedef struct _INDEX {
+    unsigned long   capacity;           // Number of slots (power of two)
+    unsigned long   used;               // Slots holding nodes
+    unsigned long   tombstones;         // Slots holding tombstones
+    INDEXSLOT       slots[];            // Slots
+} INDEX;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+unsigned long HashKey (const char *key);
+
+unsigned long HashKeyLength (const char *key, size_t length);
+
+unsigned long HashKeyMore (unsigned long hash, const char *key, size_t length);
+
+INDEX *IndexCreate (unsigned long capacity);
+
+void IndexDestroy (INDEX *index);
+
+int IndexInsert (INDEX **index, NODE *node, INDEX **retired);
+
+int IndexReserve (INDEX **index, unsigned long count, INDEX **retired);
+
+int IndexPlaceRange (INDEX *index, NODE *node, unsigned long hash, unsigned long end);
+
+int IndexRemove (INDEX *index, const NODE *node);
+
+NODE *IndexLookup (const INDEX *index, const char *key);
+
+NODE *IndexLookupLength (const INDEX *index, const char *key, size_t length);
+
+#endif   // N_INDEX
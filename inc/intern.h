@@ -0,0 +1,67 @@
+/*********************************************************************
+ * Filename:    intern.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of string pools (interned keys and strings)
+*********************************************************************/
+
+#ifndef N_INTERN
+#define N_INTERN
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Initial amount of slots in pool (must be a power of two)
+#define INTERNSLOTS 256
+
+// Marks a slot whose string has been released (probing must continue past it)
+#define RELEASED ((INTERNED *) 1)
+
+// Interned string holding text (text is what the pool hands out)
+#define InternOf(string) ((INTERNED *) ((char *) (string) - offsetof(INTERNED, text)))
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  String pools (TREEINTERN):
+ *      Every distinct string is held once, by as many nodes as use it (as key or as value), and is never changed.
+ *      Setting a string takes a reference to the pooled copy, releasing or replacing it drops the reference.
+ *      The string goes with its last holder- on concurrent trees it's retired like other tree memory.
+ *
+ *      Text is handed out as is (null terminated), the hash and the length are kept in front of it.
+ *      So two pooled strings are equal if and only if their pointers are.
+ *
+ *      Keys shorter than KEYINLINE stay inside their node (no allocation, nothing to share).
+ *      Pools are open addressing with linear probing, as the index.
+ */
+
+// Interned string
+typedef struct _INTERNED {
+    unsigned long   refs;               // Holders of string      (keys and values)
+    unsigned long   hash;               // Hash of text           (HashKey)
+    size_t          length;
+    char            text[];
+} INTERNED;
+
+// Pool of interned strings (one per tree)
+typedef struct _INTERN {
+    INTERNED        **slots;            // Strings                (NULL if empty, RELEASED if released)
+    unsigned long   capacity,           // Number of slots        (power of two)
+                    used,               // Slots holding strings
+                    released;           // Slots holding RELEASED
+    unsigned long   holders;            // References held        (strings not copied are holders - used)
+    size_t          bytes;              // Bytes of strings held  (incl. terminators)
+} INTERN;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+INTERN *InternCreate ();
+
+void InternDestroy (INTERN *intern);
+
+char *InternString (INTERN *intern, const char *string, size_t length);
+
+void *InternRelease (INTERN *intern, const char *text);
+
+#endif   // N_INTERN
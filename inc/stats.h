@@ -0,0 +1,106 @@
+/*********************************************************************
+ * Filename:    stats.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of operation statistics (counters and latencies)
+*********************************************************************/
+
+#ifndef N_STATS
+#define N_STATS
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Defines if operations are counted (FALSE compiles counting out)
+#define STATS TRUE
+
+// Defines how often latencies are sampled (every STATSAMPLE-th operation of a thread is timed, power of two)
+#define STATSAMPLE 16
+
+// Defines number of buckets of histograms (see STATCOUNTERS)
+#define STATBUCKETS 32
+
+// Start counted operation (returns start time if operation is sampled, else 0)
+#define StatBegin(op)                   ((STATS == TRUE) ? (StatsBegin(op)) : (0))
+
+// End counted operation (failed is TRUE if operation failed)
+#define StatEnd(op, started, failed)    do { if (STATS == TRUE) { StatsEnd((op), (started), (failed)); } } while (0)
+
+// Count nodes visited by a search
+#define StatVisited(visited)            do { if (STATS == TRUE) { StatsVisited(visited); } } while (0)
+
+// Count bytes of tree memory allocated and freed (reallocated is TRUE for reallocations)
+#define StatMemory(allocated, freed, reallocated) \
+    do { if (STATS == TRUE) { StatsMemory((allocated), (freed), (reallocated)); } } while (0)
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Statistics:
+ *      Every thread counts into counters of its own (no atomics, no shared cache lines on the hot path).
+ *      Counters are summed on demand (GetTreeStats)- counters of threads that have exited are kept in a total.
+ *      Counters are process wide, all trees count into them.
+ *
+ *      Every operation is counted, every STATSAMPLE-th operation of each kind of a thread is timed as well.
+ *      Searches count every search, incl. those made by other operations (Get*, Set*, Delete, ...).
+ *
+ *      Histograms are log2 buckets: bucket b counts values of b significant bits (0 in bucket 0, 1 in 1, 2-3 in 2,
+ *      4-7 in 3, ...), the last bucket counts every larger value as well.
+ */
+
+// Counted operations
+enum statOp { statSearch, statAdd, statDelete, statGet, statSet, STATOPS };
+
+// Counters of operation
+typedef struct _STATOP {
+    unsigned long   calls,
+                    failures,           // Calls returning an error (Get* returning nothing- GetInt can't tell 0 apart)
+                    timed,              // Calls sampled
+                    nanoseconds,        // Time of calls sampled
+                    latency[STATBUCKETS];   // Nanoseconds per call sampled
+} STATOP;
+
+// Counters (unsigned longs only- they're summed as an array)
+typedef struct _STATCOUNTERS {
+    STATOP          ops[STATOPS];       // By enum statOp
+    unsigned long   searches,           // Searches made          (all, see above)
+                    visited,            // Nodes visited by searches
+                    visits[STATBUCKETS],    // Nodes visited per search
+                    reallocs,           // Reallocations of tree memory (children, strings, search results)
+                    allocated,          // Bytes of tree memory allocated (pooled strings are counted by pool)
+                    freed;              // Bytes of tree memory freed
+} STATCOUNTERS;
+
+// Statistics of tree (see GetTreeStats)
+struct _TREESTATS {
+    STATCOUNTERS    counters;           // Operations             (process wide)
+    unsigned long   nodes,              // Nodes of tree          (incl. root)
+                    leaves,
+                    depth,              // Depth of deepest node  (root is 0)
+                    fanout,             // Most children of a node
+                    depths[STATBUCKETS],    // Nodes by depth         (deeper nodes in last)
+                    fanouts[STATBUCKETS];   // Parents by number of children
+    unsigned long   indexed,            // Keys indexed           (unique keys)
+                    slots,              // Slots of index
+                    paths,              // Paths in radix tree    (if TREEART, or perfect hash if frozen)
+                    interned,           // Strings pooled         (if TREEINTERN)
+                    holders;            // Nodes holding pooled strings (strings not copied are holders - interned)
+    size_t          pooled;             // Bytes of strings pooled
+};
+
+/*********************** FUNCTION DECLARATIONS **********************/
+unsigned long StatsBegin (enum statOp op);
+
+void StatsEnd (enum statOp op, unsigned long started, short int failed);
+
+void StatsVisited (unsigned long visited);
+
+void StatsMemory (size_t allocated, size_t freed, short int reallocated);
+
+void StatsCollect (STATCOUNTERS *total);
+
+unsigned int StatsBucket (unsigned long value);
+
+#endif   // N_STATS
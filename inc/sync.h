@@ -0,0 +1,95 @@
+/*********************************************************************
+ * Filename:    sync.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API for concurrent trees (lock free readers, epoch based reclamation)
+*********************************************************************/
+
+#ifndef N_SYNC
+#define N_SYNC
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include <pthread.h>
+
+/************************* MACROS & DEFINES *************************/
+// Number of reader slots (threads reading at once- further readers wait for a free slot)
+#define READERSLOTS     128
+
+// Number of trees a thread may have pinned at once
+#define PINLIMIT        8
+
+// Size of a cache line (reader slots are kept apart to avoid false sharing)
+#define CACHELINE       64
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Concurrent trees:
+ *      Writers are serialized by a (recursive) mutex and bump a sequence number when they start and end.
+ *      Readers take no locks- they note the sequence, read, and retry if a writer got in between (seqlock).
+ *      A reader finding a write section open yields until it's closed, so readers wait out a section however long.
+ *
+ *      Memory is never freed while readers might still see it, it's retired and freed later (epochs):
+ *          Readers pin the global epoch in a slot of their own while reading.
+ *          Memory retired in an epoch is freed once every pinned slot shows a later epoch.
+ *      So a reader may follow any pointer it has read, even if a writer has unlinked the memory since.
+ */
+
+// Release retired memory (context is handed to SyncWriteEnd and SyncDestroy)
+typedef void (*RELEASE)(void *context, void *memory, size_t size);
+
+// Reader slot (one cache line each)
+typedef struct _READERSLOT {
+    unsigned long   claimed;            // Slot is held by a thread
+    unsigned long   epoch;              // Epoch pinned by thread (0 if not reading)
+    char            pad[CACHELINE - 2 * sizeof(unsigned long)];
+} READERSLOT;
+
+// Retired memory
+typedef struct _RETIRED {
+    void            *memory;
+    size_t          size;
+    unsigned long   epoch;              // Epoch memory was retired in
+    RELEASE         release;
+} RETIRED;
+
+// Concurrency state of tree
+typedef struct _SYNC {
+    unsigned long   sequence;           // Odd while a write section is open
+    unsigned long   epoch;              // Global epoch (starts at 1)
+    char            pad[CACHELINE - 2 * sizeof(unsigned long)];
+    READERSLOT      readers[READERSLOTS];
+    pthread_mutex_t writer;             // Serializes writers (recursive- API calls nest)
+    unsigned long   depth;              // Nested write sections
+    RETIRED         *retired;           // Retired memory (oldest first)
+    unsigned long   numRetired,
+                    capRetired;
+} SYNC;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+SYNC *SyncCreate ();
+
+void SyncDestroy (SYNC *sync, void *context);
+
+int SyncPin (SYNC *sync);
+
+void SyncUnpin (SYNC *sync);
+
+unsigned long SyncReadBegin (const SYNC *sync);
+
+int SyncReadValid (const SYNC *sync, unsigned long sequence);
+
+void SyncLock (SYNC *sync);
+
+void SyncUnlock (SYNC *sync);
+
+void SyncWriteBegin (SYNC *sync);
+
+void SyncWriteEnd (SYNC *sync, void *context);
+
+int SyncRetire (SYNC *sync, void *memory, size_t size, RELEASE release);
+
+void SyncReclaim (SYNC *sync, void *context);
+
+#endif   // N_SYNC
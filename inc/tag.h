@@ -0,0 +1,45 @@
+/*********************************************************************
+ * Filename:    tag.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of child tags (key hash bytes matched many at once)
+*********************************************************************/
+
+#ifndef N_TAG
+#define N_TAG
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Defines min and max number of children scanned by tags (other parents binary search their keys- cheaper then)
+#define TAGMIN 8
+#define TAGSCAN 1024
+
+// Tag of key hash (low byte of cached hash- keys differing in their last bytes differ in low bits only)
+#define TagOf(hash)         ((unsigned char) (hash))
+
+// Tags of children (held after children, one per child allocated)
+#define NodeTags(node)      ((unsigned char *) &(node)->children[(node)->capChildren])
+
+// Bytes of children allocated with their tags
+#define ChildrenSize(capacity) ((sizeof(NODE *) + 1) * (size_t) (capacity))
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Child tags:
+ *      Every parent keeps a byte of the key hash of each child, in the order of its children.
+ *      A key is looked up by matching its tag against 16 (SSE2) or 32 (AVX2) tags at once, keys are only compared
+ *      on matching tags. So most children are rejected without leaving the parent (1 in 256 matches by chance).
+ *
+ *      Scanning is linear- parents holding more than TAGSCAN children binary search their sorted keys instead,
+ *      as do parents holding TAGMIN children or less (hashing the key costs more than the few compares).
+ *      Builds without SSE2 match one tag at a time.
+ */
+
+/*********************** FUNCTION DECLARATIONS **********************/
+unsigned int TagMatch (const unsigned char *tags, unsigned int count, unsigned char tag, unsigned int from);
+
+#endif   // N_TAG
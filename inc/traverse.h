@@ -0,0 +1,103 @@
+/*********************************************************************
+ * Filename:    traverse.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of parallel traversal (work stealing)
+*********************************************************************/
+
+#ifndef N_TRAVERSE
+#define N_TRAVERSE
+
+/*************************** HEADER FILES ***************************/
+#include <stdio.h>
+#include <pthread.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Defines number of nodes visited on calling thread before further workers are started (smaller traversals stay on it)
+#define TRAVERSELIMIT (64 * 1024)
+
+// Defines max number of workers of a traversal (cores online are used, up to this)
+#define TRAVERSEWORKERS 64
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Parallel traversal (work stealing, private stacks):
+ *      Every worker walks its share depth first with a stack of its own (node and range of children left to visit),
+ *      just as TraverseNodes does- last child first. Workers take no locks while walking.
+ *
+ *      An idle worker asks a busy one to share. The busy worker answers at its next node: it hands over the first half
+ *      of the children left in its lowest frame (copied, so the parent may be freed meanwhile). These are the children
+ *      it would visit last, so the largest share of work left goes, and output order is kept (see below).
+ *
+ *      The calling thread starts alone, further workers are started once it has visited TRAVERSELIMIT nodes.
+ *
+ *      Output (preOrder):
+ *          Visitors print into a stream handed as context. A share handed over prints into a segment of its own,
+ *          following the segment of the worker handing it over. Segments are written out in order as they complete,
+ *          the first straight to output. So output is the same as if one thread had printed it.
+ *
+ *      postOrder:
+ *          A node is visited after its children are visited or handed over- children handed over may be visited later.
+ *          Enough to free nodes (FreeVisitor), not to print them.
+ */
+
+// Range of children left to visit (frame of stack)
+typedef struct _TRAVERSEFRAME {
+    NODE            *node;              // Parent                 (NULL if share handed over)
+    NODE            **children;         // Children of parent     (copy if share handed over)
+    unsigned int    low,                // Children left          (low to next, visited from next down)
+                    next;
+    unsigned long   depth;              // Depth of children
+} TRAVERSEFRAME;
+
+// Share handed over (with segment of output it prints into)
+typedef struct _TRAVERSESHARE {
+    TRAVERSEFRAME   frame;
+    struct _TRAVERSESEGMENT *segment;
+} TRAVERSESHARE;
+
+// Segment of output (in order of traversal)
+typedef struct _TRAVERSESEGMENT {
+    FILE            *stream;            // Stream visitors print into
+    char            *buffer;            // Output of segment      (NULL if stream is output)
+    size_t          length;
+    short int       done;
+    struct _TRAVERSESEGMENT *next;
+} TRAVERSESEGMENT;
+
+// Worker of traversal
+typedef struct _TRAVERSEWORKER {
+    struct _TRAVERSAL *traversal;
+    unsigned int    number;
+    pthread_t       thread;
+    TRAVERSESEGMENT *segment;           // Segment printed into   (output only)
+    int             request;            // Worker asking to share (-1 if none)
+    short int       busy,               // Holding work           (idle workers are not asked)
+                    answered;           // Share asked for is answered
+    TRAVERSESHARE   *share;             // Share handed over      (NULL if none was left)
+    unsigned long   seed;               // Picks workers to ask
+} TRAVERSEWORKER;
+
+// Traversal
+typedef struct _TRAVERSAL {
+    VISITOR         visitor;
+    void            *context;
+    enum traverseOrder order;
+    FILE            *output;            // Output                 (NULL: visitors are handed context)
+    TRAVERSEWORKER  workers[TRAVERSEWORKERS];
+    unsigned int    numWorkers,
+                    started;
+    unsigned long   active,             // Workers holding work   (traversal is done at 0)
+                    visited;            // Visited by calling thread, until workers are started
+    short int       stop,               // Visitor stopped traversal, or allocating memory failed
+                    failed;
+    pthread_mutex_t lock;               // Guards segments
+    TRAVERSESEGMENT *segments;          // Segments not written out yet (first is being written to output)
+} TRAVERSAL;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+int TraverseParallel (NODE *root, VISITOR visitor, void *context, enum traverseOrder order, FILE *output);
+
+#endif   // N_TRAVERSE
@@ -22,25 +22,107 @@
 // Defines amount of nodes to pre-allocate in memory for search (optimize access speeds)
 #define MEMLIMIT 10
 
-// Defines if leaf nodes may hold duplicate key names or unique keys only (incomplete)
+// Defines group commit window of write-ahead log in microseconds (suggested for OpenLog- 0 syncs every mutation)
+#define LOGWINDOW 2000
+
+// Defines amount of children to allocate for a parent when first child is added (doubles when full)
+#define CHILDLIMIT 4
+
+// Defines size of output buffer used when serializing (bytes handed to each write)
+#define SERIALBUFFER (1024 * 1024)
+
+// Defines least share of text file loaded by each thread (smaller files load on calling thread, see Loader)
+#define LOADCHUNK (16 * 1024 * 1024)
+
+// Tree options (InitTreeEx)
+#define TREEARENA   0x1     // Allocate nodes, keys, strings and children from a per-tree arena
+#define TREECONCURRENT 0x2  // Lock free reads from any thread, writers are serialized (see sync.h)
+#define TREEINTERN  0x4     // Strings and long keys are held once per tree, shared by nodes using them (see intern.h)
+#define TREEART     0x8     // Full paths resolve through an adaptive radix tree, in O(path length) (see art.h)
+
+// Defines size of keys held inside node (incl. terminator- longer keys are allocated separately)
+#define KEYINLINE 24
+
+// Node flags
+#define NODEROOT    0x1     // Node is root of tree (holds tree state rather than parent)
+#define NODEHEAPKEY 0x2     // Key is allocated separately (too long to be held inside node)
+#define NODEDIRTY   0x4     // Node (or node below) changed since latest version (see version.h)
+#define NODESHARED  0x8     // Key is found in tree or an earlier share of file (loader only)
+
+// Key of node
+#define NodeKey(node)       (((node)->flags & NODEHEAPKEY) ? ((node)->name.heap) : ((node)->name.local))
+
+// Parent of node (NULL if root)
+#define NodeParent(node)    (((node)->flags & NODEROOT) ? (NULL) : ((node)->up.parent))
+
+// Defines number of keys a batch sorts without allocating (larger batches allocate once)
+#define BATCHLIMIT 64
+
+// Defines number of resolved path components a batch remembers for the next (sorted) key
+#define BATCHDEPTH 16
+
+// Defines max number of components in a query pattern
+#define QUERYLIMIT 63
+
+// Defines if leaf nodes may hold duplicate key names (keys are then given as paths) or unique keys only
 #define UNIQUEKEYS TRUE
 
 /**************************** DATA TYPES ****************************/
 /*
- *  Considered using union- calling a null value gets sigsegv error:
- *      If we must retain type, the point of using a union is lost (space used would equal retained type)
- *      for this assignment, if there were more than two data types, a union would make sense.
+ *  Node layout (one cache line, 64 bytes):
+ *      Keys shorter than KEYINLINE are held inside the node, so comparing keys doesn't leave the node.
+ *      Values are a tagged union- a node holds either an integer or a string, never both.
+ *      The key hash is cached, so most mismatches are rejected without comparing keys.
+ *      Parent and tree state share space (only the root holds tree state, NODEROOT tells which).
+ *
+ *      DATA is still what the API hands out (string is NULL for integer values).
  *
  *  Structures
  *      Low-coupling of data makes our program more versatile and easy to maintain.
  *      It allows for quickly adding new metadata about search results, retained data and returned data.
+ *
+ *  Concurrent trees (TREECONCURRENT):
+ *      GetInt, GetString, GetValue, GetType, GetText and counters take no locks, every other call excludes writers.
+ *      Readers never hold writers off, but they wait while a write section is open (see sync.h)- so a long section
+ *      stalls every reader for its whole length: DeserializeTextFile, Delete of a large subtree, and the first
+ *      checkpoint of a logged tree (it pins a copy of the whole tree- later checkpoints copy changed paths only).
+ *      Strings and values handed out by a reader stay valid while the reader holds ReadLock.
+ *      DeinitTree must not run alongside any other call.
+ *
+ *  Counters (AddInt, CompareAndSetInt, FetchMax, FetchMin):
+ *      Integers are resolved as readers resolve them and changed in place by an atomic operation, so no update is
+ *      lost and writers are never held off. Updated nodes are marked for the next version as writers mark them,
+ *      logged trees record the integer held once no writer is in between (see wal.h)- counters must not run alongside
+ *      OpenLog or CloseLog. A write section is only opened once the log is due for a checkpoint.
+ *      Trees that aren't concurrent take no locks- counters may be updated (and read) from several threads while
+ *      nothing else changes the tree (nor logs it or pins versions of it).
+ *
+ *  Versions (PinVersion):
+ *      A pinned version is an immutable copy of the whole tree (unchanged parts are shared, see version.h).
+ *      Readers of a version see one consistent tree, take no locks and never hold writers off- any tree kind.
+ *      Data handed out by a version stays valid until it's released, whatever writers do meanwhile.
+ *      The first pin copies the whole tree while writers are held off, later pins copy changed paths only.
+ *
+ *  Frozen trees (FreezeTree, LoadBinary):
+ *      Nodes are replaced by a read-only image- one block in breadth first order, keys and strings pooled (see image.h).
+ *      Full paths resolve through a perfect hash, reads allocate nothing. Every call changing the tree fails.
+ *      FreezeTree replaces the root, so it must not run alongside any other call.
  */
 
 // Node types
 enum nodeType { errorUndefinedNode, noSuchNode, emptyNode, parentNode, stringNode, integerNode };
 
 // Search modes
-enum searchMode { targetNode, traversedTarget, fullTree };
+enum searchMode { targetNode, targetPath, traversedTarget, fullTree };
+
+// Batch status (per key, see MultiGet and MultiSet)
+enum batchStatus { batchOk, batchNoSuchKey, batchParentNode, batchWrongType, batchNoMemory, batchReadOnly };
+
+// Traversal orders (preOrder visits parents before children, postOrder after)
+enum traverseOrder { preOrder, postOrder };
+
+// Visitor results (visitSkip leaves children of node out- preOrder only)
+enum visitResult { visitContinue, visitSkip, visitStop };
 
 // Search results
 typedef struct _SEARCHRESULT {
@@ -49,31 +131,154 @@ typedef struct _SEARCHRESULT {
     struct  _NODE   **nodes;            // Multiple node search
 } SEARCHRESULT;
 
-// Data in node (also used to return pointers to data)
+// Value types (tag of value held by node)
+enum valueType { integerValue, stringValue };
+
+// Data of node (used to return data)
 typedef struct _DATA {
     unsigned long   integer;            // If no children and no string; leaf holds integer value (incl. 0).
     char            *string;
 } DATA;
 
+// Value held by node (tagged by node type)
+typedef union _VALUE {
+    unsigned long   integer;
+    char            *string;
+} VALUE;
+
 // Tree node
 typedef struct _NODE {
-    char            *key;               // Name of node
-    struct  _DATA   value;              // Data a node may hold   (named value for KV-database term.)
+    union {
+        char        local[KEYINLINE];   // Key                    (if shorter than KEYINLINE)
+        char        *heap;              // Key                    (if NODEHEAPKEY)
+    } name;                             // Name of node           (use NodeKey)
+    unsigned int    hash;               // Hash of key            (low bits of HashKey)
+    unsigned char   type;               // Type of value          (enum valueType)
+    unsigned char   flags;              // NODEROOT, NODEHEAPKEY
+    unsigned short  handle;             // Slot of handle         (0 if none, see handle.h)
+    union   _VALUE  value;              // Data a node may hold   (named value for KV-database term.)
     unsigned int    numChildren;        // Number of children
-    struct  _NODE   **children;         // Children               (if none, leaf = true)
+    unsigned int    capChildren;        // Children allocated     (grows geometrically)
+    struct  _NODE   **children;         // Children               (if none, leaf = true- tags follow, see tag.h)
+    union {
+        struct _NODE *parent;           // Parent                 (if not NODEROOT)
+        struct _TREE *tree;             // Tree state             (if NODEROOT)
+    } up;                               // (use NodeParent)
 } NODE;
 
+// Visitor called by Traverse (depth is 0 for node traversal started from)
+typedef enum visitResult (*VISITOR)(NODE *node, unsigned long depth, void *context);
+
+// Tree state (held by root, one per tree in forest)
+typedef struct _TREE {
+    struct  _INDEX  *index;             // Key to node index      (unique keys only)
+    struct  _ARENA  *arena;             // Arena allocator        (if TREEARENA)
+    struct  _IMAGE  *image;             // Read-only image        (if LoadBinary or FreezeTree, no nodes below root)
+    struct  _SYNC   *sync;              // Concurrency state      (if TREECONCURRENT)
+    struct  _WAL    *wal;               // Write-ahead log        (if OpenLog, see wal.h)
+    struct  _VERSION *version;          // Latest version         (if PinVersion, see version.h)
+    struct  _INTERN *intern;            // String pool            (if TREEINTERN)
+    struct  _HANDLES *handles;          // Node handles           (if ResolveHandle, see handle.h)
+    struct  _ART    *art;               // Paths to nodes         (if TREEART)
+    struct  _NODE   *root;              // Root holding state
+    unsigned long   writing;            // Depth of write sections (checkpoints start when outermost ends)
+} TREE;
+
+// Immutable version of tree (see PinVersion)
+typedef struct _VERSION VERSION;
+
+// Handle of node (see ResolveHandle- 0 is no handle)
+typedef unsigned long HANDLE;
+
+// Statistics of tree and operations (see GetTreeStats and stats.h)
+typedef struct _TREESTATS TREESTATS;
+
+/*
+ *  Queries:
+ *      Patterns are dotted paths from root (leading root key is optional), components may be:
+ *          key     Child named key
+ *          pre*    Children with keys starting with pre
+ *          *       Any child (last component: anything below, ie. "config.update.*")
+ *          **      Any number of levels (incl. none)
+ *
+ *      A cursor yields value holding nodes matched by pattern one at a time, in sorted path order.
+ *      Nodes on the path are walked with a stack (one frame per level)- nothing is collected up front.
+ *      Key and prefix components binary search the sorted children, subtrees that can't match are skipped.
+ *
+ *      Writers are locked out of concurrent trees while a cursor is open (close it from the thread opening it).
+ *      Other trees must not be changed while a cursor is open.
+ */
+
+// Query pattern components
+enum queryMatch { matchKey, matchPrefix, matchOne, matchAny };
+
+typedef struct _QUERYPART {
+    const   char    *key;               // Key or prefix          (not null terminated)
+    size_t          length;
+    enum queryMatch match;
+} QUERYPART;
+
+// Node on path of cursor
+typedef struct _QUERYFRAME {
+    NODE            *node;              // Node                   (NULL if image backed)
+    long            index;              // Image node             (if image backed)
+    unsigned long   states;             // Pattern components reached (bit per component, bit numParts is match)
+    unsigned int    next,               // Next child to visit
+                    end;                // End of children that may match
+    short int       prune;              // Stop at first child not matching (prefix range)
+    size_t          pathLength;         // Length of path to node
+} QUERYFRAME;
+
+// Query cursor (see Query and CursorNext)
+typedef struct _CURSOR {
+    struct  _TREE   *locked;            // Tree locked for cursor (concurrent trees)
+    const   struct _IMAGE *image;       // Image                  (if image backed)
+    char            *pattern;           // Copy of pattern        (parts point into it)
+    QUERYPART       parts[QUERYLIMIT];
+    unsigned int    numParts;
+    QUERYFRAME      *stack;
+    unsigned long   depth,
+                    capStack;
+    char            *path;              // Path of node last yielded (dotted, excl. root)
+    size_t          capPath;
+    DATA            data;               // Data of node last yielded
+} CURSOR;
+
 /********************** GLOBAL EXTERN VARIABLES *********************/
 
 /*********************** FUNCTION DECLARATIONS **********************/
 NODE *InitTree ();
 
+NODE *InitTreeEx (unsigned int options);
+
+int ReadLock (NODE **root);
+
+int ReadUnlock (NODE **root);
+
 int DeinitTree (NODE **root);
 
 int DeserializeTextFile (NODE **root, const char *fileName);
 
+int SerializeTextFile (NODE **root, const char *fileName);
+
+int SerializeBinary (NODE **root, const char *fileName);
+
+int OpenLog (NODE **root, const char *fileName, unsigned long window);
+
+int SyncLog (NODE **root);
+
+int CheckpointLog (NODE **root);
+
+int CloseLog (NODE **root);
+
+NODE *LoadBinary (const char *fileName);
+
+int FreezeTree (NODE **root);
+
 int AddNode (NODE **root, char *targetKey, char *key);
 
+int AddNodes (NODE **root, char *targetKey, char **keys, unsigned int numKeys);
+
 char *GetText (NODE **root, char *targetKey, char *language);
 
 int Delete (NODE **root, char *targetKey);
@@ -86,7 +291,7 @@ int PrintValue (const DATA *data);
 
 int SetValue (NODE **root, char *targetKey, char *format, ...);
 
-DATA *GetValue (NODE **root, char *targetKey);
+DATA *GetValue (NODE **root, char *targetKey, DATA *data);
 
 char *GetString (NODE **root, char *targetKey);
 
@@ -96,6 +301,18 @@ int SetString (NODE **root, char *targetKey, const char *valueString);
 
 int SetInt (NODE **root, char *targetKey, unsigned long valueInteger);
 
+int AddInt (NODE **root, char *targetKey, long delta, unsigned long *newValue);
+
+int CompareAndSetInt (NODE **root, char *targetKey, unsigned long *expected, unsigned long desired);
+
+int FetchMax (NODE **root, char *targetKey, unsigned long value, unsigned long *previous);
+
+int FetchMin (NODE **root, char *targetKey, unsigned long value, unsigned long *previous);
+
+int MultiGet (NODE **root, char **keys, unsigned int numKeys, DATA *values, enum batchStatus *status);
+
+int MultiSet (NODE **root, char **keys, const DATA *values, unsigned int numKeys, enum batchStatus *status);
+
 enum nodeType GetType (NODE **root, char *targetKey);
 
 enum nodeType NodeType (NODE *node);
@@ -104,4 +321,34 @@ int Search (NODE **root, SEARCHRESULT **result, char *targetKey, enum searchMode
 
 int DephtFirst (NODE **root, SEARCHRESULT **result, char *targetKey, enum searchMode search);
 
+int Traverse (NODE **root, VISITOR visitor, void *context, enum traverseOrder order);
+
+VERSION *PinVersion (NODE **root);
+
+int ReleaseVersion (VERSION *version);
+
+DATA *GetVersionValue (VERSION *version, char *targetKey);
+
+enum nodeType GetVersionType (VERSION *version, char *targetKey);
+
+int EnumerateVersion (VERSION *version, char *targetKey);
+
+CURSOR *Query (NODE **root, const char *pattern);
+
+int CursorNext (CURSOR *cursor, char **path, DATA **data);
+
+int CursorClose (CURSOR *cursor);
+
+int GetTreeStats (NODE **root, TREESTATS *stats);
+
+HANDLE ResolveHandle (NODE **root, char *targetKey);
+
+unsigned long GetIntH (NODE **root, HANDLE handle);
+
+char *GetStringH (NODE **root, HANDLE handle);
+
+int SetIntH (NODE **root, HANDLE handle, unsigned long valueInteger);
+
+int SetStringH (NODE **root, HANDLE handle, const char *valueString);
+
 #endif   // N_TREE
\ No newline at end of file
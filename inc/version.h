@@ -0,0 +1,78 @@
+/*********************************************************************
+ * Filename:    version.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API of immutable tree versions (consistent readers)
+*********************************************************************/
+
+#ifndef N_VERSION
+#define N_VERSION
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Defines bits of key hash used per level of key map (32 slots per map node)
+#define VMAPBITS 5
+
+// Defines levels of key map indexed by hash bits (64 / VMAPBITS, rounded up- deeper map nodes list keys of equal hash)
+#define VMAPDEPTH 13
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Versions (path copying):
+ *      A version is an immutable copy of the tree as it was when pinned- no locks are taken reading it.
+ *      Writers mark nodes they change NODEDIRTY (with their ancestors, up to the first already marked).
+ *      Pinning copies marked nodes only, every unmarked subtree is shared with the previous version.
+ *      So a pin costs one copy per changed path, and a pin of an unchanged tree costs nothing.
+ *
+ *      Version nodes are reference counted (by versions and parents holding them). A version, and every node
+ *      no other version holds, goes when its last reader releases it. The tree holds its latest version.
+ *
+ *      The first pin (and any pin after one that failed) copies the whole tree, while writers are held off.
+ *
+ *  Key map (unique keys only):
+ *      Every version maps keys to its nodes by a hash array mapped trie, so keys resolve as by the tree index.
+ *      The map is path copied as the tree is- a pin changes the entries of nodes it copies or drops, every other
+ *      map node is shared with the previous version. Map nodes hold no references of the version nodes they map.
+ */
+
+// Version node (key and string are held in the same allocation)
+typedef struct _VNODE {
+    unsigned long   refs;               // Parents and versions holding node
+    DATA            data;               // Value                  (string is NULL for integers)
+    unsigned char   type;               // Type of node           (enum nodeType)
+    unsigned int    numChildren;
+    struct _VNODE   **children;         // Children               (sorted as in tree)
+    char            key[];              // Key of node
+} VNODE;
+
+// Key map node (slots are taken by hash bits of level- nodes below VMAPDEPTH list keys of equal hash)
+typedef struct _VMAP {
+    unsigned long   refs;               // Maps and versions holding map node
+    unsigned int    nodes;              // Slots holding version nodes   (bits- number of nodes below VMAPDEPTH)
+    unsigned int    maps;               // Slots holding map nodes       (bits)
+    void            *slots[];           // Version nodes, then map nodes (each in order of slot)
+} VMAP;
+
+// Version of tree (VERSION, see PinVersion)
+struct _VERSION {
+    unsigned long   refs;               // Readers holding version (incl. tree)
+    VNODE           *root;
+    VMAP            *keys;              // Nodes by key              (NULL if empty)
+};
+
+/*********************** FUNCTION DECLARATIONS **********************/
+VERSION *VersionBuild (NODE *root, const VERSION *previous);
+
+VERSION *VersionHold (VERSION *version);
+
+void VersionRelease (VERSION *version);
+
+const VNODE *VersionFind (const VERSION *version, const char *targetKey);
+
+int VersionEnumerate (const VERSION *version, const char *targetKey);
+
+#endif   // N_VERSION
@@ -0,0 +1,133 @@
+/*********************************************************************
+ * Filename:    wal.h
+ * Author:      Morten P. Wilsgård (morten.wilsgaard AT gmail.com)
+ * Copyright:   Automatic by norwegian law
+ * Disclaimer:  Code is presented "as is" without any guarantees
+ * Details:     Defines API and format of write-ahead logs (durable mutations)
+*********************************************************************/
+
+#ifndef N_WAL
+#define N_WAL
+
+/*************************** HEADER FILES ***************************/
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "tree.h"
+
+/************************* MACROS & DEFINES *************************/
+// Defines size of log buffer (appending to a full buffer writes it out at once, rather than waiting for flusher)
+#define WALBUFFER (1024 * 1024)
+
+// Defines size log may grow to before a checkpoint is started (bytes, counted from last checkpoint)
+#define LOGCOMPACT (64 * 1024 * 1024)
+
+// Defines size of record header (body size and checksum)
+#define WALHEADER 8
+
+/**************************** DATA TYPES ****************************/
+/*
+ *  Log format (append only, host byte order):
+ *      Records follow each other, each a header and a body:
+ *          uint32  size of body
+ *          uint32  checksum of body (FNV-1a)
+ *          uint8   operation (enum walOp)
+ *          varint  length of path, path    (dotted keys from root, incl. root key)
+ *          varint  length of text, text    (key added or string set)
+ *          varint  integer                 (integer set)
+ *      A record that is cut short or fails its checksum ends the log (torn write)- it's cut off when opened.
+ *
+ *  Group commit:
+ *      Records are appended to a buffer. A flusher thread writes the buffer out and syncs the file once per window,
+ *      so every record appended meanwhile shares one sync. A record is durable at most one window after it's appended.
+ *      Window 0 syncs every record before the mutation returns.
+ *
+ *  Updates in place (counters):
+ *      Integers changed by atomic operations outside write sections are logged by the value they hold when the log
+ *      is locked, rather than the value the update left- records of updates racing each other may come in any order,
+ *      but the last one always holds the latest value.
+ *
+ *  Checkpoints (compaction):
+ *      A version of the tree is pinned while writers are held off (see version.h)- log position at the pin marks
+ *      which records the snapshot holds. A checkpointer thread writes the snapshot from the version, while writers
+ *      go on. Once the snapshot is synced, a new log is written: a snapshot record, then the records from the pin on.
+ *      It replaces the old log by rename, so a crash leaves either log whole.
+ *
+ *      The tree keeps its latest version, so every checkpoint after the first copies changed paths only.
+ *
+ *      Snapshots are records too (same format)- every node is added below its parent (parents first), then given
+ *      its value. So keys and strings are length prefixed, whatever they hold. A snapshot record is replayed by
+ *      replaying the records of its snapshot.
+ *
+ *      Snapshots alternate between two files next to the log (the one the log refers to is never overwritten).
+ *      Replay time stays bounded- the log never holds much more than LOGCOMPACT bytes of records.
+ */
+
+// Logged operations
+enum walOp { walAdd = 1, walSetInt, walSetString, walDelete, walSnapshot };
+
+// Apply replayed record (path is null terminated, text is null terminated or NULL- snapshot records aren't handed out)
+typedef int (*REPLAY)(void *context, enum walOp op, const char *path, const char *text, unsigned long integer);
+
+// Read integer to log while log is locked (see WalAppendInt- FALSE if nothing is to be logged)
+typedef int (*WALREAD)(void *context, unsigned long *integer);
+
+// Write snapshot of context to file, synced (called once per checkpoint, on checkpointer thread- see WalCheckpointBegin)
+typedef int (*SNAPSHOT)(void *context, const char *fileName);
+
+// Take bytes of record being put (see WalPutRecord)
+typedef void (*WALPUT)(void *context, const char *data, size_t length);
+
+// Write-ahead log of tree
+typedef struct _WAL {
+    int             file;
+    unsigned long   window;             // Microseconds between syncs (0: sync every record)
+    pthread_mutex_t lock;               // Guards buffer and sequence numbers
+    pthread_mutex_t io;                 // One writer of file at a time
+    pthread_cond_t  wake;               // Wakes flusher (closing)
+    pthread_t       flusher;
+    char            *buffer;            // Records not written yet
+    size_t          length,
+                    capacity;
+    char            *spare;             // Buffer being written (swapped with buffer)
+    size_t          capSpare;
+    unsigned long   appended,           // Records appended
+                    durable;            // Records synced
+    size_t          written;            // Bytes written (or being written) to file
+    short int       closing,
+                    failed;             // Writing or syncing failed (records may be lost)
+    char            *fileName;
+    char            *snapshot;          // Snapshot log refers to (NULL if none)
+    size_t          limit;              // Size that starts next checkpoint
+    pthread_t       checkpointer;       // Writes snapshot, then replaces log
+    short int       running,            // Checkpoint is running
+                    joining;            // Checkpointer is to be joined
+    SNAPSHOT        writer;             // Writes snapshot of source
+    void            *source;            // What snapshot is taken of
+    size_t          boundary;           // Log position of pin (records after it go to new log)
+    char            *pending;           // Snapshot being written
+} WAL;
+
+/*********************** FUNCTION DECLARATIONS **********************/
+WAL *WalOpen (const char *fileName, unsigned long window, REPLAY replay, void *context);
+
+int WalClose (WAL *wal);
+
+int WalAppend (WAL *wal, enum walOp op, const NODE *node, const char *text, unsigned long integer);
+
+int WalAppendInt (WAL *wal, const char *path, size_t pathLength, WALREAD read, void *context);
+
+void WalPutRecord (WALPUT put, void *context, enum walOp op, const char *path, size_t pathLength,
+                   const char *text, size_t textLength, unsigned long integer);
+
+int WalSync (WAL *wal);
+
+int WalCompactDue (WAL *wal, short int force);
+
+char *WalSnapshotName (const WAL *wal);
+
+int WalCheckpointBegin (WAL *wal, SNAPSHOT writer, void *source, char *snapshot);
+
+int WalCheckpointWait (WAL *wal);
+
+#endif   // N_WAL
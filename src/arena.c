@@ -0,0 +1,230 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// Chunk header (memory follows)
+typedef struct _CHUNK {
+    struct  _CHUNK  *next;
+    size_t          size;
+} CHUNK;
+
+// Oversized block header (memory follows, doubly linked so blocks can be freed one by one)
+typedef struct _BLOCK {
+    struct  _BLOCK  *prev,
+                    *next;
+} BLOCK;
+
+// Header sizes rounded up to keep allocations aligned
+#define CHUNKHEADER (((sizeof(CHUNK) + ARENAALIGN - 1) / ARENAALIGN) * ARENAALIGN)
+#define BLOCKHEADER (((sizeof(BLOCK) + ARENAALIGN - 1) / ARENAALIGN) * ARENAALIGN)
+
+// Get size class of size (-1 if above largest class)
+static int SizeClass(const size_t size, size_t *classSize) {
+    if (size <= ARENASMALL) {
+        *classSize = (size) ? (((size + ARENAALIGN - 1) / ARENAALIGN) * ARENAALIGN) : (ARENAALIGN);
+        return (int) (*classSize / ARENAALIGN) - 1;
+    }
+
+    int sizeClass = ARENASMALL / ARENAALIGN;
+    *classSize = ARENASMALL * 2;
+    while (*classSize < size) {
+        *classSize <<= 1;
+        sizeClass++;
+    }
+    return (*classSize <= ARENALARGE) ? (sizeClass) : (-1);
+}
+
+// Bump allocate from newest chunk (adds chunk if needed)
+static void *Bump(ARENA *arena, const size_t size) {
+    if (arena->left < size) {
+        CHUNK *chunk = malloc (CHUNKHEADER + ARENACHUNK);
+        if (!chunk) {
+            fprintf(stderr, "\nArena error: allocating chunk failed!\n");
+            return NULL;
+        }
+        // Remainder of previous chunk is abandoned (at most one largest class)
+        chunk->next = arena->chunks;
+        chunk->size = ARENACHUNK;
+        arena->chunks = chunk;
+        arena->cursor = (char *) chunk + CHUNKHEADER;
+        arena->left = ARENACHUNK;
+    }
+
+    void *memory = arena->cursor;
+    arena->cursor += size;
+    arena->left -= size;
+    return memory;
+}
+
+// Create empty arena (first chunk is allocated on first use)
+ARENA *ArenaCreate() {
+    ARENA *arena = calloc (1, sizeof(ARENA));
+    if (!arena) {
+        fprintf(stderr, "\nArena error: allocating memory failed!\n");
+    }
+    return arena;
+}
+
+// Destroy arena and everything allocated from it
+void ArenaDestroy(ARENA *arena) {
+    if (!arena) {
+        return;
+    }
+
+    while (arena->chunks) {
+        CHUNK *next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+
+    while (arena->blocks) {
+        BLOCK *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    free(arena);
+}
+
+// Take over every chunk, block and free allocation of other arena (other is destroyed- its memory stays in use)
+void ArenaAdopt(ARENA *arena, ARENA *other) {
+    if (!other) {
+        return;
+    }
+
+    // Chunks go behind newest chunk (bumping goes on where it was)
+    if (other->chunks) {
+        CHUNK *last = other->chunks;
+        while (last->next) {
+            last = last->next;
+        }
+        if (arena->chunks) {
+            last->next = arena->chunks->next;
+            arena->chunks->next = other->chunks;
+        }
+        else {
+            arena->chunks = other->chunks;
+        }
+    }
+
+    if (other->blocks) {
+        BLOCK *last = other->blocks;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = arena->blocks;
+        if (arena->blocks) {
+            arena->blocks->prev = last;
+        }
+        arena->blocks = other->blocks;
+    }
+
+    int sizeClass;
+    for (sizeClass = 0; sizeClass < ARENACLASSES; ++sizeClass) {
+        void *last = other->freeLists[sizeClass];
+        if (last) {
+            while (*(void **) last) {
+                last = *(void **) last;
+            }
+            *(void **) last = arena->freeLists[sizeClass];
+            arena->freeLists[sizeClass] = other->freeLists[sizeClass];
+        }
+    }
+
+    arena->allocated += other->allocated;
+    free(other);
+}
+
+// Allocate zeroed memory
+void *ArenaAlloc(ARENA *arena, const size_t size) {
+    size_t classSize;
+    int sizeClass = SizeClass(size, &classSize);
+    void *memory;
+
+    // Oversized- allocate block by itself
+    if (sizeClass < 0) {
+        BLOCK *block = calloc (1, BLOCKHEADER + size);
+        if (!block) {
+            fprintf(stderr, "\nArena error: allocating block failed!\n");
+            return NULL;
+        }
+        block->next = arena->blocks;
+        if (arena->blocks) {
+            arena->blocks->prev = block;
+        }
+        arena->blocks = block;
+        arena->allocated += size;
+        return (char *) block + BLOCKHEADER;
+    }
+
+    // Reuse freed memory of same class
+    if (arena->freeLists[sizeClass]) {
+        memory = arena->freeLists[sizeClass];
+        arena->freeLists[sizeClass] = *(void **) memory;
+    }
+    else if (!(memory = Bump(arena, classSize))) {
+        return NULL;
+    }
+
+    memset(memory, 0, classSize);
+    arena->allocated += classSize;
+    return memory;
+}
+
+// Free memory (size must match size given when allocated)
+void ArenaFree(ARENA *arena, void *memory, const size_t size) {
+    if (!memory) {
+        return;
+    }
+
+    size_t classSize;
+    int sizeClass = SizeClass(size, &classSize);
+
+    // Oversized- unlink and free block
+    if (sizeClass < 0) {
+        BLOCK *block = (BLOCK *) ((char *) memory - BLOCKHEADER);
+        if (block->prev) {
+            block->prev->next = block->next;
+        }
+        else {
+            arena->blocks = block->next;
+        }
+        if (block->next) {
+            block->next->prev = block->prev;
+        }
+        free(block);
+        arena->allocated -= size;
+        return;
+    }
+
+    // Push to free list of class
+    *(void **) memory = arena->freeLists[sizeClass];
+    arena->freeLists[sizeClass] = memory;
+    arena->allocated -= classSize;
+}
+
+// Reallocate memory (old contents are kept, grown part is not cleared)
+void *ArenaRealloc(ARENA *arena, void *memory, const size_t oldSize, const size_t newSize) {
+    size_t oldClassSize, newClassSize;
+
+    if (!memory) {
+        return ArenaAlloc(arena, newSize);
+    }
+
+    // Same class- memory already fits
+    if (SizeClass(oldSize, &oldClassSize) >= 0 && SizeClass(newSize, &newClassSize) >= 0
+        && oldClassSize == newClassSize) {
+        return memory;
+    }
+
+    void *newMemory = ArenaAlloc(arena, newSize);
+    if (newMemory) {
+        memcpy(newMemory, memory, (oldSize < newSize) ? (oldSize) : (newSize));
+        ArenaFree(arena, memory, oldSize);
+    }
+    return newMemory;   // If null, old memory is kept
+}
@@ -0,0 +1,592 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "art.h"
+
+// Number of prefix bytes held by inner node
+#define ArtStored(inner) (((inner)->prefixLength < ARTPREFIX) ? ((inner)->prefixLength) : (ARTPREFIX))
+
+// Get byte of key at depth (virtual null byte ends key)
+static unsigned char ArtByte(const char *key, const size_t length, const size_t depth) {
+    return (depth < length) ? ((unsigned char) key[depth]) : (0);
+}
+
+// Create inner node of type (no children, no prefix)
+static ARTINNER *ArtCreateInner(const enum artType type) {
+    static const size_t sizes[] = { sizeof(ART4), sizeof(ART16), sizeof(ART48), sizeof(ART256) };
+    ARTINNER *inner = calloc (1, sizes[type]);
+
+    if (inner) {
+        inner->type = (unsigned char) type;
+    }
+    return inner;
+}
+
+// Create leaf holding copy of key
+static ARTLEAF *ArtCreateLeaf(const char *key, const size_t length, NODE *node) {
+    ARTLEAF *leaf = malloc (sizeof(ARTLEAF) + length);
+
+    if (leaf) {
+        leaf->node = node;
+        leaf->length = length;
+        memcpy(leaf->key, key, length);
+    }
+    return leaf;
+}
+
+// Copy header of inner node into node replacing it (type is kept)
+static void ArtCopyHeader(ARTINNER *to, const ARTINNER *from) {
+    to->numChildren = from->numChildren;
+    to->prefixLength = from->prefixLength;
+    memcpy(to->prefix, from->prefix, ArtStored(from));
+}
+
+// Free child and everything below it (returns number of leaves freed)
+static unsigned long ArtFree(void *child) {
+    unsigned long freed = 0;
+    unsigned int i;
+
+    if (!child) {
+        return 0;
+    }
+    if (ArtIsLeaf(child)) {
+        free(ArtLeaf(child));
+        return 1;
+    }
+
+    ARTINNER *inner = child;
+    switch (inner->type) {
+        case art4:
+            for (i = 0; i < inner->numChildren; ++i) {
+                freed += ArtFree(((ART4 *) inner)->children[i]);
+            }
+            break;
+        case art16:
+            for (i = 0; i < inner->numChildren; ++i) {
+                freed += ArtFree(((ART16 *) inner)->children[i]);
+            }
+            break;
+        case art48:
+            for (i = 0; i < 48; ++i) {
+                freed += ArtFree(((ART48 *) inner)->children[i]);
+            }
+            break;
+        default:
+            for (i = 0; i < 256; ++i) {
+                freed += ArtFree(((ART256 *) inner)->children[i]);
+            }
+            break;
+    }
+    free(inner);
+    return freed;
+}
+
+// Find child of inner node under byte (returns reference to child, NULL if none)
+static void **ArtFindChild(ARTINNER *inner, const unsigned char byte) {
+    unsigned int i;
+
+    switch (inner->type) {
+        case art4: {
+            ART4 *node = (ART4 *) inner;
+            for (i = 0; i < inner->numChildren; ++i) {
+                if (node->keys[i] == byte) {
+                    return &node->children[i];
+                }
+            }
+            break;
+        }
+        case art16: {
+            ART16 *node = (ART16 *) inner;
+            for (i = 0; i < inner->numChildren; ++i) {
+                if (node->keys[i] == byte) {
+                    return &node->children[i];
+                }
+            }
+            break;
+        }
+        case art48: {
+            ART48 *node = (ART48 *) inner;
+            if (node->index[byte]) {
+                return &node->children[node->index[byte] - 1];
+            }
+            break;
+        }
+        default: {
+            ART256 *node = (ART256 *) inner;
+            if (node->children[byte]) {
+                return &node->children[byte];
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Get leaf of smallest key below child (every key below shares the compressed paths on the way)
+static const ARTLEAF *ArtMinimum(const void *child) {
+    unsigned int i;
+
+    while (child && !ArtIsLeaf(child)) {
+        const ARTINNER *inner = child;
+        switch (inner->type) {
+            case art4:
+                child = ((const ART4 *) inner)->children[0];
+                break;
+            case art16:
+                child = ((const ART16 *) inner)->children[0];
+                break;
+            case art48:
+                for (i = 0; !((const ART48 *) inner)->index[i]; ++i) {}
+                child = ((const ART48 *) inner)->children[((const ART48 *) inner)->index[i] - 1];
+                break;
+            default:
+                for (i = 0; !((const ART256 *) inner)->children[i]; ++i) {}
+                child = ((const ART256 *) inner)->children[i];
+                break;
+        }
+    }
+    return (child) ? (ArtLeaf(child)) : (NULL);
+}
+
+// Count bytes of compressed path of inner node matching key from depth (bytes not held are read from a leaf)
+static unsigned int ArtMismatch(const ARTINNER *inner, const char *key, const size_t length, const size_t depth) {
+    unsigned int stored = ArtStored(inner),
+                 i;
+
+    for (i = 0; i < stored; ++i) {
+        if (inner->prefix[i] != ArtByte(key, length, depth + i)) {
+            return i;
+        }
+    }
+    if (inner->prefixLength > ARTPREFIX) {
+        const ARTLEAF *leaf = ArtMinimum(inner);
+        for ( ; i < inner->prefixLength; ++i) {
+            if (ArtByte(leaf->key, leaf->length, depth + i) != ArtByte(key, length, depth + i)) {
+                return i;
+            }
+        }
+    }
+    return i;
+}
+
+// Add child under byte (inner node is replaced by the next larger kind when full)
+static int ArtAddChild(void **ref, const unsigned char byte, void *child) {
+    ARTINNER *inner = *ref,
+             *grown;
+    unsigned int numChildren = inner->numChildren,
+                 i;
+
+    if (inner->type == art4 || inner->type == art16) {
+        unsigned int capacity = (inner->type == art4) ? (4) : (16);
+        unsigned char *keys = (inner->type == art4) ? (((ART4 *) inner)->keys) : (((ART16 *) inner)->keys);
+        void **children = (inner->type == art4) ? (((ART4 *) inner)->children) : (((ART16 *) inner)->children);
+
+        // Insert into sorted keys
+        if (numChildren < capacity) {
+            for (i = 0; i < numChildren && keys[i] < byte; ++i) {}
+            memmove(&keys[i + 1], &keys[i], numChildren - i);
+            memmove(&children[i + 1], &children[i], sizeof(void *) * (numChildren - i));
+            keys[i] = byte;
+            children[i] = child;
+            inner->numChildren++;
+            return OK;
+        }
+
+        if (!(grown = ArtCreateInner((enum artType) (inner->type + 1)))) {
+            return ERROR;
+        }
+        if (inner->type == art4) {
+            memcpy(((ART16 *) grown)->keys, keys, numChildren);
+            memcpy(((ART16 *) grown)->children, children, sizeof(void *) * numChildren);
+        }
+        else {
+            for (i = 0; i < numChildren; ++i) {
+                ((ART48 *) grown)->index[keys[i]] = (unsigned char) (i + 1);
+                ((ART48 *) grown)->children[i] = children[i];
+            }
+        }
+    }
+
+    else if (inner->type == art48) {
+        ART48 *node = (ART48 *) inner;
+
+        // Take first free child
+        if (numChildren < 48) {
+            for (i = 0; node->children[i]; ++i) {}
+            node->children[i] = child;
+            node->index[byte] = (unsigned char) (i + 1);
+            inner->numChildren++;
+            return OK;
+        }
+
+        if (!(grown = ArtCreateInner(art256))) {
+            return ERROR;
+        }
+        for (i = 0; i < 256; ++i) {
+            if (node->index[i]) {
+                ((ART256 *) grown)->children[i] = node->children[node->index[i] - 1];
+            }
+        }
+    }
+
+    else {
+        ((ART256 *) inner)->children[byte] = child;
+        inner->numChildren++;
+        return OK;
+    }
+
+    ArtCopyHeader(grown, inner);
+    free(inner);
+    *ref = grown;
+    return ArtAddChild(ref, byte, child);
+}
+
+// Shrink inner node to the next smaller kind when it holds few children (single child of Node4 takes its place)
+static void ArtShrink(void **ref) {
+    ARTINNER *inner = *ref,
+             *shrunk;
+    unsigned int numChildren = inner->numChildren,
+                 i, j;
+
+    switch (inner->type) {
+        case art4: {
+            if (numChildren != 1) {
+                return;
+            }
+
+            // Compressed path of child becomes path of node, key of child and path of child
+            ART4 *node = (ART4 *) inner;
+            void *child = node->children[0];
+            if (!ArtIsLeaf(child)) {
+                ARTINNER *below = child;
+                unsigned char prefix[ARTPREFIX];
+                unsigned int length = ArtStored(inner);
+
+                memcpy(prefix, inner->prefix, length);
+                if (length < ARTPREFIX) {
+                    prefix[length++] = node->keys[0];
+                }
+                for (i = 0; length < ARTPREFIX && i < ArtStored(below); ++i) {
+                    prefix[length++] = below->prefix[i];
+                }
+                memcpy(below->prefix, prefix, length);
+                below->prefixLength += inner->prefixLength + 1;
+            }
+            free(inner);
+            *ref = child;
+            return;
+        }
+        case art16:
+            if (numChildren > 3 || !(shrunk = ArtCreateInner(art4))) {
+                return;
+            }
+            memcpy(((ART4 *) shrunk)->keys, ((ART16 *) inner)->keys, numChildren);
+            memcpy(((ART4 *) shrunk)->children, ((ART16 *) inner)->children, sizeof(void *) * numChildren);
+            break;
+        case art48:
+            if (numChildren > 12 || !(shrunk = ArtCreateInner(art16))) {
+                return;
+            }
+            for (i = 0, j = 0; i < 256; ++i) {
+                if (((ART48 *) inner)->index[i]) {
+                    ((ART16 *) shrunk)->keys[j] = (unsigned char) i;
+                    ((ART16 *) shrunk)->children[j++] = ((ART48 *) inner)->children[((ART48 *) inner)->index[i] - 1];
+                }
+            }
+            break;
+        default:
+            if (numChildren > 37 || !(shrunk = ArtCreateInner(art48))) {
+                return;
+            }
+            for (i = 0, j = 0; i < 256; ++i) {
+                if (((ART256 *) inner)->children[i]) {
+                    ((ART48 *) shrunk)->index[i] = (unsigned char) (j + 1);
+                    ((ART48 *) shrunk)->children[j++] = ((ART256 *) inner)->children[i];
+                }
+            }
+            break;
+    }
+
+    ArtCopyHeader(shrunk, inner);
+    free(inner);
+    *ref = shrunk;
+}
+
+// Remove child under byte (node shrinks if it's left with few children- if it fails, the larger node is kept)
+static void ArtRemoveChild(void **ref, const unsigned char byte) {
+    ARTINNER *inner = *ref;
+    unsigned int i;
+
+    if (inner->type == art4 || inner->type == art16) {
+        unsigned char *keys = (inner->type == art4) ? (((ART4 *) inner)->keys) : (((ART16 *) inner)->keys);
+        void **children = (inner->type == art4) ? (((ART4 *) inner)->children) : (((ART16 *) inner)->children);
+
+        for (i = 0; i < inner->numChildren && keys[i] != byte; ++i) {}
+        if (i == inner->numChildren) {
+            return;
+        }
+        memmove(&keys[i], &keys[i + 1], inner->numChildren - i - 1);
+        memmove(&children[i], &children[i + 1], sizeof(void *) * (inner->numChildren - i - 1));
+    }
+    else if (inner->type == art48) {
+        ART48 *node = (ART48 *) inner;
+        if (!node->index[byte]) {
+            return;
+        }
+        node->children[node->index[byte] - 1] = NULL;
+        node->index[byte] = 0;
+    }
+    else {
+        ((ART256 *) inner)->children[byte] = NULL;
+    }
+    inner->numChildren--;
+    ArtShrink(ref);
+}
+
+// Create empty radix tree
+ART *ArtCreate() {
+    ART *art = calloc (1, sizeof(ART));
+
+    if (!art) {
+        fprintf(stderr, "\nArt error: allocating memory failed!\n");
+    }
+    return art;
+}
+
+// Destroy radix tree and every leaf in it (NULL is ignored- nodes are not touched)
+void ArtDestroy(ART *art) {
+    if (art) {
+        ArtFree(art->root);
+        free(art);
+    }
+}
+
+// Find node of key (NULL if none- only bytes held by inner nodes are compared on the way, the key at the leaf)
+NODE *ArtLookup(const ART *art, const char *key, const size_t length) {
+    void *child = (art) ? (art->root) : (NULL);
+    size_t depth = 0;
+    unsigned int i;
+
+    while (child && !ArtIsLeaf(child)) {
+        ARTINNER *inner = child;
+        for (i = 0; i < ArtStored(inner); ++i) {
+            if (inner->prefix[i] != ArtByte(key, length, depth + i)) {
+                return NULL;
+            }
+        }
+
+        depth += inner->prefixLength;
+        if (depth > length) {
+            return NULL;
+        }
+        void **next = ArtFindChild(inner, ArtByte(key, length, depth++));
+        child = (next) ? (*next) : (NULL);
+    }
+
+    const ARTLEAF *leaf = (child) ? (ArtLeaf(child)) : (NULL);
+    return (leaf && leaf->length == length && memcmp(leaf->key, key, length) == 0) ? (leaf->node) : (NULL);
+}
+
+// Insert key below reference at depth
+static int ArtInsertAt(ART *art, void **ref, const char *key, const size_t length, size_t depth, NODE *node) {
+    void *child = *ref;
+    ARTINNER *split = NULL;
+    ARTLEAF *leaf;
+    unsigned char byte;
+
+    // Empty- leaf takes its place
+    if (!child) {
+        if (!(leaf = ArtCreateLeaf(key, length, node))) {
+            return ERROR;
+        }
+        *ref = ArtTag(leaf);
+        art->size++;
+        return OK;
+    }
+
+    // Leaf- replace node of same key, else split where keys part
+    if (ArtIsLeaf(child)) {
+        ARTLEAF *old = ArtLeaf(child);
+        if (old->length == length && memcmp(old->key, key, length) == 0) {
+            old->node = node;
+            return OK;
+        }
+
+        size_t common = 0;
+        while (ArtByte(old->key, old->length, depth + common) == ArtByte(key, length, depth + common)) {
+            common++;
+        }
+
+        leaf = ArtCreateLeaf(key, length, node);
+        if (!leaf || !(split = ArtCreateInner(art4))) {
+            free(leaf);
+            return ERROR;
+        }
+        split->prefixLength = (unsigned int) common;
+        memcpy(split->prefix, key + depth, (common < ARTPREFIX) ? (common) : (ARTPREFIX));
+        byte = ArtByte(old->key, old->length, depth + common);
+        depth += common;
+    }
+
+    else {
+        ARTINNER *inner = child;
+
+        // Compressed path parts from key- split it
+        unsigned int mismatch = (inner->prefixLength) ? (ArtMismatch(inner, key, length, depth)) : (0);
+        if (mismatch < inner->prefixLength) {
+            leaf = ArtCreateLeaf(key, length, node);
+            if (!leaf || !(split = ArtCreateInner(art4))) {
+                free(leaf);
+                return ERROR;
+            }
+            split->prefixLength = mismatch;
+            memcpy(split->prefix, inner->prefix, (mismatch < ARTPREFIX) ? (mismatch) : (ARTPREFIX));
+
+            // Node keeps the rest of its path, past the byte it's found under
+            if (inner->prefixLength <= ARTPREFIX) {
+                byte = inner->prefix[mismatch];
+                inner->prefixLength -= mismatch + 1;
+                memmove(inner->prefix, inner->prefix + mismatch + 1, inner->prefixLength);
+            }
+            else {
+                const ARTLEAF *minimum = ArtMinimum(inner);
+                byte = ArtByte(minimum->key, minimum->length, depth + mismatch);
+                inner->prefixLength -= mismatch + 1;
+                memcpy(inner->prefix, minimum->key + depth + mismatch + 1, ArtStored(inner));
+            }
+            depth += mismatch;
+        }
+
+        // Path matches- go on below, or add leaf to node
+        else {
+            depth += inner->prefixLength;
+            byte = ArtByte(key, length, depth);
+
+            void **next = ArtFindChild(inner, byte);
+            if (next) {
+                return ArtInsertAt(art, next, key, length, depth + 1, node);
+            }
+            if (!(leaf = ArtCreateLeaf(key, length, node))) {
+                return ERROR;
+            }
+            if (ArtAddChild(ref, byte, ArtTag(leaf)) != OK) {
+                free(leaf);
+                return ERROR;
+            }
+            art->size++;
+            return OK;
+        }
+    }
+
+    // Split holds old child and new leaf (room for both in Node4)
+    void *splitRef = split;
+    ArtAddChild(&splitRef, byte, child);
+    ArtAddChild(&splitRef, ArtByte(key, length, depth), ArtTag(leaf));
+    *ref = split;
+    art->size++;
+    return OK;
+}
+
+// Insert key (node of key already held is replaced)
+int ArtInsert(ART *art, const char *key, const size_t length, NODE *node) {
+    if (ArtInsertAt(art, &art->root, key, length, 0, node) != OK) {
+        fprintf(stderr, "\nArt error: allocating memory failed!\n");
+        return ERROR;
+    }
+    return OK;
+}
+
+// Remove key below reference at depth
+static NODE *ArtRemoveAt(ART *art, void **ref, const char *key, const size_t length, size_t depth) {
+    void *child = *ref;
+    NODE *node = NULL;
+
+    if (!child) {
+        return NULL;
+    }
+    if (ArtIsLeaf(child)) {
+        ARTLEAF *leaf = ArtLeaf(child);
+        if (leaf->length == length && memcmp(leaf->key, key, length) == 0) {
+            node = leaf->node;
+            free(leaf);
+            *ref = NULL;
+            art->size--;
+        }
+        return node;
+    }
+
+    ARTINNER *inner = child;
+    if (ArtMismatch(inner, key, length, depth) < inner->prefixLength) {
+        return NULL;
+    }
+    depth += inner->prefixLength;
+
+    unsigned char byte = ArtByte(key, length, depth);
+    void **next = ArtFindChild(inner, byte);
+    if (next) {
+        node = ArtRemoveAt(art, next, key, length, depth + 1);
+        if (!*next) {
+            ArtRemoveChild(ref, byte);
+        }
+    }
+    return node;
+}
+
+// Remove key (returns node it held, NULL if none)
+NODE *ArtRemove(ART *art, const char *key, const size_t length) {
+    return ArtRemoveAt(art, &art->root, key, length, 0);
+}
+
+// Remove keys starting with prefix below reference at depth
+static unsigned long ArtCutAt(ART *art, void **ref, const char *prefix, const size_t length, size_t depth) {
+    void *child = *ref;
+    unsigned long removed;
+
+    if (!child) {
+        return 0;
+    }
+    if (ArtIsLeaf(child)) {
+        ARTLEAF *leaf = ArtLeaf(child);
+        if (leaf->length < length || memcmp(leaf->key, prefix, length) != 0) {
+            return 0;
+        }
+        free(leaf);
+        *ref = NULL;
+        art->size--;
+        return 1;
+    }
+
+    // Prefix ends within compressed path- everything below starts with it
+    ARTINNER *inner = child;
+    unsigned int mismatch = ArtMismatch(inner, prefix, length, depth);
+    if (depth + mismatch >= length) {
+        removed = ArtFree(inner);
+        *ref = NULL;
+        art->size -= removed;
+        return removed;
+    }
+    if (mismatch < inner->prefixLength) {
+        return 0;
+    }
+    depth += inner->prefixLength;
+
+    unsigned char byte = (unsigned char) prefix[depth];
+    void **next = ArtFindChild(inner, byte);
+    if (!next) {
+        return 0;
+    }
+    removed = ArtCutAt(art, next, prefix, length, depth + 1);
+    if (!*next) {
+        ArtRemoveChild(ref, byte);
+    }
+    return removed;
+}
+
+// Remove every key starting with prefix (returns number of keys removed)
+unsigned long ArtRemovePrefix(ART *art, const char *prefix, const size_t length) {
+    return ArtCutAt(art, &art->root, prefix, length, 0);
+}
@@ -0,0 +1,126 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "handle.h"
+
+// Create empty handle table
+HANDLES *HandlesCreate() {
+    HANDLES *handles = calloc (1, sizeof(HANDLES));
+
+    if (handles && !(handles->slots = calloc (HANDLESLOTS, sizeof(HANDLESLOT)))) {
+        free(handles);
+        handles = NULL;
+    }
+    if (!handles) {
+        fprintf(stderr, "\nHandle error: allocating memory failed!\n");
+        return NULL;
+    }
+    handles->capacity = HANDLESLOTS;
+    handles->taken = 1;
+    return handles;
+}
+
+// Destroy handle table (NULL is ignored- nodes are not touched)
+void HandlesDestroy(HANDLES *handles) {
+    if (handles) {
+        free(handles->slots);
+        free(handles);
+    }
+}
+
+// Double slots of table (old slots are handed back through retired if given, else reallocated in place)
+static int HandlesGrow(HANDLES *handles, HANDLESLOT **retired) {
+    unsigned int capacity = (handles->capacity * 2 > HANDLELIMIT + 1) ? (HANDLELIMIT + 1) : (handles->capacity * 2);
+    HANDLESLOT *slots;
+
+    if (retired) {
+        if ((slots = malloc (sizeof(HANDLESLOT) * capacity))) {
+            memcpy(slots, handles->slots, sizeof(HANDLESLOT) * handles->capacity);
+            *retired = handles->slots;
+        }
+    }
+    else {
+        slots = realloc (handles->slots, sizeof(HANDLESLOT) * capacity);
+    }
+    if (!slots) {
+        return ERROR;
+    }
+    memset(&slots[handles->capacity], 0, sizeof(HANDLESLOT) * (capacity - handles->capacity));
+
+    // Slots before capacity- readers checking a slot against capacity must find it in slots
+    __atomic_store_n(&handles->slots, slots, __ATOMIC_RELEASE);
+    __atomic_store_n(&handles->capacity, capacity, __ATOMIC_RELEASE);
+    return OK;
+}
+
+// Take slot for node (writers only- returns handle of slot node holds if any, 0 if out of memory or slots)
+HANDLE HandleTake(HANDLES *handles, NODE *node, HANDLESLOT **retired) {
+    unsigned int slot = node->handle;
+
+    if (slot) {
+        return HandleOf(slot, handles->slots[slot].generation);
+    }
+
+    // Reuse freed slot, else take next slot never used
+    if (handles->free) {
+        slot = handles->free;
+        handles->free = handles->slots[slot].next;
+    }
+    else {
+        if (handles->taken > HANDLELIMIT) {
+            fprintf(stderr, "\nHandle error: no more than %d handles per tree!\n", HANDLELIMIT);
+            return 0;
+        }
+        if (handles->taken == handles->capacity && HandlesGrow(handles, retired) != OK) {
+            fprintf(stderr, "\nHandle error: allocating memory failed!\n");
+            return 0;
+        }
+        slot = handles->taken++;
+    }
+
+    __atomic_store_n(&handles->slots[slot].node, node, __ATOMIC_RELEASE);
+    handles->used++;
+    node->handle = (unsigned short) slot;
+    return HandleOf(slot, handles->slots[slot].generation);
+}
+
+// Release slot of node being freed (NULL handles and nodes without slot are ignored- lock free, see handle.h)
+void HandleRelease(HANDLES *handles, NODE *node) {
+    unsigned int slot = node->handle,
+                 next;
+
+    if (!handles || !slot) {
+        return;
+    }
+
+    // Stale before node goes
+    HANDLESLOT *released = &handles->slots[slot];
+    __atomic_add_fetch(&released->generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&released->node, NULL, __ATOMIC_RELEASE);
+    __atomic_sub_fetch(&handles->used, 1, __ATOMIC_RELAXED);
+    node->handle = 0;
+
+    // Push on free list (slots are only taken by writers, never while subtrees are freed- no ABA)
+    next = __atomic_load_n(&handles->free, __ATOMIC_RELAXED);
+    do {
+        released->next = next;
+    } while (!__atomic_compare_exchange_n(&handles->free, &next, slot, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// Get node of handle (NULL if handle is stale- concurrent readers must validate against writers, see ReadHandle)
+NODE *HandleNode(HANDLES *handles, const HANDLE handle) {
+    unsigned int slot = HandleSlot(handle),
+                 capacity = (handles) ? (__atomic_load_n(&handles->capacity, __ATOMIC_ACQUIRE)) : (0);
+
+    if (slot == 0 || slot >= capacity) {
+        return NULL;
+    }
+
+    HANDLESLOT *slots = __atomic_load_n(&handles->slots, __ATOMIC_ACQUIRE);
+    NODE *node = __atomic_load_n(&slots[slot].node, __ATOMIC_ACQUIRE);
+    return (__atomic_load_n(&slots[slot].generation, __ATOMIC_ACQUIRE) == HandleGeneration(handle)) ? (node) : (NULL);
+}
@@ -0,0 +1,570 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+#include "index.h"
+
+// Round up to section alignment
+#define ALIGN8(x) (((x) + 7) & ~((uint64_t) 7))
+
+// Key of image node
+#define IMAGEKEY(image, i) ((image)->pool + (image)->nodes[i].key)
+
+// Set section pointers from header (no checks- usage is ImageBuild() and ImageOpen())
+static void ImageSections(IMAGE *image) {
+    image->header = image->memory;
+    image->nodes = (const IMAGENODE *) ((const char *) image->memory + image->header->nodes);
+    image->slots = (const uint32_t *) ((const char *) image->memory + image->header->slots);
+    image->buckets = (const uint32_t *) ((const char *) image->memory + image->header->buckets);
+    image->paths = (const uint32_t *) ((const char *) image->memory + image->header->paths);
+    image->pool = (const char *) image->memory + image->header->pool;
+}
+
+// Mix bits of hash (FNV leaves high bits poorly mixed for short keys)
+static uint64_t ImageMix(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9UL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebUL;
+    return hash ^ (hash >> 31);
+}
+
+// Bucket of path hash, and slot of path hash under seed of its bucket
+#define ImageBucket(hash, numBuckets)       (ImageMix(hash) % (numBuckets))
+#define ImageSlot(hash, seed, numPaths)     (ImageMix((hash) ^ ((uint64_t) (seed) * 0x9E3779B97F4A7C15UL)) % (numPaths))
+
+// Order buckets by size (size in high half), largest first
+static int CompareBuckets(const void *x, const void *y) {
+    uint64_t a = *(const uint64_t *) x,
+             b = *(const uint64_t *) y;
+    return (a < b) - (a > b);
+}
+
+// Build perfect hash of full paths of node table (ERROR if out of memory or seeds- sections are left unused then)
+static int ImagePaths(const IMAGENODE *table, const char *strings, const uint64_t numNodes,
+                      uint32_t *buckets, const uint64_t numBuckets, uint32_t *paths) {
+    uint64_t numPaths = numNodes - 1,
+             *hashes = malloc (sizeof(uint64_t) * numNodes),
+             *order = calloc (numBuckets, sizeof(uint64_t)),
+             *placed = NULL,
+             i, z, o;
+    uint32_t *first = calloc (numBuckets + 1, sizeof(uint32_t)),
+             *members = malloc (sizeof(uint32_t) * numPaths),
+             seed = 0;
+    unsigned char *taken = calloc (numPaths, 1);
+    short int iRc = (hashes && order && first && members && taken) ? (OK) : (ERROR);
+
+    // Hash paths (parents come first in breadth first order- a path continues the hash of its parent)
+    for (i = 1; iRc == OK && i < numNodes; ++i) {
+        const char *key = strings + table[i].key;
+        uint32_t parent = table[i].parent;
+
+        hashes[i] = (parent) ? (HashKeyMore(HashKeyMore(hashes[parent], ".", 1), key, table[i].keyLength)) :
+                               (HashKeyLength(key, table[i].keyLength));
+        first[ImageBucket(hashes[i], numBuckets) + 1]++;
+    }
+
+    // Paths of each bucket in a row (counting sort)
+    if (iRc == OK) {
+        for (i = 0; i < numBuckets; ++i) {
+            order[i] = ((uint64_t) first[i + 1] << 32) | i;
+            first[i + 1] += first[i];
+        }
+        for (i = 1; i < numNodes; ++i) {
+            members[first[ImageBucket(hashes[i], numBuckets)]++] = (uint32_t) i;
+        }
+        for (i = numBuckets; i > 0; --i) {
+            first[i] = first[i - 1];
+        }
+        first[0] = 0;
+
+        qsort(order, numBuckets, sizeof(uint64_t), CompareBuckets);
+        if (!(placed = malloc (sizeof(uint64_t) * ((order[0] >> 32) + 1)))) {
+            iRc = ERROR;
+        }
+    }
+
+    // Find seed placing every path of bucket in a free slot (largest buckets first, while most slots are free)
+    for (o = 0; iRc == OK && o < numBuckets && (order[o] >> 32) > 1; ++o) {
+        uint64_t bucket = order[o] & 0xffffffffUL,
+                 size = order[o] >> 32;
+
+        for (seed = 1; seed < IMAGESEEDS; ++seed) {
+            for (z = 0; z < size; ++z) {
+                placed[z] = ImageSlot(hashes[members[first[bucket] + z]], seed, numPaths);
+                if (taken[placed[z]]) {
+                    break;
+                }
+                taken[placed[z]] = TRUE;
+            }
+            if (z == size) {
+                break;
+            }
+            while (z--) {
+                taken[placed[z]] = FALSE;
+            }
+        }
+        if (seed == IMAGESEEDS) {
+            iRc = ERROR;
+            break;
+        }
+
+        buckets[bucket] = seed;
+        for (z = 0; z < size; ++z) {
+            paths[placed[z]] = members[first[bucket] + z];
+        }
+    }
+
+    // Single paths take free slots in order
+    for (z = 0; iRc == OK && o < numBuckets && (order[o] >> 32) == 1; ++o) {
+        uint64_t bucket = order[o] & 0xffffffffUL;
+        while (taken[z]) {
+            z++;
+        }
+        buckets[bucket] = IMAGEDIRECT | (uint32_t) z;
+        paths[z++] = members[first[bucket]];
+    }
+
+    free(hashes);
+    free(order);
+    free(placed);
+    free(first);
+    free(members);
+    free(taken);
+    return iRc;
+}
+
+// Build image of tree in memory (nodes in breadth first order)
+IMAGE *ImageBuild(NODE *root) {
+    if (!root) {
+        return NULL;
+    }
+
+    // Breadth first order (queue doubles as node table order)
+    unsigned long numNodes = 1,
+                  capNodes = MEMLIMIT,
+                  i, z;
+    uint64_t poolSize = 0;
+    NODE **queue = malloc (sizeof(NODE *) * capNodes);
+    if (!queue) {
+        fprintf(stderr, "\nImage error: allocating memory failed!\n");
+        return NULL;
+    }
+    queue[0] = root;
+
+    for (i = 0; i < numNodes; ++i) {
+        NODE *node = queue[i];
+        poolSize += strlen(NodeKey(node)) + 1;
+        if (node->type == stringValue) {
+            poolSize += strlen(node->value.string) + 1;
+        }
+
+        if (numNodes + node->numChildren > capNodes) {
+            while (numNodes + node->numChildren > capNodes) {
+                capNodes *= 2;
+            }
+            NODE **temp = realloc (queue, sizeof(NODE *) * capNodes);
+            if (!temp) {
+                fprintf(stderr, "\nImage error: allocating memory failed!\n");
+                free(queue);
+                return NULL;
+            }
+            queue = temp;
+        }
+        if (node->numChildren) {
+            memcpy(&queue[numNodes], node->children, sizeof(NODE *) * node->numChildren);
+            numNodes += node->numChildren;
+        }
+    }
+
+    // Key slots at most half full
+    uint64_t numSlots = 0;
+    if (UNIQUEKEYS == TRUE) {
+        numSlots = INDEXSLOTS;
+        while (numSlots < numNodes * 2) {
+            numSlots <<= 1;
+        }
+    }
+
+    // Perfect hash of every path (slots are node indices, so paths must fit IMAGEDIRECT)
+    uint64_t numPaths = (numNodes > 1 && numNodes <= IMAGEDIRECT) ? (numNodes - 1) : (0),
+             numBuckets = (numPaths) ? (numPaths / IMAGEBUCKET + 1) : (0);
+
+    // Lay out sections
+    uint64_t nodes = ALIGN8(sizeof(IMAGEHEADER)),
+             slots = ALIGN8(nodes + sizeof(IMAGENODE) * numNodes),
+             buckets = ALIGN8(slots + sizeof(uint32_t) * numSlots),
+             paths = ALIGN8(buckets + sizeof(uint32_t) * numBuckets),
+             pool = ALIGN8(paths + sizeof(uint32_t) * numPaths),
+             size = ALIGN8(pool + poolSize);
+
+    IMAGE *image = calloc (1, sizeof(IMAGE));
+    void *memory = calloc (1, (size_t) size);
+    if (!image || !memory) {
+        fprintf(stderr, "\nImage error: allocating memory failed!\n");
+        free(image);
+        free(memory);
+        free(queue);
+        return NULL;
+    }
+
+    IMAGEHEADER *header = memory;
+    memcpy(header->magic, IMAGEMAGIC, sizeof(header->magic));
+    header->version = IMAGEVERSION;
+    header->size = size;
+    header->numNodes = numNodes;
+    header->numSlots = numSlots;
+    header->poolSize = poolSize;
+    header->nodes = nodes;
+    header->slots = slots;
+    header->pool = pool;
+    header->buckets = buckets;
+    header->paths = paths;
+
+    IMAGENODE *table = (IMAGENODE *) ((char *) memory + nodes);
+    uint32_t *slot = (uint32_t *) ((char *) memory + slots);
+    char *strings = (char *) memory + pool;
+    uint64_t used = 0;
+    unsigned long next = 1;     // Index of first child of next parent
+
+    for (i = 0; i < numNodes; ++i) {
+        NODE *node = queue[i];
+        size_t length = strlen(NodeKey(node));
+
+        table[i].keyLength = (uint32_t) length;
+        table[i].key = used;
+        memcpy(strings + used, NodeKey(node), length + 1);
+        used += length + 1;
+
+        table[i].integer = (node->type == integerValue) ? (node->value.integer) : (0);
+        table[i].string = IMAGENONE;
+        if (node->type == stringValue) {
+            length = strlen(node->value.string);
+            table[i].string = used;
+            memcpy(strings + used, node->value.string, length + 1);
+            used += length + 1;
+        }
+
+        // Children were queued in order, one range per parent
+        table[i].firstChild = (uint32_t) next;
+        table[i].numChildren = node->numChildren;
+        for (z = 0; z < node->numChildren; ++z) {
+            table[next + z].parent = (uint32_t) i;
+        }
+        next += node->numChildren;
+
+        // Slot by key hash
+        if (numSlots) {
+            uint64_t mask = numSlots - 1,
+                     s = HashKey(NodeKey(node)) & mask;
+            while (slot[s]) {
+                s = (s + 1) & mask;
+            }
+            slot[s] = (uint32_t) (i + 1);
+        }
+    }
+    free(queue);
+
+    // Without perfect hash paths are walked (sections stay unused)
+    if (numPaths && ImagePaths(table, strings, numNodes, (uint32_t *) ((char *) memory + buckets), numBuckets,
+                               (uint32_t *) ((char *) memory + paths)) == OK) {
+        header->numPaths = numPaths;
+        header->numBuckets = numBuckets;
+    }
+
+    image->memory = memory;
+    image->size = (size_t) size;
+    ImageSections(image);
+    return image;
+}
+
+// Write image to file (written to temporary file first, replaces file when complete)
+int ImageWrite(const IMAGE *image, const char *fileName) {
+    if (!image || !fileName) {
+        return ERROR;
+    }
+
+    char *temporary = malloc (strlen(fileName) + 5);
+    if (!temporary) {
+        return ERROR;
+    }
+    sprintf(temporary, "%s.tmp", fileName);
+
+    short int iRc = OK;
+    int file = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        fprintf(stderr, "\nImage error: problem creating file '%s'.\n", temporary);
+        free(temporary);
+        return ERROR;
+    }
+
+    const char *cursor = image->memory;
+    size_t left = image->size;
+    while (left) {
+        ssize_t written = write(file, cursor, left);
+        if (written <= 0) {
+            fprintf(stderr, "\nImage error: problem writing file '%s'.\n", temporary);
+            iRc = ERROR;
+            break;
+        }
+        cursor += written;
+        left -= (size_t) written;
+    }
+
+    if (close(file) != 0 || iRc != OK || rename(temporary, fileName) != 0) {
+        unlink(temporary);
+        iRc = ERROR;
+    }
+    free(temporary);
+    return iRc;
+}
+
+// Open image file (mapped read only- nothing is parsed or copied)
+IMAGE *ImageOpen(const char *fileName) {
+    int file = open(fileName, O_RDONLY);
+    struct stat status;
+
+    if (file < 0 || fstat(file, &status) != 0 || (size_t) status.st_size < sizeof(IMAGEHEADER)) {
+        fprintf(stderr, "\nImage error: problem reading file '%s'.\n", fileName);
+        if (file >= 0) {
+            close(file);
+        }
+        return NULL;
+    }
+
+    void *memory = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (memory == MAP_FAILED) {
+        fprintf(stderr, "\nImage error: problem mapping file '%s'.\n", fileName);
+        return NULL;
+    }
+
+    // Check header against file before trusting any offsets
+    const IMAGEHEADER *header = memory;
+    uint64_t size = (uint64_t) status.st_size;
+    if (memcmp(header->magic, IMAGEMAGIC, sizeof(header->magic)) != 0 || header->version != IMAGEVERSION
+        || header->size != size || header->numNodes == 0
+        || header->nodes > size || header->numNodes > (size - header->nodes) / sizeof(IMAGENODE)
+        || header->slots > size || header->numSlots > (size - header->slots) / sizeof(uint32_t)
+        || (header->numSlots & (header->numSlots - 1)) != 0
+        || (header->numPaths && (header->numPaths != header->numNodes - 1 || header->numBuckets == 0))
+        || header->buckets > size || header->numBuckets > (size - header->buckets) / sizeof(uint32_t)
+        || header->paths > size || header->numPaths > (size - header->paths) / sizeof(uint32_t)
+        || header->pool > size || header->poolSize > size - header->pool || header->poolSize == 0
+        || ((const char *) memory)[header->pool + header->poolSize - 1] != '\0') {
+        fprintf(stderr, "\nImage error: '%s' is not a valid image.\n", fileName);
+        munmap(memory, (size_t) status.st_size);
+        return NULL;
+    }
+
+    IMAGE *image = calloc (1, sizeof(IMAGE));
+    if (!image) {
+        munmap(memory, (size_t) status.st_size);
+        return NULL;
+    }
+    image->memory = memory;
+    image->size = (size_t) status.st_size;
+    image->mapped = TRUE;
+    ImageSections(image);
+    return image;
+}
+
+// Close image (unmaps or frees it)
+void ImageClose(IMAGE *image) {
+    if (!image) {
+        return;
+    }
+    if (image->mapped) {
+        munmap(image->memory, image->size);
+    }
+    else {
+        free(image->memory);
+    }
+    free(image);
+}
+
+// Find child by binary search over children range (-1 if none)
+long ImageFindChild(const IMAGE *image, const long parent, const char *key, const size_t length) {
+    long low = image->nodes[parent].firstChild,
+         high = low + image->nodes[parent].numChildren - 1,
+         mid;
+
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+
+        const char *childKey = IMAGEKEY(image, mid);
+        int cmp = strncmp(childKey, key, length);
+        if (cmp == 0 && childKey[length] != '\0') {
+            cmp = 1;
+        }
+
+        if (cmp == 0) {
+            return mid;
+        }
+        else if (cmp < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return -1;
+}
+
+// Find node by full path from root through perfect hash (-1 if none- not null terminated)
+long ImageFindPath(const IMAGE *image, const char *path, size_t length) {
+    const IMAGEHEADER *header = image->header;
+
+    if (!header->numPaths || !length) {
+        return -1;
+    }
+
+    uint64_t hash = HashKeyLength(path, length);
+    uint32_t seed = image->buckets[ImageBucket(hash, header->numBuckets)];
+    uint64_t slot = (seed & IMAGEDIRECT) ? (seed & ~IMAGEDIRECT) : (ImageSlot(hash, seed, header->numPaths));
+    long node = (slot < header->numPaths) ? ((long) image->paths[slot]) : (0),
+         found = node;
+
+    if (node <= 0 || (uint64_t) node >= header->numNodes) {
+        return -1;
+    }
+
+    // Check path against keys from node up (any path hashes to some slot)
+    while (node != 0) {
+        const IMAGENODE *current = &image->nodes[node];
+
+        if (current->keyLength > length || current->parent >= node
+            || memcmp(path + length - current->keyLength, IMAGEKEY(image, node), current->keyLength) != 0) {
+            return -1;
+        }
+        length -= current->keyLength;
+        node = current->parent;
+
+        if (node != 0) {
+            if (length == 0 || path[length - 1] != '.') {
+                return -1;
+            }
+            length--;
+        }
+    }
+    return (length == 0) ? (found) : (-1);
+}
+
+// Find node below given node by path or key (-1 if none, same rules as Search)
+long ImageFind(const IMAGE *image, const long from, const char *targetKey) {
+    if (!image || !targetKey) {
+        return -1;
+    }
+
+    // Paths from root in one probe (up to first "*" component, a single trailing '.' is ignored- as walked below)
+    if (from == 0) {
+        const char *star = targetKey;
+        size_t length;
+
+        while ((star = strchr(star, '*')) && !((star == targetKey || star[-1] == '.') && (star[1] == '.' || !star[1]))) {
+            star++;
+        }
+        length = (star) ? ((size_t) (star - targetKey)) : (strlen(targetKey));
+        if (length && targetKey[length - 1] == '.') {
+            length--;
+        }
+
+        long node = ImageFindPath(image, targetKey, length);
+        if (node >= 0) {
+            return node;
+        }
+    }
+
+    // Walk path through sorted children ranges
+    if (UNIQUEKEYS == FALSE || strchr(targetKey, '.')) {
+        const char *component = targetKey,
+                   *end;
+        long current = from;
+
+        while (current >= 0 && *component) {
+            end = strchr(component, '.');
+            size_t length = (end) ? ((size_t) (end - component)) : (strlen(component));
+
+            if (length == 1 && *component == '*') {
+                break;
+            }
+
+            long child = ImageFindChild(image, current, component, length);
+
+            // Path may start with key of given node
+            if (child < 0 && current == from && component == targetKey
+                && strncmp(IMAGEKEY(image, from), component, length) == 0 && IMAGEKEY(image, from)[length] == '\0') {
+                child = from;
+            }
+            current = child;
+
+            component += length;
+            if (*component == '.') {
+                component++;
+            }
+        }
+
+        if (current >= 0 || UNIQUEKEYS == FALSE) {
+            return current;
+        }
+    }
+
+    if (!image->header->numSlots) {
+        return -1;
+    }
+
+    // End key (excl. "*")
+    const char *key = targetKey,
+               *dot;
+    size_t length = strlen(key);
+    while (length && key[length - 1] == '*') {
+        length--;
+    }
+    while (length && key[length - 1] == '.') {
+        length--;
+    }
+    for (dot = key; (dot = memchr(key, '.', length)); ) {
+        length -= (size_t) (dot + 1 - key);
+        key = dot + 1;
+    }
+
+    // Probe key slots
+    uint64_t mask = image->header->numSlots - 1,
+             s = HashKeyLength(key, length) & mask;
+
+    while (image->slots[s]) {
+        long node = (long) image->slots[s] - 1;
+        if (image->nodes[node].keyLength == length && memcmp(IMAGEKEY(image, node), key, length) == 0) {
+            // Must be below given node
+            long ancestor = node;
+            while (ancestor != from && ancestor != 0) {
+                ancestor = image->nodes[ancestor].parent;
+            }
+            return (ancestor == from) ? (node) : (-1);
+        }
+        s = (s + 1) & mask;
+    }
+    return -1;
+}
+
+// Get node type of image node
+enum nodeType ImageNodeType(const IMAGE *image, const long node) {
+    if (node < 0) {
+        return noSuchNode;
+    }
+    else if (image->nodes[node].numChildren != 0) {
+        return parentNode;
+    }
+    else if (image->nodes[node].string != IMAGENONE) {
+        return stringNode;
+    }
+    return integerNode;
+}
@@ -0,0 +1,210 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "index.h"
+
+// Hash key (64 bit FNV-1a)
+unsigned long HashKey(const char *key) {
+    unsigned long hash = 14695981039346656037UL;
+
+    while (*key) {
+        hash ^= (unsigned char) *key++;
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+// Hash key of given length (not null terminated, same hash as HashKey)
+unsigned long HashKeyLength(const char *key, const size_t length) {
+    return HashKeyMore(14695981039346656037UL, key, length);
+}
+
+// Continue hash over more of key (so paths may be hashed one component after the other)
+unsigned long HashKeyMore(unsigned long hash, const char *key, const size_t length) {
+    size_t i;
+
+    for (i = 0; i < length; ++i) {
+        hash ^= (unsigned char) key[i];
+        hash *= 1099511628211UL;
+    }
+    return hash;
+}
+
+// Create index with given amount of slots (rounded up to power of two)
+INDEX *IndexCreate(unsigned long capacity) {
+    unsigned long slots = INDEXSLOTS;
+
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    INDEX *index = calloc (1, sizeof(INDEX) + sizeof(INDEXSLOT) * slots);
+    if (!index) {
+        fprintf(stderr, "\nIndex error: allocating memory failed!\n");
+        return NULL;
+    }
+    index->capacity = slots;
+    return index;
+}
+
+// Destroy index (nodes are not owned by index)
+void IndexDestroy(INDEX *index) {
+    free (index);
+}
+
+// Place node in first free slot (no checks- usage is IndexInsert())
+static void IndexPlace(INDEX *index, NODE *node, const unsigned long hash) {
+    unsigned long mask = index->capacity - 1,
+                  i = hash & mask;
+
+    while (index->slots[i].node && index->slots[i].node != TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+
+    if (index->slots[i].node == TOMBSTONE) {
+        index->tombstones--;
+    }
+    index->slots[i].hash = hash;
+    __atomic_store_n(&index->slots[i].node, node, __ATOMIC_RELEASE);
+    index->used++;
+}
+
+// Rebuild index into new slots (grows to hold count nodes at below half load, drops tombstones- old index is handed
+// to retired if given)
+static int IndexRebuild(INDEX **index, const unsigned long count, INDEX **retired) {
+    INDEX *old = *index;
+    unsigned long capacity = old->capacity, i;
+
+    // Keep load (excl. tombstones) below one half
+    while (count * 2 > capacity) {
+        capacity <<= 1;
+    }
+
+    INDEX *new = IndexCreate(capacity);
+    if (!new) {
+        return ERROR;
+    }
+
+    for (i = 0; i < old->capacity; ++i) {
+        if (old->slots[i].node && old->slots[i].node != TOMBSTONE) {
+            IndexPlace(new, old->slots[i].node, old->slots[i].hash);
+        }
+    }
+
+    // Published once filled (concurrent readers load index by acquire, see ReadFind)
+    __atomic_store_n(index, new, __ATOMIC_RELEASE);
+    if (retired) {
+        *retired = old;
+    }
+    else {
+        IndexDestroy(old);
+    }
+    return OK;
+}
+
+// Insert node by its key (key must not already be indexed, old index is handed to retired if rebuilt)
+int IndexInsert(INDEX **index, NODE *node, INDEX **retired) {
+    if (!index || !*index || !node) {
+        return ERROR;
+    }
+
+    // Keep load (incl. tombstones) below three quarters
+    if (((*index)->used + (*index)->tombstones + 1) * 4 > (*index)->capacity * 3) {
+        if (IndexRebuild(index, (*index)->used + 1, retired) != OK) {
+            return ERROR;
+        }
+    }
+
+    IndexPlace(*index, node, HashKey(NodeKey(node)));
+    return OK;
+}
+
+// Make room for count more nodes (rebuilt once rather than grown step by step, old index is handed to retired if rebuilt)
+int IndexReserve(INDEX **index, const unsigned long count, INDEX **retired) {
+    if (!index || !*index) {
+        return ERROR;
+    }
+
+    if (((*index)->used + (*index)->tombstones + count) * 4 > (*index)->capacity * 3) {
+        return IndexRebuild(index, (*index)->used + count, retired);
+    }
+    return OK;
+}
+
+// Place node of known hash into slots before end (no growing- threads may place into separate ranges of slots at
+// once, ERROR if probing reaches end- end at home slot of hash probes every slot)
+int IndexPlaceRange(INDEX *index, NODE *node, const unsigned long hash, const unsigned long end) {
+    unsigned long mask = index->capacity - 1,
+                  i = hash & mask;
+
+    while (index->slots[i].node && index->slots[i].node != TOMBSTONE) {
+        i = (i + 1) & mask;
+        if (i == end) {
+            return ERROR;
+        }
+    }
+
+    if (index->slots[i].node == TOMBSTONE) {
+        __atomic_sub_fetch(&index->tombstones, 1, __ATOMIC_RELAXED);
+    }
+    index->slots[i].hash = hash;
+    __atomic_store_n(&index->slots[i].node, node, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&index->used, 1, __ATOMIC_RELAXED);
+    return OK;
+}
+
+// Remove node from index
+int IndexRemove(INDEX *index, const NODE *node) {
+    if (!index || !node) {
+        return ERROR;
+    }
+
+    unsigned long mask = index->capacity - 1,
+                  i = HashKey(NodeKey(node)) & mask;
+
+    // Probe until empty slot
+    NODE *slot;
+    while ((slot = __atomic_load_n(&index->slots[i].node, __ATOMIC_RELAXED))) {
+        if (slot == node) {
+            // Removals may run on several threads at once (parallel Delete)- counters are shared
+            __atomic_store_n(&index->slots[i].node, TOMBSTONE, __ATOMIC_RELAXED);
+            __atomic_sub_fetch(&index->used, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&index->tombstones, 1, __ATOMIC_RELAXED);
+            return OK;
+        }
+        i = (i + 1) & mask;
+    }
+    return ERROR;
+}
+
+// Find node by key (NULL if not indexed)
+NODE *IndexLookup(const INDEX *index, const char *key) {
+    return (key) ? (IndexLookupLength(index, key, strlen(key))) : (NULL);
+}
+
+// Find node by key of given length (not null terminated)
+NODE *IndexLookupLength(const INDEX *index, const char *key, const size_t length) {
+    if (!index || !key) {
+        return NULL;
+    }
+
+    unsigned long hash = HashKeyLength(key, length),
+                  mask = index->capacity - 1,
+                  i = hash & mask;
+
+    // Probe until empty slot (slot is loaded once- concurrent readers probe while writers remove nodes)
+    NODE *node;
+    while ((node = __atomic_load_n(&index->slots[i].node, __ATOMIC_ACQUIRE))) {
+        // Pooled keys are equal if their pointers are (key handed in from pool of tree)
+        if (node != TOMBSTONE && index->slots[i].hash == hash
+            && (NodeKey(node) == key || strncmp(NodeKey(node), key, length) == 0) && NodeKey(node)[length] == '\0') {
+            return node;
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
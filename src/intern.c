@@ -0,0 +1,149 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "index.h"
+
+// Create empty pool
+INTERN *InternCreate() {
+    INTERN *intern = calloc (1, sizeof(INTERN));
+
+    if (intern && !(intern->slots = calloc (INTERNSLOTS, sizeof(INTERNED *)))) {
+        free(intern);
+        intern = NULL;
+    }
+    if (!intern) {
+        fprintf(stderr, "\nIntern error: allocating memory failed!\n");
+        return NULL;
+    }
+    intern->capacity = INTERNSLOTS;
+    return intern;
+}
+
+// Destroy pool and every string in it (NULL is ignored)
+void InternDestroy(INTERN *intern) {
+    unsigned long i;
+
+    if (!intern) {
+        return;
+    }
+    for (i = 0; i < intern->capacity; ++i) {
+        if (intern->slots[i] && intern->slots[i] != RELEASED) {
+            free(intern->slots[i]);
+        }
+    }
+    free(intern->slots);
+    free(intern);
+}
+
+// Rebuild slots to hold strings at below a quarter load (drops released slots)
+static int InternRebuild(INTERN *intern) {
+    unsigned long capacity = INTERNSLOTS,
+                  i, j;
+
+    while (intern->used * 4 >= capacity) {
+        capacity <<= 1;
+    }
+
+    INTERNED **slots = calloc (capacity, sizeof(INTERNED *));
+    if (!slots) {
+        return ERROR;
+    }
+
+    for (i = 0; i < intern->capacity; ++i) {
+        if (intern->slots[i] && intern->slots[i] != RELEASED) {
+            j = intern->slots[i]->hash & (capacity - 1);
+            while (slots[j]) {
+                j = (j + 1) & (capacity - 1);
+            }
+            slots[j] = intern->slots[i];
+        }
+    }
+
+    free(intern->slots);
+    intern->slots = slots;
+    intern->capacity = capacity;
+    intern->released = 0;
+    return OK;
+}
+
+// Intern string of given length (not null terminated- returns pooled text holding a reference, NULL if out of memory)
+char *InternString(INTERN *intern, const char *string, const size_t length) {
+    unsigned long hash = HashKeyLength(string, length),
+                  mask = intern->capacity - 1,
+                  i = hash & mask;
+    long vacant = -1;
+
+    // Probe until empty slot (first released slot is reused)
+    while (intern->slots[i]) {
+        INTERNED *interned = intern->slots[i];
+
+        if (interned == RELEASED) {
+            vacant = (vacant < 0) ? ((long) i) : (vacant);
+        }
+        else if (interned->hash == hash && interned->length == length && memcmp(interned->text, string, length) == 0) {
+            interned->refs++;
+            intern->holders++;
+            return interned->text;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // Keep load (incl. released slots) below one half
+    if ((intern->used + intern->released + 1) * 2 > intern->capacity) {
+        if (InternRebuild(intern) != OK) {
+            return NULL;
+        }
+        mask = intern->capacity - 1;
+        for (i = hash & mask; intern->slots[i]; i = (i + 1) & mask) {}
+        vacant = -1;
+    }
+
+    INTERNED *interned = malloc (sizeof(INTERNED) + length + 1);
+    if (!interned) {
+        return NULL;
+    }
+    interned->refs = 1;
+    interned->hash = hash;
+    interned->length = length;
+    memcpy(interned->text, string, length);
+    interned->text[length] = '\0';
+
+    if (vacant >= 0) {
+        i = (unsigned long) vacant;
+        intern->released--;
+    }
+    intern->slots[i] = interned;
+    intern->used++;
+    intern->holders++;
+    intern->bytes += length + 1;
+    return interned->text;
+}
+
+// Drop reference to pooled text (returns memory to free once last holder is gone- NULL while it's still held)
+void *InternRelease(INTERN *intern, const char *text) {
+    INTERNED *interned = InternOf(text);
+
+    intern->holders--;
+    if (--interned->refs > 0) {
+        return NULL;
+    }
+
+    // Unlink from pool (memory goes with caller- concurrent trees retire it)
+    unsigned long mask = intern->capacity - 1,
+                  i = interned->hash & mask;
+    while (intern->slots[i] && intern->slots[i] != interned) {
+        i = (i + 1) & mask;
+    }
+    if (intern->slots[i]) {
+        intern->slots[i] = RELEASED;
+        intern->used--;
+        intern->released++;
+        intern->bytes -= interned->length + 1;
+    }
+    return interned;
+}
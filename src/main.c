@@ -38,11 +38,12 @@ int main(void) {
     Enumerate(&root, "config.*");
 
     // Test Get Value
+    DATA value;
     printf("\nTest get value:");
     printf("\nTest get value returning ");
-    PrintValue(GetValue(&root, "button_cancel"));
+    PrintValue(GetValue(&root, "button_cancel", &value));
     printf("\n\nThen integerTest only using keys: ");
-    PrintValue(GetValue(&root, "integerTest"));
+    PrintValue(GetValue(&root, "integerTest", &value));
 
     Enumerate(&root, "config");
 
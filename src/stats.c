@@ -0,0 +1,162 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "stats.h"
+
+// Counters of thread (listed, so they can be summed while the thread counts)
+typedef struct _STATTHREAD {
+    STATCOUNTERS    counters;
+    unsigned long   started[STATOPS];   // Operations started     (picks operations to time)
+    struct _STATTHREAD *next;
+} STATTHREAD;
+
+static _Thread_local STATTHREAD *local = NULL;
+
+static pthread_mutex_t statLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t statOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t statKey;
+static STATTHREAD *threads = NULL;      // Counters of running threads
+static STATCOUNTERS exited;             // Counters of threads that have exited
+
+// Number of counters (STATCOUNTERS holds unsigned longs only)
+#define STATFIELDS (sizeof(STATCOUNTERS) / sizeof(unsigned long))
+
+// Count into counter of own thread (relaxed store- summing threads may read it meanwhile)
+#define StatAdd(counter, value) \
+    __atomic_store_n(&(counter), (counter) + (value), __ATOMIC_RELAXED)
+
+// Fold counters of exiting thread into total
+static void StatsExit(void *argument) {
+    STATTHREAD *thread = argument,
+               **link;
+    const unsigned long *counters = (const unsigned long *) &thread->counters;
+    unsigned long *total = (unsigned long *) &exited;
+    size_t i;
+
+    pthread_mutex_lock(&statLock);
+    for (link = &threads; *link && *link != thread; link = &(*link)->next) {}
+    if (*link) {
+        *link = thread->next;
+    }
+    for (i = 0; i < STATFIELDS; ++i) {
+        total[i] += counters[i];
+    }
+    pthread_mutex_unlock(&statLock);
+    free(thread);
+}
+
+// Create key freeing counters of exiting threads
+static void StatsInit() {
+    pthread_key_create(&statKey, StatsExit);
+}
+
+// Get counters of thread (NULL if allocating memory failed- nothing is counted then)
+static STATTHREAD *StatsThread() {
+    if (local) {
+        return local;
+    }
+
+    STATTHREAD *thread = calloc (1, sizeof(STATTHREAD));
+    if (!thread) {
+        return NULL;
+    }
+    pthread_once(&statOnce, StatsInit);
+    pthread_setspecific(statKey, thread);
+
+    pthread_mutex_lock(&statLock);
+    thread->next = threads;
+    threads = thread;
+    pthread_mutex_unlock(&statLock);
+    return local = thread;
+}
+
+// Get bucket of value in log2 histogram (number of significant bits)
+unsigned int StatsBucket(const unsigned long value) {
+    unsigned int bucket = (value) ? ((unsigned int) (sizeof(unsigned long) * 8 - __builtin_clzl(value))) : (0);
+    return (bucket < STATBUCKETS) ? (bucket) : (STATBUCKETS - 1);
+}
+
+// Start counted operation (returns start time in nanoseconds if operation is timed, else 0)
+unsigned long StatsBegin(const enum statOp op) {
+    STATTHREAD *thread = StatsThread();
+    struct timespec now;
+
+    if (!thread || (thread->started[op]++ & (STATSAMPLE - 1)) != 0) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long) now.tv_sec * 1000000000UL + (unsigned long) now.tv_nsec + 1;
+}
+
+// End counted operation (started is returned by StatsBegin)
+void StatsEnd(const enum statOp op, const unsigned long started, const short int failed) {
+    STATTHREAD *thread = StatsThread();
+    struct timespec now;
+
+    if (!thread) {
+        return;
+    }
+
+    STATOP *counters = &thread->counters.ops[op];
+    StatAdd(counters->calls, 1);
+    if (failed) {
+        StatAdd(counters->failures, 1);
+    }
+
+    if (started) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        unsigned long elapsed = (unsigned long) now.tv_sec * 1000000000UL + (unsigned long) now.tv_nsec + 1 - started;
+
+        StatAdd(counters->timed, 1);
+        StatAdd(counters->nanoseconds, elapsed);
+        StatAdd(counters->latency[StatsBucket(elapsed)], 1);
+    }
+}
+
+// Count search visiting given number of nodes
+void StatsVisited(const unsigned long visited) {
+    STATTHREAD *thread = StatsThread();
+
+    if (thread) {
+        StatAdd(thread->counters.searches, 1);
+        StatAdd(thread->counters.visited, visited);
+        StatAdd(thread->counters.visits[StatsBucket(visited)], 1);
+    }
+}
+
+// Count bytes of tree memory allocated and freed
+void StatsMemory(const size_t allocated, const size_t freed, const short int reallocated) {
+    STATTHREAD *thread = StatsThread();
+
+    if (thread) {
+        if (reallocated) {
+            StatAdd(thread->counters.reallocs, 1);
+        }
+        StatAdd(thread->counters.allocated, allocated);
+        StatAdd(thread->counters.freed, freed);
+    }
+}
+
+// Sum counters of every thread (incl. threads that have exited)
+void StatsCollect(STATCOUNTERS *total) {
+    unsigned long *sum = (unsigned long *) total;
+    const unsigned long *counters;
+    STATTHREAD *thread;
+    size_t i;
+
+    pthread_mutex_lock(&statLock);
+    memcpy(total, &exited, sizeof(STATCOUNTERS));
+    for (thread = threads; thread; thread = thread->next) {
+        counters = (const unsigned long *) &thread->counters;
+        for (i = 0; i < STATFIELDS; ++i) {
+            sum[i] += __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+        }
+    }
+    pthread_mutex_unlock(&statLock);
+}
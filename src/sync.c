@@ -0,0 +1,224 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "tree.h"
+#include "sync.h"
+
+// Trees pinned by thread (pins nest- only the outermost pin takes a slot)
+typedef struct _PIN {
+    SYNC            *sync;
+    READERSLOT      *slot;
+    unsigned long   depth;
+} PIN;
+
+static _Thread_local PIN pins[PINLIMIT];
+
+// Threads seen so far (spreads threads over reader slots)
+static unsigned long threads;
+static _Thread_local unsigned long threadId;
+
+// Create concurrency state
+SYNC *SyncCreate() {
+    SYNC *sync = NULL;
+    pthread_mutexattr_t attributes;
+
+    if (posix_memalign((void **) &sync, CACHELINE, sizeof(SYNC)) != 0) {
+        fprintf(stderr, "\nSync error: allocating memory failed!\n");
+        return NULL;
+    }
+    memset(sync, 0, sizeof(SYNC));
+    sync->epoch = 1;
+
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    if (pthread_mutex_init(&sync->writer, &attributes) != 0) {
+        fprintf(stderr, "\nSync error: creating mutex failed!\n");
+        pthread_mutexattr_destroy(&attributes);
+        free(sync);
+        return NULL;
+    }
+    pthread_mutexattr_destroy(&attributes);
+    return sync;
+}
+
+// Destroy concurrency state (no readers or writers may be left- all retired memory is released)
+void SyncDestroy(SYNC *sync, void *context) {
+    unsigned long i;
+
+    if (!sync) {
+        return;
+    }
+    for (i = 0; i < sync->numRetired; ++i) {
+        sync->retired[i].release(context, sync->retired[i].memory, sync->retired[i].size);
+    }
+    free(sync->retired);
+    pthread_mutex_destroy(&sync->writer);
+    free(sync);
+}
+
+// Pin global epoch for reading (memory seen while pinned isn't freed until unpinned)
+int SyncPin(SYNC *sync) {
+    PIN *pin = NULL;
+    unsigned long i, epoch;
+
+    // Nested pin
+    for (i = 0; i < PINLIMIT; ++i) {
+        if (pins[i].sync == sync) {
+            pins[i].depth++;
+            return OK;
+        }
+        if (!pin && !pins[i].sync) {
+            pin = &pins[i];
+        }
+    }
+    if (!pin) {
+        fprintf(stderr, "\nSync error: thread has too many trees pinned.\n");
+        return ERROR;
+    }
+
+    if (!threadId) {
+        threadId = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+    }
+
+    // Claim free slot (starting from slot of thread)
+    for (i = threadId; ; ++i) {
+        READERSLOT *slot = &sync->readers[i % READERSLOTS];
+        unsigned long unclaimed = 0;
+
+        if (!__atomic_load_n(&slot->claimed, __ATOMIC_RELAXED)
+            && __atomic_compare_exchange_n(&slot->claimed, &unclaimed, 1, FALSE, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            pin->slot = slot;
+            break;
+        }
+        if (i % READERSLOTS == (threadId + READERSLOTS - 1) % READERSLOTS) {
+            sched_yield();      // Every slot is taken- wait for a reader to finish
+        }
+    }
+
+    // Publish epoch (again if it moved meanwhile- a reclaim may have missed the slot)
+    do {
+        epoch = __atomic_load_n(&sync->epoch, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&pin->slot->epoch, epoch, __ATOMIC_SEQ_CST);
+    } while (epoch != __atomic_load_n(&sync->epoch, __ATOMIC_SEQ_CST));
+
+    pin->sync = sync;
+    pin->depth = 1;
+    return OK;
+}
+
+// Unpin epoch (outermost unpin releases slot)
+void SyncUnpin(SYNC *sync) {
+    unsigned long i;
+
+    for (i = 0; i < PINLIMIT; ++i) {
+        if (pins[i].sync == sync) {
+            if (--pins[i].depth == 0) {
+                __atomic_store_n(&pins[i].slot->epoch, 0, __ATOMIC_SEQ_CST);
+                __atomic_store_n(&pins[i].slot->claimed, 0, __ATOMIC_RELEASE);
+                pins[i].sync = NULL;
+                pins[i].slot = NULL;
+            }
+            return;
+        }
+    }
+}
+
+// Start reading (waits while a write section is open, returns sequence to validate against)
+unsigned long SyncReadBegin(const SYNC *sync) {
+    unsigned long sequence;
+
+    while ((sequence = __atomic_load_n(&sync->sequence, __ATOMIC_ACQUIRE)) & 1) {
+        sched_yield();
+    }
+    return sequence;
+}
+
+// Check if anything read since SyncReadBegin can be trusted (no writer got in between)
+int SyncReadValid(const SYNC *sync, const unsigned long sequence) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (__atomic_load_n(&sync->sequence, __ATOMIC_RELAXED) == sequence) ? (TRUE) : (FALSE);
+}
+
+// Lock out writers (readers go on)
+void SyncLock(SYNC *sync) {
+    pthread_mutex_lock(&sync->writer);
+}
+
+// Let writers in again
+void SyncUnlock(SYNC *sync) {
+    pthread_mutex_unlock(&sync->writer);
+}
+
+// Open write section (nested sections are part of the outermost one)
+void SyncWriteBegin(SYNC *sync) {
+    pthread_mutex_lock(&sync->writer);
+    if (sync->depth++ == 0) {
+        __atomic_store_n(&sync->sequence, sync->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+}
+
+// Close write section (outermost section reclaims retired memory)
+void SyncWriteEnd(SYNC *sync, void *context) {
+    if (--sync->depth == 0) {
+        __atomic_store_n(&sync->sequence, sync->sequence + 1, __ATOMIC_RELEASE);
+        SyncReclaim(sync, context);
+    }
+    pthread_mutex_unlock(&sync->writer);
+}
+
+// Retire unlinked memory (writers only- freed once no reader can see it)
+int SyncRetire(SYNC *sync, void *memory, const size_t size, RELEASE release) {
+    if (!memory) {
+        return OK;
+    }
+
+    if (sync->numRetired == sync->capRetired) {
+        unsigned long capacity = (sync->capRetired) ? (sync->capRetired * 2) : (MEMLIMIT * 8);
+        RETIRED *temp = realloc (sync->retired, sizeof(RETIRED) * capacity);
+        if (!temp) {
+            // Not safe to free- memory is leaked rather than pulled from under readers
+            fprintf(stderr, "\nSync error: allocating memory for retired memory failed!\n");
+            return ERROR;
+        }
+        sync->retired = temp;
+        sync->capRetired = capacity;
+    }
+
+    RETIRED *retired = &sync->retired[sync->numRetired++];
+    retired->memory = memory;
+    retired->size = size;
+    retired->epoch = __atomic_load_n(&sync->epoch, __ATOMIC_RELAXED);
+    retired->release = release;
+    return OK;
+}
+
+// Advance epoch and free memory retired before oldest pinned epoch (writers only)
+void SyncReclaim(SYNC *sync, void *context) {
+    unsigned long oldest, epoch, i, kept = 0;
+
+    if (!sync->numRetired) {
+        return;
+    }
+
+    oldest = __atomic_add_fetch(&sync->epoch, 1, __ATOMIC_SEQ_CST);
+    for (i = 0; i < READERSLOTS; ++i) {
+        epoch = __atomic_load_n(&sync->readers[i].epoch, __ATOMIC_SEQ_CST);
+        if (epoch && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    // Retired in epoch order- stop at first memory that may still be seen
+    for (i = 0; i < sync->numRetired && sync->retired[i].epoch < oldest; ++i) {
+        sync->retired[i].release(context, sync->retired[i].memory, sync->retired[i].size);
+    }
+    kept = sync->numRetired - i;
+    memmove(sync->retired, &sync->retired[i], sizeof(RETIRED) * kept);
+    sync->numRetired = kept;
+}
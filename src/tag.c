@@ -0,0 +1,40 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "tag.h"
+
+// Find first tag from given position matching tag (count if none)
+unsigned int TagMatch(const unsigned char *tags, const unsigned int count, const unsigned char tag, unsigned int from) {
+#if defined(__AVX2__)
+    const __m256i wide = _mm256_set1_epi8((char) tag);
+    for (; from + 32 <= count; from += 32) {
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) &tags[from]), wide));
+        if (mask) {
+            return from + (unsigned int) __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i narrow = _mm_set1_epi8((char) tag);
+    for (; from + 16 <= count; from += 16) {
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) &tags[from]), narrow));
+        if (mask) {
+            return from + (unsigned int) __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    // Tags left (or every tag, without SSE2)
+    for (; from < count; ++from) {
+        if (tags[from] == tag) {
+            return from;
+        }
+    }
+    return count;
+}
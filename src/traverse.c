@@ -0,0 +1,342 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "traverse.h"
+
+// Start segment of output following segment (NULL if allocating memory failed)
+static TRAVERSESEGMENT *TraverseSegment(TRAVERSAL *traversal, TRAVERSESEGMENT *after) {
+    TRAVERSESEGMENT *segment = calloc (1, sizeof(TRAVERSESEGMENT));
+    if (!segment) {
+        return NULL;
+    }
+
+    segment->stream = open_memstream(&segment->buffer, &segment->length);
+    if (!segment->stream) {
+        free(segment);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&traversal->lock);
+    segment->next = after->next;
+    after->next = segment;
+    pthread_mutex_unlock(&traversal->lock);
+    return segment;
+}
+
+// Complete segment (segments done are written out from the first on)
+static void TraverseSegmentDone(TRAVERSAL *traversal, TRAVERSESEGMENT *segment) {
+    pthread_mutex_lock(&traversal->lock);
+
+    // Buffer and length are set on close
+    if (segment->stream != traversal->output) {
+        fclose(segment->stream);
+    }
+    segment->done = TRUE;
+
+    while (traversal->segments && traversal->segments->done) {
+        TRAVERSESEGMENT *written = traversal->segments;
+        if (written->buffer) {
+            fwrite(written->buffer, 1, written->length, traversal->output);
+            free(written->buffer);
+        }
+        traversal->segments = written->next;
+        free(written);
+    }
+    pthread_mutex_unlock(&traversal->lock);
+}
+
+// Answer worker asking to share with nothing (worker has nothing to share)
+static void TraverseRefuse(TRAVERSEWORKER *worker) {
+    int request = __atomic_load_n(&worker->request, __ATOMIC_ACQUIRE);
+
+    if (request >= 0) {
+        TRAVERSEWORKER *thief = &worker->traversal->workers[request];
+        thief->share = NULL;
+        __atomic_store_n(&worker->request, -1, __ATOMIC_RELAXED);
+        __atomic_store_n(&thief->answered, TRUE, __ATOMIC_RELEASE);
+    }
+}
+
+// Answer worker asking to share (hands over first half of children left in lowest frame- visited last by this worker)
+static void TraverseShare(TRAVERSEWORKER *worker, TRAVERSEFRAME *stack, const unsigned long size) {
+    TRAVERSAL *traversal = worker->traversal;
+    TRAVERSEWORKER *thief = &traversal->workers[__atomic_load_n(&worker->request, __ATOMIC_ACQUIRE)];
+    TRAVERSESHARE *share = NULL;
+    unsigned long i = 0;
+
+    // Frames below lowest frame with children left are done- so nothing this worker visits follows share
+    while (i < size && stack[i].low == stack[i].next) {
+        i++;
+    }
+
+    if (i < size && !__atomic_load_n(&traversal->stop, __ATOMIC_RELAXED)) {
+        TRAVERSEFRAME *frame = &stack[i];
+        unsigned int count = (frame->next - frame->low + 1) / 2;
+        NODE **children = malloc (sizeof(NODE *) * count);
+
+        share = malloc (sizeof(TRAVERSESHARE));
+        if (share && children) {
+            share->segment = (traversal->output) ? (TraverseSegment(traversal, worker->segment)) : (NULL);
+        }
+        if (!share || !children || (traversal->output && !share->segment)) {
+            // Not sharing is fine- this worker visits them
+            free(children);
+            free(share);
+            share = NULL;
+        }
+        else {
+            memcpy(children, frame->children + frame->low, sizeof(NODE *) * count);
+            share->frame = (TRAVERSEFRAME) { NULL, children, 0, count, frame->depth };
+            frame->low += count;
+
+            // Share counts as work held until thief is done with it
+            __atomic_add_fetch(&traversal->active, 1, __ATOMIC_ACQ_REL);
+        }
+    }
+
+    thief->share = share;
+    __atomic_store_n(&worker->request, -1, __ATOMIC_RELAXED);
+    __atomic_store_n(&thief->answered, TRUE, __ATOMIC_RELEASE);
+}
+
+// Worker thread (defined below)
+static void *TraverseWorker(void *argument);
+
+// Start further workers (traversal has turned out large)
+static void TraverseStart(TRAVERSAL *traversal) {
+    unsigned int i;
+
+    for (i = traversal->started; i < traversal->numWorkers; ++i) {
+        if (pthread_create(&traversal->workers[i].thread, NULL, TraverseWorker, &traversal->workers[i]) != 0) {
+            break;
+        }
+        traversal->started = i + 1;
+    }
+}
+
+// Walk share depth first (workers asking to share are answered at every node)
+static void TraverseWalk(TRAVERSEWORKER *worker, const TRAVERSEFRAME first) {
+    TRAVERSAL *traversal = worker->traversal;
+    void *context = (traversal->output) ? (worker->segment->stream) : (traversal->context);
+    enum visitResult visit = visitContinue;
+    unsigned long size = 0,
+                  capStack = MEMLIMIT;
+
+    TRAVERSEFRAME *stack = malloc (sizeof(TRAVERSEFRAME) * capStack);
+    if (!stack) {
+        fprintf(stderr, "\nTraverse error: allocating memory failed!\n");
+        __atomic_store_n(&traversal->failed, TRUE, __ATOMIC_RELAXED);
+        __atomic_store_n(&traversal->stop, TRUE, __ATOMIC_RELAXED);
+        if (!first.node) {
+            free(first.children);
+        }
+        return;
+    }
+    stack[size++] = first;
+
+    while (size && !__atomic_load_n(&traversal->stop, __ATOMIC_RELAXED)) {
+        if (__atomic_load_n(&worker->request, __ATOMIC_RELAXED) >= 0) {
+            TraverseShare(worker, stack, size);
+        }
+
+        // Calling thread walks alone until traversal turns out large
+        if (worker->number == 0 && traversal->started == 1 && traversal->numWorkers > 1
+            && ++traversal->visited == TRAVERSELIMIT) {
+            TraverseStart(traversal);
+        }
+
+        TRAVERSEFRAME *frame = &stack[size - 1];
+
+        // Done with children- back to parent (copies of shares handed over are freed)
+        if (frame->next == frame->low) {
+            size--;
+            if (frame->node && traversal->order == postOrder) {
+                visit = traversal->visitor(frame->node, frame->depth - 1, context);
+            }
+            if (!frame->node) {
+                free(frame->children);
+            }
+        }
+        else {
+            NODE *child = frame->children[--frame->next];
+            unsigned long depth = frame->depth;
+
+            if (traversal->order == preOrder) {
+                visit = traversal->visitor(child, depth, context);
+                if (visit != visitContinue || child->numChildren == 0) {
+                    child = NULL;
+                }
+            }
+            else if (child->numChildren == 0) {
+                visit = traversal->visitor(child, depth, context);
+                child = NULL;
+            }
+
+            // Descend
+            if (child) {
+                if (size == capStack) {
+                    TRAVERSEFRAME *temp = realloc (stack, sizeof(TRAVERSEFRAME) * (capStack + MEMLIMIT));
+                    if (!temp) {
+                        fprintf(stderr, "\nTraverse error: allocating memory failed!\n");
+                        __atomic_store_n(&traversal->failed, TRUE, __ATOMIC_RELAXED);
+                        __atomic_store_n(&traversal->stop, TRUE, __ATOMIC_RELAXED);
+                        break;
+                    }
+                    stack = temp;
+                    capStack += MEMLIMIT;
+                }
+                stack[size++] = (TRAVERSEFRAME) { child, child->children, 0, child->numChildren, depth + 1 };
+            }
+        }
+
+        if (visit == visitStop) {
+            __atomic_store_n(&traversal->stop, TRUE, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Stopped- free copies left on stack
+    while (size--) {
+        if (!stack[size].node) {
+            free(stack[size].children);
+        }
+    }
+    free(stack);
+}
+
+// Ask a busy worker to share (NULL if none did- workers asking this one meanwhile are refused)
+static TRAVERSESHARE *TraverseSteal(TRAVERSEWORKER *worker) {
+    TRAVERSAL *traversal = worker->traversal;
+    unsigned int i,
+                 first;
+
+    TraverseRefuse(worker);
+    worker->seed = worker->seed * 6364136223846793005UL + 1442695040888963407UL;
+    first = (unsigned int) (worker->seed >> 33) % traversal->numWorkers;
+
+    for (i = 0; i < traversal->numWorkers; ++i) {
+        TRAVERSEWORKER *victim = &traversal->workers[(first + i) % traversal->numWorkers];
+        int none = -1;
+
+        if (victim == worker || !__atomic_load_n(&victim->busy, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        __atomic_store_n(&worker->answered, FALSE, __ATOMIC_RELAXED);
+        if (!__atomic_compare_exchange_n(&victim->request, &none, (int) worker->number, FALSE,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        // Wait for answer (nobody holds work once active is 0- and no share is on its way then)
+        while (!__atomic_load_n(&worker->answered, __ATOMIC_ACQUIRE)) {
+            TraverseRefuse(worker);
+            if (__atomic_load_n(&traversal->active, __ATOMIC_ACQUIRE) == 0) {
+                return NULL;
+            }
+            sched_yield();
+        }
+        if (worker->share) {
+            return worker->share;
+        }
+    }
+
+    sched_yield();
+    return NULL;
+}
+
+// Visit share, then complete its segment and give up its work
+static void TraverseRun(TRAVERSEWORKER *worker, const TRAVERSEFRAME first) {
+    TRAVERSAL *traversal = worker->traversal;
+
+    __atomic_store_n(&worker->busy, TRUE, __ATOMIC_RELAXED);
+    TraverseWalk(worker, first);
+    __atomic_store_n(&worker->busy, FALSE, __ATOMIC_RELAXED);
+
+    if (worker->segment) {
+        TraverseSegmentDone(traversal, worker->segment);
+        worker->segment = NULL;
+    }
+    __atomic_sub_fetch(&traversal->active, 1, __ATOMIC_ACQ_REL);
+}
+
+// Ask for shares until traversal is done (thread of worker- calling thread joins in once done with its own share)
+static void *TraverseWorker(void *argument) {
+    TRAVERSEWORKER *worker = argument;
+    TRAVERSAL *traversal = worker->traversal;
+
+    while (__atomic_load_n(&traversal->active, __ATOMIC_ACQUIRE) > 0) {
+        TRAVERSESHARE *share = TraverseSteal(worker);
+        if (share) {
+            worker->segment = share->segment;
+            TraverseRun(worker, share->frame);
+            free(share);
+        }
+    }
+    return NULL;
+}
+
+// Visit nodes depth first from root on all cores (see traverse.h- if output is given, visitor is handed a stream
+// to print into as context, preOrder only)
+int TraverseParallel(NODE *root, VISITOR visitor, void *context, const enum traverseOrder order, FILE *output) {
+    TRAVERSAL *traversal = calloc (1, sizeof(TRAVERSAL));
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int i;
+
+    if (!traversal || (output && !(traversal->segments = calloc (1, sizeof(TRAVERSESEGMENT))))) {
+        fprintf(stderr, "\nTraverse error: allocating memory failed!\n");
+        free(traversal);
+        return ERROR;
+    }
+
+    traversal->visitor = visitor;
+    traversal->context = context;
+    traversal->order = order;
+    traversal->output = output;
+    traversal->numWorkers = (cores > TRAVERSEWORKERS) ? (TRAVERSEWORKERS) : ((cores > 1) ? ((unsigned int) cores) : (1));
+    traversal->started = 1;
+    traversal->active = 1;
+    pthread_mutex_init(&traversal->lock, NULL);
+    for (i = 0; i < traversal->numWorkers; ++i) {
+        traversal->workers[i].traversal = traversal;
+        traversal->workers[i].number = i;
+        traversal->workers[i].request = -1;
+        traversal->workers[i].seed = i + 1;
+    }
+
+    // First segment is printed straight to output
+    TRAVERSEWORKER *worker = &traversal->workers[0];
+    if (output) {
+        traversal->segments->stream = output;
+        worker->segment = traversal->segments;
+    }
+
+    // Root is visited by calling thread (postOrder: once frame of root is done)
+    enum visitResult visit = (order == preOrder) ? (visitor(root, 0, (output) ? (output) : (context))) : (visitContinue);
+    if (visit == visitContinue) {
+        TraverseRun(worker, (TRAVERSEFRAME) { root, root->children, 0, root->numChildren, 1 });
+    }
+    else {
+        if (output) {
+            TraverseSegmentDone(traversal, worker->segment);
+            worker->segment = NULL;
+        }
+        traversal->active = 0;
+    }
+
+    // Help out until every share is visited
+    TraverseWorker(worker);
+    for (i = 1; i < traversal->started; ++i) {
+        pthread_join(traversal->workers[i].thread, NULL);
+    }
+
+    int iRc = (traversal->failed) ? (ERROR) : (OK);
+    pthread_mutex_destroy(&traversal->lock);
+    free(traversal);
+    return iRc;
+}
@@ -6,7 +6,24 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
 #include "tree.h"
+#include "index.h"
+#include "arena.h"
+#include "image.h"
+#include "sync.h"
+#include "wal.h"
+#include "version.h"
+#include "traverse.h"
+#include "intern.h"
+#include "stats.h"
+#include "handle.h"
+#include "art.h"
+#include "tag.h"
 
 /*
  * Notice:
@@ -15,32 +32,13 @@
  *
  *      The function Search is also heavily used, this is due to requirements to parameters in signatures-
  *      ordinarily I would recommend supplying node as argument, rather than keys (would also lessen root params).
+ *      Hot callers may resolve keys to handles once (ResolveHandle), and get and set through them (GetIntH, ...).
  */
 
-// Swap node pointers
-static void Swap(NODE **x, NODE **y) {
-    // XOR swapping would require more computation- memory usage VS processing
-    NODE *tmp = *x;
-    *x = *y;
-    *y = tmp;
-}
-
-// Bubble sort node keys
-static void BubbleSort(NODE **parent, const int numChildren) {
-    for (int i = 1; i < numChildren; ++i) {
-        // Compare string arguments- if string 2 less than string 1
-        if (strcmp((*parent)->children[i - 1]->key, (*parent)->children[i]->key) > 0) {
-            // Then swap string pointers
-            Swap(&(*parent)->children[i - 1], &(*parent)->children[i]);
-            // Rerun- increments to 1 when loop finishes and avoids error
-            i = 0;
-        }
-    }
-}
-
 // Handle reallocation (if increase in heap)
 static NODE **ReallocHandling(NODE **oldBuff, const size_t size) {
     NODE **newBuff = realloc (oldBuff, size);
+    StatMemory(0, 0, TRUE);
     if (!newBuff) {
         fprintf(stderr, "\nERROR: Reallocating memory failed!\n");
         free(oldBuff);  // Avoid leakage
@@ -48,1056 +46,4874 @@ static NODE **ReallocHandling(NODE **oldBuff, const size_t size) {
     return newBuff;     // If null, operations should be terminated
 }
 
-// Split full key path into end key (excl. "*")
-int SplitEndKey(char *key, const char *fullKey) {
-    char *token;
+// Get tree state of node (walks parents up to root)
+static TREE *TreeOf(NODE *node) {
+    while (node && !(node->flags & NODEROOT)) {
+        node = node->up.parent;
+    }
+    return (node) ? (node->up.tree) : (NULL);
+}
 
-    memcpy(key, fullKey, sizeof(char) * strlen(fullKey));
+// Get value of node as data handed out by API (integers are loaded whole- counters may change them meanwhile)
+static DATA *NodeData(const NODE *node, DATA *data) {
+    data->integer = (node->type == integerValue) ? (__atomic_load_n(&node->value.integer, __ATOMIC_RELAXED)) : (0);
+    data->string = (node->type == stringValue) ? (node->value.string) : (NULL);
+    return data;
+}
 
-    token = strtok(key, ".*");       // Initialize tokens
+// Get image of image backed tree (NULL if tree holds nodes)
+static IMAGE *ImageOf(NODE **root) {
+    TREE *tree = (*root) ? (TreeOf(*root)) : (NULL);
+    return (tree) ? (tree->image) : (NULL);
+}
 
-    while (token) {     // Until end of tokens
-        strcpy(key, token);    // Grab end key
-        token = strtok(NULL, ".*");
+// Enumerate image nodes with values below target (same order as Enumerate, no stack- walks parent indices)
+static int ImageEnumerate(const IMAGE *image, char *targetKey) {
+    long target = ImageFind(image, 0, targetKey),
+         current;
+
+    if (target < 0) {
+        return ERROR;
+    }
+
+    if (image->nodes[target].numChildren == 0) {
+        printf("\nNo value holding nodes found under '%s'.", targetKey);
+        return OK;
+    }
+
+    printf("\nValue holding node(s) enumerated from '%s': ", targetKey);
+    DATA data;
+    current = image->nodes[target].firstChild + image->nodes[target].numChildren - 1;
+    while (current != target) {
+        const IMAGENODE *node = &image->nodes[current];
+
+        // If holding value, callback
+        if (node->numChildren == 0) {
+            data.integer = node->integer;
+            data.string = (node->string != IMAGENONE) ? ((char *) image->pool + node->string) : (NULL);
+            EnumKeyValue(image->pool + node->key, &data);
+
+            // Previous sibling, or first ancestor (below target) having one
+            while (current != target) {
+                if (current > (long) image->nodes[image->nodes[current].parent].firstChild) {
+                    current--;
+                    break;
+                }
+                current = image->nodes[current].parent;
+            }
+        }
+        else {
+            // Last child first (children are pushed to a stack in Enumerate)
+            current = node->firstChild + node->numChildren - 1;
+        }
     }
+    printf("\n");
     return OK;
 }
 
-// Split full key path into parent of end key
-int SplitParentKey(char *key, const char *fullKey) {
-    char *token;
-
-    memcpy(key, fullKey, sizeof(char) * strlen(fullKey));
-    token = strtok(key, ".*");       // Initialize tokens
+// Return translation of image node (same rules as GetText)
+static char *ImageGetText(const IMAGE *image, char *targetKey, char *language) {
+    char buffer[256],
+         *path = buffer;
+    size_t length = strlen(language) + strlen(targetKey) + 1;
+    long node = -1,
+         parent = ImageFind(image, 0, language);
+
+    if (parent >= 0) {
+        // Appended language keys (unique keys only)
+        if (length > sizeof(buffer) && !(path = malloc (length))) {
+            return NULL;
+        }
+        strcpy(path, language);
+        strcat(path, targetKey);
+        node = ImageFind(image, parent, path);
+        if (path != buffer) {
+            free(path);
+        }
 
-    while (token) {         // Until end of tokens
-        strtok(NULL, ".*");
-        token = strtok(NULL, ".*");
-        if (token) strcpy(key, token); // Grab parent key
+        // If target language doesn't have the target, search the EN node
+        if (ImageNodeType(image, node) != stringNode) {
+            parent = ImageFind(image, 0, "en");
+            node = (parent >= 0) ? (ImageFind(image, parent, targetKey)) : (-1);
+        }
     }
-    return OK;
+    return (ImageNodeType(image, node) == stringNode) ? ((char *) image->pool + image->nodes[node].string) : (NULL);
 }
 
-// Create node (no rules- usage is AddNode())
-static NODE *CreateNode(const char *key) {
-    // Allocate memory for node
-    NODE *newNode = calloc (1, sizeof(NODE));
+// Allocate zeroed memory for tree (from arena if tree has one)
+static void *TreeAlloc(TREE *tree, const size_t size) {
+    StatMemory(size, 0, FALSE);
+    return (tree && tree->arena) ? (ArenaAlloc(tree->arena, size)) : (calloc(1, size));
+}
 
-    if (newNode) {
-        // Allocate memory for key
-        newNode->key = calloc (strlen(key) + 1, sizeof(char));
-        strcpy (newNode->key, key);
+// Release memory of tree at once (usage is TreeFree() and reclaiming retired memory)
+static void TreeRelease(void *context, void *memory, const size_t size) {
+    TREE *tree = context;
 
-        // Initialize children of node to zero
-        newNode->numChildren = 0;
-        newNode->children = NULL;
+    if (memory) {
+        StatMemory(0, size, FALSE);
+    }
+    if (tree && tree->arena) {
+        ArenaFree(tree->arena, memory, size);
     }
     else {
-        fprintf(stderr, "\nERROR: Allocating memory failed!\n");
+        free(memory);
     }
-    // Return node
-    return newNode;
 }
 
-// Find node(s) by depth first traversal (root is required for forest)
-int DephtFirst(NODE **root, SEARCHRESULT **result, char *targetKey, const enum searchMode search) {
-    /*
-     *  Depth First Traversal:
-     *      As recursion may put huge overhead on large trees (ie, exponentially increasing calls on stack)
-     *      an iterative preorder traversal for scalability is implemented.
-     *
-     *      The overhead incurred cannot be reasonably justified, especially for database queries.
-     *          - However, it might be reasonable to use inorder or postorder recursion to delete nodes.
-     *
-     *      How recursion would work:
-     *          A recursive function would send the stack back to itself, minus the current processed node.
-     *          Breaking out of it would be caused by finding target- or if stack and current equals empty.
-     */
+// Free memory of tree (size must match allocated size, concurrent trees hold on to it until readers are done)
+static void TreeFree(TREE *tree, void *memory, const size_t size) {
+    if (tree && tree->sync) {
+        SyncRetire(tree->sync, memory, size, TreeRelease);
+    }
+    else {
+        TreeRelease(tree, memory, size);
+    }
+}
 
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nSearch node error: root is null.\n");
-        return ERROR;
+// Reallocate memory of tree (if null, old memory is kept- concurrent trees never reuse memory in place)
+static void *TreeRealloc(TREE *tree, void *memory, const size_t oldSize, const size_t newSize) {
+    if (memory) {
+        StatMemory(0, 0, TRUE);
+    }
+    if (tree && tree->sync) {
+        void *moved = TreeAlloc(tree, newSize);
+        if (moved && memory) {
+            memcpy(moved, memory, (oldSize < newSize) ? (oldSize) : (newSize));
+            TreeFree(tree, memory, oldSize);
+        }
+        return moved;
     }
 
-    // Initialize LIFO-stack to root
-    int     stackSize = 1,
-            memLeftStack = MEMLIMIT,
-            memLeftNodes = 0,
-            i;
+    void *moved = (tree && tree->arena) ? (ArenaRealloc(tree->arena, memory, oldSize, newSize)) :
+                                          (realloc(memory, newSize));
+    if (moved) {
+        StatMemory(newSize, (memory) ? (oldSize) : (0), FALSE);
+    }
+    return moved;
+}
 
-    short int iRc = OK;
+// Release interned string (memory handed back by InternRelease)
+static void StringRelease(void *context, void *memory, const size_t size) {
+    free(memory);
+}
 
-    NODE **stack = calloc ((size_t) stackSize + memLeftStack, sizeof(NODE *)),
-            *current;
+// Copy string into tree (length excl. terminator- interned trees hand out the pooled copy, it must not be changed)
+static char *TreeString(TREE *tree, const char *string, const size_t length) {
+    if (tree && tree->intern) {
+        return InternString(tree->intern, string, length);
+    }
 
-    // If calloc failed
-    if (!stack) {
-        iRc = ERROR;
+    char *copy = TreeAlloc(tree, length + 1);
+    if (copy) {
+        memcpy(copy, string, length);
     }
+    return copy;
+}
 
-    if (iRc == OK) {
-        // Start stack with root
-        memcpy(stack, root, sizeof(NODE *) * stackSize);
+// Free string of tree (interned strings go with their last holder, retired like other memory of concurrent trees)
+static void TreeFreeString(TREE *tree, char *string) {
+    if (tree && tree->intern) {
+        void *memory = InternRelease(tree->intern, string);
+        if (memory && tree->sync) {
+            SyncRetire(tree->sync, memory, 0, StringRelease);
+        }
+        else {
+            free(memory);
+        }
+    }
+    else {
+        TreeFree(tree, string, strlen(string) + 1);
+    }
+}
 
-        // If current is null and stack is empty, no node was found
-        while (stackSize) {
-            // Set current to top of stack
-            current = stack[stackSize - 1];
+// Release retired index
+static void IndexRelease(void *context, void *memory, const size_t size) {
+    IndexDestroy(memory);
+}
 
-            // Result must be freed when searches are completed, this also goes for result nodes if more than one target.
-            if (search != targetNode) {
-                // Allocate memory for result nodes
-                memLeftNodes--;
-                if (memLeftNodes < 0) {
-                    memLeftNodes = MEMLIMIT;
-                    (*result)->nodes = ReallocHandling((*result)->nodes,
-                                                       sizeof(NODE *) * ((*result)->numNodes + memLeftNodes + 1));
-                    if (!(*result)->nodes) {
-                        iRc = ERROR;
-                        break;
-                    }
-                }
-                // Add to result
-                (*result)->nodes[(*result)->numNodes] = current;
-                (*result)->numNodes++;
-            }
+// Index node key (replaced index of concurrent tree is retired, readers may still probe it)
+static int TreeIndex(TREE *tree, NODE *node) {
+    INDEX *retired = NULL;
+    int iRc = IndexInsert(&tree->index, node, (tree->sync) ? (&retired) : (NULL));
 
-            // If current is target and search not full tree, return node(s)
-            if (strcmp(current->key, targetKey) == 0 && search != fullTree) {
-                if (search == targetNode) {
-                    (*result)->node = current;
-                    (*result)->numNodes++;
-                }
-                break;
-            }
+    if (retired) {
+        SyncRetire(tree->sync, retired, 0, IndexRelease);
+    }
+    return iRc;
+}
 
-            // Push currents children to stack
-            if (current->numChildren != 0) {
-                // Do we need to allocate more memory?
-                memLeftStack -= current->numChildren;
-                if (memLeftStack < 0) {
-                    // Re-allocate memory to match stack + number of children + memlimit
-                    memLeftStack = MEMLIMIT;
-                    stack = ReallocHandling(stack,
-                                            (sizeof(NODE *) * (stackSize + memLeftStack) * current->numChildren));
-                    if (!stack) {
-                        iRc = ERROR;
-                        break;
-                    }
-                }
+// Make room in index for count more keys (replaced index of concurrent tree is retired)
+static int TreeReserve(TREE *tree, const unsigned long count) {
+    INDEX *retired = NULL;
+    int iRc = IndexReserve(&tree->index, count, (tree->sync) ? (&retired) : (NULL));
 
-                for (i = 0; i < current->numChildren; ++i) {
-                    // Increment stack size and add children to stack
-                    stack[stackSize - 1] = current->children[i];
-                    stackSize++;
-                }
-            }
-            stackSize--;        // Decrement stack
-            memLeftStack++;     // Make space available
-        }
+    if (retired) {
+        SyncRetire(tree->sync, retired, 0, IndexRelease);
     }
-    else {
-        fprintf(stderr, "\nSearch node error: Allocating memory failed!\n");
+    return iRc;
+}
+
+// Get path of node in radix tree (dotted, excl. root key- room for a separator after it, NULL if out of memory)
+static char *ArtPath(const NODE *node, size_t *length) {
+    const NODE *up;
+    char *path,
+         *cursor;
+
+    *length = 0;
+    for (up = node; NodeParent(up); up = NodeParent(up)) {
+        *length += strlen(NodeKey(up)) + ((NodeParent(NodeParent(up))) ? (1) : (0));
     }
-    // Free
-    if (stack) {
-        free (stack);
+    if (!(path = malloc (*length + 2))) {
+        return NULL;
     }
 
-    return iRc;
+    // Keys from node upwards, written back to front
+    cursor = path + *length;
+    *cursor = '\0';
+    for (up = node; NodeParent(up); up = NodeParent(up)) {
+        size_t keyLength = strlen(NodeKey(up));
+        cursor -= keyLength;
+        memcpy(cursor, NodeKey(up), keyLength);
+        if (NodeParent(NodeParent(up))) {
+            *--cursor = '.';
+        }
+    }
+    return path;
 }
 
-// Search (handle search types)
-int Search(NODE **root, SEARCHRESULT **result, char *targetKey, const enum searchMode search) {
-    /*
-     *  Allow parents to hold same key name:
-     *      Requires iterative walk through each node in path (out of the scope for this assignment).
-     *
-     *  Allow leafs to hold duplicate key names:
-     *      Requires node paths (parent.key): finds parent and searches children.
-     *
-     *  Unique leafs:
-     *      Only requires child (key): finds child, but does not allow for duplicate key names in leafs.
-     */
+// Drop radix tree of tree (paths are walked from then on- it can't be trusted once an update failed)
+static void ArtDrop(TREE *tree) {
+    fprintf(stderr, "\nERROR: Updating paths failed (paths are resolved by walking keys from now on)!\n");
+    ArtDestroy(tree->art);
+    tree->art = NULL;
+}
 
-    // Receive path or key, return target according to specification and search type
+// Add path of node to radix tree of tree (if any)
+static int TreePath(TREE *tree, NODE *node) {
+    if (!tree || !tree->art) {
+        return OK;
+    }
 
-    char *key = NULL;
+    size_t length;
+    char *path = ArtPath(node, &length);
+    if (!path || ArtInsert(tree->art, path, length, node) != OK) {
+        ArtDrop(tree);
+    }
+    free(path);
+    return (tree->art) ? (OK) : (ERROR);
+}
 
-    // Find parent node, search children and return target (duplicate leaf names)
-    // I've mistakenly implemented a key value database that only allows unique keys.
-    // This is incomplete as I didn't have time to fix the code for non-unique leaf nodes (therefore appending lang)
-    if (UNIQUEKEYS == FALSE && search != fullTree) {
-        // Split key path into target end key if it contains '.'
-        if (strstr(targetKey, ".") != NULL) {
-            key = calloc (strlen(targetKey), sizeof(char));
-            SplitParentKey(key, targetKey);
+// Remove paths of node and of every node below it from radix tree of tree (if any- node must still be attached)
+static void TreeUnpath(TREE *tree, const NODE *node) {
+    if (!tree || !tree->art) {
+        return;
+    }
 
-            // if calloc failed
-            if (!key) {
-                return ERROR;
-            }
-        }
-        else {
-            fprintf(stderr, "Search requires path.key!");
-            return ERROR;
-        }
+    size_t length;
+    char *path = ArtPath(node, &length);
+    if (!path) {
+        ArtDrop(tree);
+        return;
     }
+    ArtRemove(tree->art, path, length);
+    path[length] = '.';
+    ArtRemovePrefix(tree->art, path, length + 1);
+    free(path);
+}
 
-    // Find child node, return target (unique leafs)
-    else if (UNIQUEKEYS == TRUE) {
-        // Split key path into target end key if it contains '.'
-        if (search != fullTree && strstr(targetKey, ".") != NULL) {
-            key = calloc (strlen(targetKey), sizeof(char));
-            SplitEndKey(key, targetKey);
+// Get tree state of concurrent tree (NULL if tree isn't concurrent)
+static TREE *ConcurrentOf(NODE **root) {
+    TREE *tree = (*root) ? (TreeOf(*root)) : (NULL);
+    return (tree && tree->sync) ? (tree) : (NULL);
+}
 
-            // if calloc failed
-            if (!key) {
-                return ERROR;
-            }
-        }
+// Bring latest version of tree up to date (caller keeps writers out- NULL if building it failed)
+static VERSION *TreeVersion(TREE *tree) {
+    // Root is marked whenever anything changed since latest version
+    if (!tree->version || (tree->root->flags & NODEDIRTY)) {
+        VERSION *version = VersionBuild(tree->root, tree->version);
+        VersionRelease(tree->version);
+        tree->version = version;
     }
+    return tree->version;
+}
 
-    // Search types
-    DephtFirst(root, result, (key) ? (key) : (targetKey), search);
+// Write snapshot of version as log records, then release it (defined with the serializer, see SNAPSHOT)
+static int LogSnapshot(void *context, const char *fileName);
 
-    if (key) {
-        free (key);
+// Start checkpoint of log (pins version of tree as it is now- checkpointer writes it while writers go on)
+static int LogCheckpoint(TREE *tree) {
+    char *snapshot = WalSnapshotName(tree->wal);
+    if (!snapshot) {
+        fprintf(stderr, "\nCheckpoint log error: allocating memory failed!\n");
+        return ERROR;
     }
-    return OK;
+
+    VERSION *version = TreeVersion(tree);
+    return WalCheckpointBegin(tree->wal, LogSnapshot, (version) ? (VersionHold(version)) : (NULL), snapshot);
 }
 
-// Add node
-int AddNode(NODE **root, char *targetKey, char *key) {
-    short int iRc = ERROR;
-    char error[51];     // Max 50 chars error message
+// Open write section (readers of concurrent tree retry meanwhile, returns tree to hand to WriteEnd- NULL if no state)
+static TREE *WriteBegin(NODE **root) {
+    TREE *tree = (*root) ? (TreeOf(*root)) : (NULL);
+    if (!tree || (!tree->sync && !tree->wal)) {
+        return NULL;
+    }
 
-    // If no root
-    if (!root) {
-        strcpy(error, "root is null");
+    if (tree->sync) {
+        SyncWriteBegin(tree->sync);
     }
+    tree->writing++;
+    return tree;
+}
 
-        // If missing key
-    else if (!key) {
-        strcpy(error, "missing key.");
+// Close write section (NULL is ignored- log grown past limit is checkpointed here, while tree is whole)
+static void WriteEnd(TREE *tree) {
+    if (!tree) {
+        return;
     }
 
-        // If missing target key
-    else if (!targetKey) {
-        strcpy(error, "missing target key.");
+    if (--tree->writing == 0 && tree->wal && WalCompactDue(tree->wal, FALSE)) {
+        LogCheckpoint(tree);
     }
+    if (tree->sync) {
+        SyncWriteEnd(tree->sync, tree);
+    }
+}
 
-    else {
-        // Check if key already exists in tree (unique keys only)
-        SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-        if (!result) {
-            strcpy(error, "allocating memory for search failed!");
+// Lock writers out of concurrent tree (readers go on, returns tree to hand to UnlockTree)
+static TREE *LockTree(NODE **root) {
+    TREE *tree = ConcurrentOf(root);
+    if (tree) {
+        SyncLock(tree->sync);
+    }
+    return tree;
+}
+
+// Let writers in again (NULL is ignored)
+static void UnlockTree(TREE *tree) {
+    if (tree) {
+        SyncUnlock(tree->sync);
+    }
+}
+
+// Mark changed path for next version (up to first node already marked- its ancestors are too, atomic as counters mark
+// outside write sections, see VersionCopy)
+static void MarkChanged(NODE *node) {
+    while (node) {
+        unsigned char flags = __atomic_load_n(&node->flags, __ATOMIC_SEQ_CST);
+        if ((flags & NODEDIRTY) || (__atomic_fetch_or(&node->flags, NODEDIRTY, __ATOMIC_SEQ_CST) & NODEDIRTY)) {
+            break;
         }
-        else {
-            Search(root, &result, key, targetNode);
+        node = (flags & NODEROOT) ? (NULL) : (node->up.parent);
+    }
+}
 
-            if (result->node) {
-                strcpy(error, "key already exists in tree.");
-            } else {
-                // Find target
-                Search(root, &result, targetKey, targetNode);
+// Note mutation of node (marks it for next version, logs it if tree has a write-ahead log- add records give parent and added key)
+static void LogNode(TREE *tree, const enum walOp op, NODE *node, const char *text, const unsigned long integer) {
+    if (tree && tree->version) {
+        MarkChanged(node);
+    }
+    if (tree && tree->wal) {
+        WalAppend(tree->wal, op, node, text, integer);
+    }
+}
 
-                // If target key wasn't found
-                if (!result->node) {
-                    strcpy(error, "target key doesn't exist in tree.");
+// Check if node is below (or equal to) ancestor
+static int IsDescendant(const NODE *node, const NODE *ancestor) {
+    while (node && node != ancestor) {
+        node = NodeParent(node);
+    }
+    return (node) ? (TRUE) : (FALSE);
+}
+
+// Split full key path into end key (excl. "*")
+int SplitEndKey(char *key, const char *fullKey) {
+    char *token;
+
+    memcpy(key, fullKey, sizeof(char) * strlen(fullKey));
+
+    token = strtok(key, ".*");       // Initialize tokens
+
+    while (token) {     // Until end of tokens
+        memmove(key, token, strlen(token) + 1);    // Grab end key (overlapping)
+        token = strtok(NULL, ".*");
+    }
+    return OK;
+}
+
+// Compare node key to key component (not null terminated), ordered as strcmp
+static int CompareKey(const char *key, const char *component, const size_t length) {
+    int cmp = strncmp(key, component, length);
+    if (cmp == 0 && key[length] != '\0') {
+        cmp = 1;    // Node key is longer- orders after component
+    }
+    return cmp;
+}
+
+// Find child by tags, else by binary search over sorted children (position is set to where key is, or would be inserted)
+static NODE *FindChild(const NODE *parent, const char *key, const size_t length, unsigned int *position) {
+    unsigned int low = 0,
+                 high = parent->numChildren,
+                 mid;
+    int cmp;
+
+    // Keys are only compared on matching tags (see tag.h)
+    if (!position && high > TAGMIN && high <= TAGSCAN) {
+        const unsigned char *tags = NodeTags(parent);
+        const unsigned char tag = TagOf((unsigned int) HashKeyLength(key, length));
+
+        for (mid = TagMatch(tags, high, tag, 0); mid < high; mid = TagMatch(tags, high, tag, mid + 1)) {
+            if (CompareKey(NodeKey(parent->children[mid]), key, length) == 0) {
+                return parent->children[mid];
+            }
+        }
+        return NULL;
+    }
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        cmp = CompareKey(NodeKey(parent->children[mid]), key, length);
+
+        if (cmp == 0) {
+            low = mid;
+            break;
+        }
+        else if (cmp < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    if (position) {
+        *position = low;
+    }
+    return (low < parent->numChildren && CompareKey(NodeKey(parent->children[low]), key, length) == 0) ?
+           (parent->children[low]) : (NULL);
+}
+
+// Resolve dotted path one component at a time from root (leading root key and trailing "*" are optional, counts nodes visited)
+static NODE *ResolvePath(NODE *root, const char *path, unsigned long *visited) {
+    NODE *current = root;
+    const char *component = path,
+               *end;
+    size_t length;
+
+    while (current && *component) {
+        end = strchr(component, '.');
+        length = (end) ? ((size_t) (end - component)) : (strlen(component));
+
+        // Wildcard ends path (enumeration of everything below)
+        if (length == 1 && *component == '*') {
+            break;
+        }
+
+        NODE *child = FindChild(current, component, length, NULL);
+        (*visited)++;
+
+        // Path may start with root key
+        if (!child && current == root && component == path && CompareKey(NodeKey(root), component, length) == 0) {
+            child = root;
+        }
+        current = child;
+
+        component += length;
+        if (*component == '.') {
+            component++;
+        }
+    }
+    return current;
+}
+
+// Resolve dotted path from tree root by radix tree of tree (same rules as ResolvePath, counts lookups as nodes visited)
+static NODE *ArtResolve(TREE *tree, const char *path, unsigned long *visited) {
+    const char *component,
+               *end;
+    size_t length = strlen(path),
+           part;
+    short int wildcard = FALSE;
+
+    // Path ends before first wildcard component
+    for (component = path; ; component = end + 1) {
+        end = strchr(component, '.');
+        part = (end) ? ((size_t) (end - component)) : (strlen(component));
+        if (part == 1 && *component == '*') {
+            length = (component == path) ? (0) : ((size_t) (component - path - 1));
+            wildcard = TRUE;
+            break;
+        }
+        if (!end) {
+            break;
+        }
+    }
+
+    // A single trailing separator is ignored
+    if (!wildcard && length > 1 && path[length - 1] == '.') {
+        length--;
+    }
+    if (length == 0) {
+        return tree->root;
+    }
+
+    (*visited)++;
+    NODE *node = ArtLookup(tree->art, path, length);
+
+    // Path may start with root key (unless root has a child of that name)
+    const char *rootKey = NodeKey(tree->root);
+    size_t rootLength = strlen(rootKey);
+    if (!node && length >= rootLength && memcmp(path, rootKey, rootLength) == 0
+        && (length == rootLength || path[rootLength] == '.') && !ArtLookup(tree->art, rootKey, rootLength)) {
+        (*visited)++;
+        node = (length == rootLength) ? (tree->root) :
+               (ArtLookup(tree->art, path + rootLength + 1, length - rootLength - 1));
+    }
+    return node;
+}
+
+/*
+ *  Concurrent readers:
+ *      Writers change children in place, so a reader may see a half moved array.
+ *      Every child pointer is validated against the sequence before it's followed (memory itself stays valid while pinned).
+ */
+
+// Find child for concurrent reader (retry is set if a writer got in between)
+static NODE *ReadChild(const SYNC *sync, const unsigned long sequence, const NODE *parent,
+                       const char *key, const size_t length, short int *retry) {
+    NODE **children = __atomic_load_n(&parent->children, __ATOMIC_RELAXED);
+    unsigned int low = 0,
+                 high = __atomic_load_n(&parent->numChildren, __ATOMIC_RELAXED),
+                 mid;
+    int cmp;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        NODE *child = __atomic_load_n(&children[mid], __ATOMIC_RELAXED);
+        if (!SyncReadValid(sync, sequence)) {
+            *retry = TRUE;
+            return NULL;
+        }
+
+        cmp = CompareKey(NodeKey(child), key, length);
+        if (cmp == 0) {
+            return child;
+        }
+        else if (cmp < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+// Find node for concurrent reader (same rules as Search for single nodes)
+static NODE *ReadFind(TREE *tree, NODE *root, const char *targetKey, const unsigned long sequence, short int *retry) {
+    NODE *node = NULL;
+    unsigned long visited = 1;
+
+    // Walk path
+    if (UNIQUEKEYS == FALSE || strchr(targetKey, '.')) {
+        const char *component = targetKey,
+                   *end;
+        size_t length;
+
+        node = root;
+        while (node && *component && !*retry) {
+            end = strchr(component, '.');
+            length = (end) ? ((size_t) (end - component)) : (strlen(component));
+
+            if (length == 1 && *component == '*') {
+                break;
+            }
+
+            NODE *child = ReadChild(tree->sync, sequence, node, component, length, retry);
+            visited++;
+            if (!child && node == root && component == targetKey && CompareKey(NodeKey(root), component, length) == 0) {
+                child = root;
+            }
+            node = child;
+
+            component += length;
+            if (*component == '.') {
+                component++;
+            }
+        }
+
+        if (node || UNIQUEKEYS == FALSE || *retry) {
+            StatVisited(visited - 1);
+            return node;
+        }
+    }
+
+    // End key (excl. "*")
+    const char *key = targetKey,
+               *dot;
+    size_t length = strlen(key);
+    if (strchr(key, '.')) {
+        while (length && (key[length - 1] == '*' || key[length - 1] == '.')) {
+            length--;
+        }
+        for (dot = key; (dot = memchr(key, '.', length)); ) {
+            length -= (size_t) (dot + 1 - key);
+            key = dot + 1;
+        }
+    }
+
+    node = IndexLookupLength(__atomic_load_n(&tree->index, __ATOMIC_ACQUIRE), key, length);
+    StatVisited(visited);
+    return (node && IsDescendant(node, root)) ? (node) : (NULL);
+}
+
+// Read value of node found by concurrent reader (valid if sequence still is)
+static enum nodeType ReadNode(const NODE *node, DATA *value) {
+    unsigned long raw = __atomic_load_n(&node->value.integer, __ATOMIC_RELAXED);
+    short int string = (__atomic_load_n(&node->type, __ATOMIC_RELAXED) == stringValue);
+
+    value->integer = (string) ? (0) : (raw);
+    value->string = (string) ? ((char *) raw) : (NULL);
+    return (__atomic_load_n(&node->numChildren, __ATOMIC_RELAXED)) ? (parentNode) :
+           (string) ? (stringNode) : (integerNode);
+}
+
+// Read node by key from concurrent tree (lock free- read again if a writer got in between)
+static enum nodeType ReadValue(TREE *tree, NODE *root, const char *targetKey, DATA *value, NODE **found) {
+    enum nodeType type;
+    unsigned long sequence;
+    short int retry;
+    NODE *node;
+
+    if (SyncPin(tree->sync) != OK) {
+        return errorUndefinedNode;
+    }
+
+    do {
+        retry = FALSE;
+        sequence = SyncReadBegin(tree->sync);
+        node = ReadFind(tree, root, targetKey, sequence, &retry);
+
+        type = (node && !retry) ? (ReadNode(node, value)) : (noSuchNode);
+    } while (retry || !SyncReadValid(tree->sync, sequence));
+
+    SyncUnpin(tree->sync);
+    if (found) {
+        *found = node;
+    }
+    return type;
+}
+
+// Read translation from concurrent tree (same rules as GetText)
+static char *ReadText(TREE *tree, NODE *root, char *targetKey, char *language) {
+    char *path = malloc (strlen(language) + strlen(targetKey) + 1),
+         *text;
+    unsigned long sequence;
+    short int retry;
+    NODE *node;
+
+    if (!path || SyncPin(tree->sync) != OK) {
+        free(path);
+        return NULL;
+    }
+    strcpy(path, language);
+    strcat(path, targetKey);
+
+    do {
+        retry = FALSE;
+        sequence = SyncReadBegin(tree->sync);
+        text = NULL;
+
+        if ((node = ReadFind(tree, root, language, sequence, &retry)) && !retry) {
+            node = ReadFind(tree, node, path, sequence, &retry);
+
+            // If target language doesn't have the target, search the EN node
+            if (!retry && (!node || __atomic_load_n(&node->numChildren, __ATOMIC_RELAXED)
+                           || __atomic_load_n(&node->type, __ATOMIC_RELAXED) != stringValue)) {
+                node = ReadFind(tree, root, "en", sequence, &retry);
+                node = (node && !retry) ? (ReadFind(tree, node, targetKey, sequence, &retry)) : (NULL);
+            }
+            text = (node && !retry && __atomic_load_n(&node->type, __ATOMIC_RELAXED) == stringValue) ?
+                   (__atomic_load_n(&node->value.string, __ATOMIC_RELAXED)) : (NULL);
+        }
+    } while (retry || !SyncReadValid(tree->sync, sequence));
+
+    SyncUnpin(tree->sync);
+    free(path);
+    return text;
+}
+
+// Create node (no rules- usage is AddNode(), key is not required to be null terminated)
+static NODE *CreateNode(TREE *tree, const char *key, const size_t length) {
+    // Allocate memory for node
+    NODE *newNode = TreeAlloc(tree, sizeof(NODE));
+
+    if (newNode) {
+        // Allocate memory for key (unless it fits inside node)
+        if (length >= KEYINLINE) {
+            newNode->name.heap = TreeString(tree, key, length);
+            if (!newNode->name.heap) {
+                TreeFree(tree, newNode, sizeof(NODE));
+                fprintf(stderr, "\nERROR: Allocating memory failed!\n");
+                return NULL;
+            }
+            newNode->flags = NODEHEAPKEY;
+        }
+        else {
+            memcpy (newNode->name.local, key, length);
+        }
+        newNode->flags |= NODEDIRTY;
+        newNode->hash = (unsigned int) ((tree && tree->intern && length >= KEYINLINE) ?
+                                        (InternOf(newNode->name.heap)->hash) : (HashKeyLength(key, length)));
+        newNode->type = integerValue;
+
+        // Initialize children of node to zero
+        newNode->numChildren = 0;
+        newNode->children = NULL;
+    }
+    else {
+        fprintf(stderr, "\nERROR: Allocating memory failed!\n");
+    }
+    // Return node
+    return newNode;
+}
+
+// Free node (no rules- usage is Delete() and DeinitTree(), children must be freed separately)
+static void FreeNode(TREE *tree, NODE *node) {
+    // Unindex key, handles of node go stale
+    if (tree && tree->index) {
+        IndexRemove(tree->index, node);
+    }
+    if (tree && tree->handles) {
+        HandleRelease(tree->handles, node);
+    }
+    if (node->flags & NODEHEAPKEY) {
+        TreeFreeString(tree, node->name.heap);
+    }
+    TreeFree(tree, node->children, ChildrenSize(node->capChildren));
+    if (node->type == stringValue) {
+        TreeFreeString(tree, node->value.string);
+    }
+    TreeFree(tree, node, sizeof(NODE));
+}
+
+// Clear value held by node (parents hold no values- integer is cleared before type, see UpdateNodeInt)
+static void ClearValue(TREE *tree, NODE *node) {
+    if (node->type == stringValue) {
+        TreeFreeString(tree, node->value.string);
+        __atomic_store_n(&node->value.integer, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&node->type, integerValue, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&node->value.integer, 0, __ATOMIC_RELAXED);
+}
+
+// Set string of node (old string is released- interned strings are shared, so they're never changed in place)
+// Integer nodes must hold 0- it's claimed atomically after the type is set, so a counter updated meanwhile either
+// keeps its integer (NULL is returned) or sees the string (see UpdateNodeInt)
+static char *NodeSetString(TREE *tree, NODE *node, const char *string, const size_t length) {
+    char *old = (node->type == stringValue) ? (node->value.string) : (NULL),
+         *temp;
+
+    if (tree && tree->intern) {
+        temp = InternString(tree->intern, string, length);
+        if (temp && old) {
+            TreeFreeString(tree, old);
+        }
+    }
+    else {
+        temp = TreeRealloc(tree, old, (old) ? (strlen(old) + 1) : (0), length + 1);
+        if (temp) {
+            memcpy(temp, string, length);
+            temp[length] = '\0';
+        }
+    }
+
+    if (temp && !old) {
+        unsigned long zero = 0;
+        __atomic_store_n(&node->type, stringValue, __ATOMIC_SEQ_CST);
+        if (!__atomic_compare_exchange_n(&node->value.integer, &zero, (unsigned long) temp, FALSE,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            __atomic_store_n(&node->type, integerValue, __ATOMIC_SEQ_CST);
+            TreeFreeString(tree, temp);
+            temp = NULL;
+        }
+    }
+    else if (temp) {
+        __atomic_store_n(&node->value.string, temp, __ATOMIC_RELEASE);
+    }
+    return temp;
+}
+
+// Make room for more children (grows geometrically- amortized constant time per child)
+static int ReserveChildren(NODE *parent, const unsigned int numChildren) {
+    if (numChildren <= parent->capChildren) {
+        return OK;
+    }
+
+    unsigned int capacity = (parent->capChildren) ? (parent->capChildren) : (CHILDLIMIT);
+    while (capacity < numChildren) {
+        capacity *= 2;
+    }
+
+    // Not using ReallocHandling- on failure the parent keeps its old children
+    NODE **children = TreeRealloc(TreeOf(parent), parent->children,
+                                  ChildrenSize(parent->capChildren), ChildrenSize(capacity));
+    if (!children) {
+        fprintf(stderr, "\nERROR: Reallocating memory failed!\n");
+        return ERROR;
+    }
+
+    // Tags move up behind grown children
+    memmove(&children[capacity], &children[parent->capChildren], parent->numChildren);
+    parent->children = children;
+    parent->capChildren = capacity;
+    return OK;
+}
+
+// Insert child into parents children (binary search for position, single move)
+static int InsertChild(NODE *parent, NODE *child) {
+    unsigned int position;
+
+    if (ReserveChildren(parent, parent->numChildren + 1) != OK) {
+        return ERROR;
+    }
+
+    FindChild(parent, NodeKey(child), strlen(NodeKey(child)), &position);
+    memmove(&parent->children[position + 1], &parent->children[position],
+            sizeof(NODE *) * (parent->numChildren - position));
+    memmove(&NodeTags(parent)[position + 1], &NodeTags(parent)[position], parent->numChildren - position);
+
+    parent->children[position] = child;
+    NodeTags(parent)[position] = TagOf(child->hash);
+    parent->numChildren++;
+    child->up.parent = parent;
+    return OK;
+}
+
+// Remove child from parents children (keeps children sorted)
+static void RemoveChild(NODE *parent, const NODE *child) {
+    unsigned int position;
+
+    if (FindChild(parent, NodeKey(child), strlen(NodeKey(child)), &position) == child) {
+        parent->numChildren--;
+        memmove(&parent->children[position], &parent->children[position + 1],
+                sizeof(NODE *) * (parent->numChildren - position));
+        memmove(&NodeTags(parent)[position], &NodeTags(parent)[position + 1], parent->numChildren - position);
+
+        // Last child gone
+        if (parent->numChildren == 0) {
+            TreeFree(TreeOf(parent), parent->children, ChildrenSize(parent->capChildren));
+            parent->children = NULL;
+            parent->capChildren = 0;
+        }
+    }
+}
+
+// Find node(s) by depth first traversal (root is required for forest, counts nodes visited)
+static int DephtFirstNodes(NODE **root, SEARCHRESULT **result, char *targetKey, const enum searchMode search,
+                           unsigned long *visited) {
+    /*
+     *  Depth First Traversal:
+     *      As recursion may put huge overhead on large trees (ie, exponentially increasing calls on stack)
+     *      an iterative preorder traversal for scalability is implemented.
+     *
+     *      The overhead incurred cannot be reasonably justified, especially for database queries.
+     *          - However, it might be reasonable to use inorder or postorder recursion to delete nodes.
+     *
+     *      How recursion would work:
+     *          A recursive function would send the stack back to itself, minus the current processed node.
+     *          Breaking out of it would be caused by finding target- or if stack and current equals empty.
+     */
+
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nSearch node error: root is null.\n");
+        return ERROR;
+    }
+
+    // Initialize LIFO-stack to root
+    int     stackSize = 1,
+            memLeftStack = MEMLIMIT,
+            memLeftNodes = 0,
+            i;
+
+    short int iRc = OK;
+
+    // Cached key hashes reject most nodes without comparing keys
+    unsigned int hash = (unsigned int) HashKey(targetKey);
+
+    NODE **stack = calloc ((size_t) stackSize + memLeftStack, sizeof(NODE *)),
+            *current;
+
+    // If calloc failed
+    if (!stack) {
+        iRc = ERROR;
+    }
+
+    if (iRc == OK) {
+        // Start stack with root
+        memcpy(stack, root, sizeof(NODE *) * stackSize);
+
+        // If current is null and stack is empty, no node was found
+        while (stackSize) {
+            // Set current to top of stack
+            current = stack[stackSize - 1];
+            (*visited)++;
+
+            // Result must be freed when searches are completed, this also goes for result nodes if more than one target.
+            if (search != targetNode) {
+                // Allocate memory for result nodes
+                memLeftNodes--;
+                if (memLeftNodes < 0) {
+                    memLeftNodes = MEMLIMIT;
+                    (*result)->nodes = ReallocHandling((*result)->nodes,
+                                                       sizeof(NODE *) * ((*result)->numNodes + memLeftNodes + 1));
+                    if (!(*result)->nodes) {
+                        iRc = ERROR;
+                        break;
+                    }
+                }
+                // Add to result
+                (*result)->nodes[(*result)->numNodes] = current;
+                (*result)->numNodes++;
+            }
+
+            // If current is target and search not full tree, return node(s)
+            if (current->hash == hash && strcmp(NodeKey(current), targetKey) == 0 && search != fullTree) {
+                if (search == targetNode) {
+                    (*result)->node = current;
+                    (*result)->numNodes++;
+                }
+                break;
+            }
+
+            // Push currents children to stack
+            if (current->numChildren != 0) {
+                // Do we need to allocate more memory?
+                memLeftStack -= current->numChildren;
+                if (memLeftStack < 0) {
+                    // Re-allocate memory to match stack + number of children + memlimit
+                    memLeftStack = MEMLIMIT;
+                    stack = ReallocHandling(stack,
+                                            (sizeof(NODE *) * (stackSize + memLeftStack) * current->numChildren));
+                    if (!stack) {
+                        iRc = ERROR;
+                        break;
+                    }
+                }
+
+                for (i = 0; i < current->numChildren; ++i) {
+                    // Increment stack size and add children to stack
+                    stack[stackSize - 1] = current->children[i];
+                    stackSize++;
+                }
+            }
+            stackSize--;        // Decrement stack
+            memLeftStack++;     // Make space available
+        }
+    }
+    else {
+        fprintf(stderr, "\nSearch node error: Allocating memory failed!\n");
+    }
+    // Free
+    if (stack) {
+        free (stack);
+    }
+
+    return iRc;
+}
+
+// Find node(s) by depth first traversal (writers are locked out of concurrent trees meanwhile)
+int DephtFirst(NODE **root, SEARCHRESULT **result, char *targetKey, const enum searchMode search) {
+    TREE *tree = (root) ? (LockTree(root)) : (NULL);
+    unsigned long visited = 0;
+    int iRc = DephtFirstNodes(root, result, targetKey, search, &visited);
+    UnlockTree(tree);
+    StatVisited(visited);
+    return iRc;
+}
+
+// Visit nodes depth first from root (explicit stack- memory grows with depth, not with number of nodes)
+static int TraverseNodes(NODE *root, VISITOR visitor, void *context, const enum traverseOrder order) {
+    /*
+     *  Traversal:
+     *      Each frame on the stack holds a node and the number of its children left to visit,
+     *      so the stack never holds more than one frame per level (grows by MEMLIMIT frames when full).
+     *
+     *      Children are visited last to first- the order Search has always reported nodes in (fullTree).
+     *      A postOrder visitor may free the node it's handed, as the traversal is done with it by then.
+     */
+
+    // Stack of nodes on path, with children left to visit
+    typedef struct { NODE *node; unsigned int next; } FRAME;
+    unsigned long size = 0,
+                  capStack = MEMLIMIT;
+    enum visitResult visit = visitContinue;
+
+    FRAME *stack = malloc (sizeof(FRAME) * capStack);
+    if (!stack) {
+        fprintf(stderr, "\nTraverse error: allocating memory failed!\n");
+        return ERROR;
+    }
+
+    // Start stack with root
+    stack[size++] = (FRAME) { root, root->numChildren };
+    if (order == preOrder) {
+        visit = visitor(root, 0, context);
+        if (visit == visitSkip) {
+            stack[0].next = 0;
+        }
+    }
+
+    while (size && visit != visitStop) {
+        FRAME *frame = &stack[size - 1];
+
+        // Done with children- back to parent
+        if (frame->next == 0) {
+            size--;
+            if (order == postOrder) {
+                visit = visitor(frame->node, size, context);
+            }
+            continue;
+        }
+
+        NODE *child = frame->node->children[--frame->next];
+        if (order == preOrder) {
+            visit = visitor(child, size, context);
+            if (visit != visitContinue || child->numChildren == 0) {
+                continue;
+            }
+        }
+
+        // Descend
+        if (size == capStack) {
+            FRAME *temp = realloc (stack, sizeof(FRAME) * (capStack + MEMLIMIT));
+            if (!temp) {
+                fprintf(stderr, "\nTraverse error: allocating memory failed!\n");
+                free(stack);
+                return ERROR;
+            }
+            stack = temp;
+            capStack += MEMLIMIT;
+        }
+        stack[size++] = (FRAME) { child, child->numChildren };
+    }
+
+    free(stack);
+    return OK;
+}
+
+// Visit nodes depth first from target (writers are locked out of concurrent trees meanwhile- visitor must not add or delete)
+int Traverse(NODE **root, VISITOR visitor, void *context, const enum traverseOrder order) {
+    // If no root
+    if (!root || !*root || !visitor) {
+        fprintf(stderr, "\nTraverse error: root or visitor is null.\n");
+        return ERROR;
+    }
+
+    // Image backed trees hold no nodes to hand out
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nTraverse error: tree is an image (no nodes to visit).\n");
+        return ERROR;
+    }
+
+    TREE *tree = LockTree(root);
+    int iRc = TraverseNodes(*root, visitor, context, order);
+    UnlockTree(tree);
+    return iRc;
+}
+
+// Search (handle search types)
+static int SearchNodes(NODE **root, SEARCHRESULT **result, char *targetKey, const enum searchMode search) {
+    /*
+     *  Allow parents to hold same key name:
+     *      Requires iterative walk through each node in path (out of the scope for this assignment).
+     *
+     *  Allow leafs to hold duplicate key names:
+     *      Requires node paths (parent.key): finds parent and searches children.
+     *
+     *  Unique leafs:
+     *      Only requires child (key): finds child, but does not allow for duplicate key names in leafs.
+     */
+
+    // Receive path or key, return target according to specification and search type
+
+    char *key = NULL;
+    unsigned long visited = 0;
+
+    // Walk path through sorted children (also the only way to reach duplicate leaf names)
+    if (search == targetPath || (search == targetNode && (UNIQUEKEYS == FALSE || strstr(targetKey, ".") != NULL))) {
+        TREE *state = ((*root)->flags & NODEROOT) ? ((*root)->up.tree) : (NULL);
+        NODE *node = (state && state->art) ? (ArtResolve(state, targetKey, &visited)) :
+                     (ResolvePath(*root, targetKey, &visited));
+        if (node) {
+            (*result)->node = node;
+            (*result)->numNodes++;
+            StatVisited(visited);
+            return OK;
+        }
+
+        // Nothing more to try without unique keys
+        if (UNIQUEKEYS == FALSE || search == targetPath) {
+            StatVisited(visited);
+            return OK;
+        }
+    }
+
+    // Find child node, return target (unique leafs)
+    if (UNIQUEKEYS == TRUE) {
+        // Split key path into target end key if it contains '.'
+        if (search != fullTree && strstr(targetKey, ".") != NULL) {
+            key = calloc (strlen(targetKey) + 1, sizeof(char));
+
+            // if calloc failed
+            if (!key) {
+                StatVisited(visited);
+                return ERROR;
+            }
+            SplitEndKey(key, targetKey);
+        }
+    }
+
+    // Unique keys are indexed- single node searches skip traversal (must be below given root)
+    TREE *tree = (UNIQUEKEYS == TRUE && search == targetNode) ? (TreeOf(*root)) : (NULL);
+
+    if (tree && tree->index) {
+        NODE *node = IndexLookup(tree->index, (key) ? (key) : (targetKey));
+        visited++;
+        if (node && IsDescendant(node, *root)) {
+            (*result)->node = node;
+            (*result)->numNodes++;
+        }
+    }
+
+    // Search types
+    else {
+        DephtFirstNodes(root, result, (key) ? (key) : (targetKey), search, &visited);
+    }
+
+    if (key) {
+        free (key);
+    }
+    StatVisited(visited);
+    return OK;
+}
+
+// Search (writers are locked out of concurrent trees meanwhile)
+int Search(NODE **root, SEARCHRESULT **result, char *targetKey, const enum searchMode search) {
+    unsigned long started = StatBegin(statSearch);
+    TREE *tree = LockTree(root);
+    int iRc = SearchNodes(root, result, targetKey, search);
+    UnlockTree(tree);
+    StatEnd(statSearch, started, iRc != OK);
+    return iRc;
+}
+
+// Add node
+static int AddNodeOp(NODE **root, char *targetKey, char *key) {
+    short int iRc = ERROR;
+    char error[51];     // Max 50 chars error message
+
+    // If no root
+    if (!root) {
+        strcpy(error, "root is null");
+    }
+
+        // Image backed trees are read-only
+    else if (ImageOf(root)) {
+        strcpy(error, "tree is read-only.");
+    }
+
+        // If missing key
+    else if (!key) {
+        strcpy(error, "missing key.");
+    }
+
+        // If missing target key
+    else if (!targetKey) {
+        strcpy(error, "missing target key.");
+    }
+
+    else {
+        // Check if key already exists in tree (unique keys only)
+        SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+        if (!result) {
+            strcpy(error, "allocating memory for search failed!");
+        }
+        else {
+            TREE *writer = WriteBegin(root);
+            if (UNIQUEKEYS == TRUE) {
+                Search(root, &result, key, targetNode);
+            }
+
+            if (result->node) {
+                strcpy(error, "key already exists in tree.");
+            } else {
+                // Find target
+                Search(root, &result, targetKey, targetNode);
+
+                // If target key wasn't found
+                if (!result->node) {
+                    strcpy(error, "target key doesn't exist in tree.");
+                }
+
+                // Duplicate key names are only disallowed among siblings
+                else if (UNIQUEKEYS == FALSE && FindChild(result->node, key, strlen(key), NULL)) {
+                    strcpy(error, "key already exists under target.");
                 } else {
-                    // Create child
-                    NODE *newNode = CreateNode(key);
-                    if (!newNode) {
+                    // Create child (room in index is reserved first, so a node linked below is always indexed)
+                    TREE *tree = TreeOf(result->node);
+                    NODE *newNode = NULL;
+                    if (tree && tree->index && TreeReserve(tree, 1) != OK) {
+                        strcpy(error, "allocating memory for index failed!");
+
+                    } else if (!(newNode = CreateNode(tree, key, strlen(key)))) {
                         strcpy(error, "problem creating new node.");
 
-                    } else {
-                        // Init string value to NULL
-                        newNode->value.string = NULL;
+                    } else {
+                        // Remove any values held by parent
+                        ClearValue(tree, result->node);
+
+                        // Add child to parents children (sorted)
+                        if (InsertChild(result->node, newNode) == OK) {
+                            // Index key (unique keys only- room is reserved above)
+                            if (tree && tree->index) {
+                                TreeIndex(tree, newNode);
+                            }
+                            TreePath(tree, newNode);
+                            LogNode(tree, walAdd, result->node, key, 0);
+
+                            iRc = OK;
+                        }
+                        else {
+                            FreeNode(tree, newNode);
+                            strcpy(error, "allocating memory for children failed!");
+                        }
+                    }
+                }
+            }
+            WriteEnd(writer);
+            free(result);
+        }
+    }
+    if (iRc != OK) {
+        fprintf(stderr, "\nAdd node '%s' error: %s", key, error);
+    }
+    return iRc;
+}
+
+// Add node (counted, see stats.h)
+int AddNode(NODE **root, char *targetKey, char *key) {
+    unsigned long started = StatBegin(statAdd);
+    int iRc = AddNodeOp(root, targetKey, key);
+    StatEnd(statAdd, started, iRc != OK);
+    return iRc;
+}
+
+// Compare node keys (for qsort)
+static int CompareNodes(const void *x, const void *y) {
+    return strcmp(NodeKey(*(NODE * const *) x), NodeKey(*(NODE * const *) y));
+}
+
+// Add several children to target at once (children are sorted once, rather than once per key)
+static int AddNodesOp(NODE **root, char *targetKey, char **keys, const unsigned int numKeys) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nAdd nodes error: root is null.\n");
+        return ERROR;
+    }
+
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nAdd nodes error: tree is read-only.\n");
+        return ERROR;
+    }
+
+    // If missing keys
+    if (!targetKey || (!keys && numKeys)) {
+        fprintf(stderr, "\nAdd nodes error: missing key.\n");
+        return ERROR;
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nAdd nodes error: allocating memory for search failed.\n");
+        return ERROR;
+    }
+
+    TREE *writer = WriteBegin(root);
+    Search(root, &result, targetKey, targetNode);
+    NODE *target = result->node;
+    free (result);
+
+    if (!target) {
+        fprintf(stderr, "\nAdd nodes error: target key doesn't exist in tree.\n");
+        WriteEnd(writer);
+        return ERROR;
+    }
+
+    // Room for every key up front (single reallocation, index too)- new children are gathered aside, merged into place below
+    TREE *tree = TreeOf(target);
+    NODE **new = malloc (sizeof(NODE *) * (numKeys + 1));
+    if (!new || ReserveChildren(target, target->numChildren + numKeys) != OK
+        || (tree && tree->index && TreeReserve(tree, numKeys) != OK)) {
+        fprintf(stderr, "\nAdd nodes error: allocating memory failed!\n");
+        free(new);
+        WriteEnd(writer);
+        return ERROR;
+    }
+
+    short int iRc = OK;
+    unsigned int old = target->numChildren,
+                 added = 0,
+                 i;
+
+    // Create new children
+    for (i = 0; i < numKeys; ++i) {
+        if (UNIQUEKEYS == TRUE && tree && tree->index && IndexLookup(tree->index, keys[i])) {
+            fprintf(stderr, "\nAdd node '%s' error: key already exists in tree.", keys[i]);
+            iRc = ERROR;
+        }
+        else if (UNIQUEKEYS == FALSE && FindChild(target, keys[i], strlen(keys[i]), NULL)) {
+            fprintf(stderr, "\nAdd node '%s' error: key already exists under target.", keys[i]);
+            iRc = ERROR;
+        }
+        else if (!(new[added] = CreateNode(tree, keys[i], strlen(keys[i])))) {
+            iRc = ERROR;
+        }
+        else {
+            new[added++]->up.parent = target;
+        }
+    }
+
+    // Sort new children once, dropping duplicates within batch
+    qsort(new, added, sizeof(NODE *), CompareNodes);
+    unsigned int unique = 0;
+    for (i = 0; i < added; ++i) {
+        if (unique && strcmp(NodeKey(new[unique - 1]), NodeKey(new[i])) == 0) {
+            fprintf(stderr, "\nAdd node '%s' error: key given more than once.", NodeKey(new[i]));
+            FreeNode(tree, new[i]);
+            iRc = ERROR;
+        }
+        else {
+            new[unique++] = new[i];
+        }
+    }
+
+    if (unique) {
+        // Remove any values held by target
+        ClearValue(tree, target);
+
+        // Merge sorted runs from the back (in place, existing children first on equal keys)
+        long x = (long) old - 1,
+             y = (long) unique - 1,
+             z = (long) (old + unique) - 1;
+
+        NODE **merged = target->children;
+        unsigned char *tags = NodeTags(target);
+        while (y >= 0) {
+            if (x >= 0 && strcmp(NodeKey(merged[x]), NodeKey(new[y])) > 0) {
+                tags[z] = tags[x];
+                merged[z--] = merged[x--];
+            }
+            else {
+                // Index key (unique keys only- room is reserved above)
+                if (tree && tree->index) {
+                    TreeIndex(tree, new[y]);
+                }
+                TreePath(tree, new[y]);
+                LogNode(tree, walAdd, target, NodeKey(new[y]), 0);
+                tags[z] = TagOf(new[y]->hash);
+                merged[z--] = new[y--];
+            }
+        }
+        target->numChildren = old + unique;
+    }
+    free(new);
+    WriteEnd(writer);
+    return iRc;
+}
+
+// Add nodes (counted, see stats.h)
+int AddNodes(NODE **root, char *targetKey, char **keys, const unsigned int numKeys) {
+    unsigned long started = StatBegin(statAdd);
+    int iRc = AddNodesOp(root, targetKey, keys, numKeys);
+    StatEnd(statAdd, started, iRc != OK);
+    return iRc;
+}
+
+// Get node type by node
+enum nodeType NodeType(NODE *node) {
+    enum nodeType type;
+
+    if (!node) {
+        fprintf(stderr, "\nGet type error: node is null.\n");
+        type = noSuchNode;
+    }
+
+    else if (node->numChildren != 0) {
+        type = parentNode;
+    }
+
+    else if (node->type == stringValue) {
+        type = stringNode;
+    }
+
+    else {
+        type = integerNode;
+    }
+
+    return type;
+}
+
+// Get node type by key
+static enum nodeType GetTypeOp(NODE **root, char *targetKey) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nGet type error: root is null.\n");
+        return errorUndefinedNode;
+    }
+
+    // Image backed tree
+    IMAGE *image = ImageOf(root);
+    if (image) {
+        long node = ImageFind(image, 0, targetKey);
+        if (node < 0) {
+            fprintf(stderr, "\nGet type error: no such key in tree.\n");
+        }
+        return ImageNodeType(image, node);
+    }
+
+    // Concurrent tree (lock free)
+    TREE *tree = ConcurrentOf(root);
+    if (tree) {
+        DATA value;
+        enum nodeType type = ReadValue(tree, *root, targetKey, &value, NULL);
+        if (type == noSuchNode) {
+            fprintf(stderr, "\nGet type error: no such key in tree.\n");
+        }
+        return type;
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nGet type error: allocating memory for search failed.\n");
+        return errorUndefinedNode;
+    }
+
+    Search(root, &result, targetKey, targetNode);
+    enum nodeType type = noSuchNode;
+
+    if (!result->node) {
+        fprintf(stderr, "\nGet type error: no such key in tree.\n");
+    }
+    else {
+        type = NodeType(result->node);
+    }
+    free (result);
+    return type;
+}
+
+// Get type of node (counted, see stats.h)
+enum nodeType GetType(NODE **root, char *targetKey) {
+    unsigned long started = StatBegin(statGet);
+    enum nodeType type = GetTypeOp(root, targetKey);
+    StatEnd(statGet, started, type <= noSuchNode);
+    return type;
+}
+
+// Set integer of node (no messages- usage is SetInt() and MultiSet(), writers only)
+static enum batchStatus SetNodeInt(NODE *node, const unsigned long valueInteger) {
+    enum nodeType type = (node) ? (NodeType(node)) : (noSuchNode);
+
+    if (type == integerNode) {
+        __atomic_store_n(&node->value.integer, valueInteger, __ATOMIC_RELAXED);
+        LogNode(TreeOf(node), walSetInt, node, NULL, valueInteger);
+        return batchOk;
+    }
+    return (type == stringNode) ? (batchWrongType) : ((type == parentNode) ? (batchParentNode) : (batchNoSuchKey));
+}
+
+// Set string of node (no messages- usage is SetString() and MultiSet(), writers only)
+static enum batchStatus SetNodeString(NODE *node, const char *valueString) {
+    enum nodeType type = (node) ? (NodeType(node)) : (noSuchNode);
+
+    if (type == noSuchNode || type == parentNode) {
+        return (type == parentNode) ? (batchParentNode) : (batchNoSuchKey);
+    }
+
+    // If stringNode- or if string is null and integer is 0
+    // (we allow setting string if integer is 0)
+    if (type == stringNode || __atomic_load_n(&node->value.integer, __ATOMIC_RELAXED) == 0) {
+        TREE *tree = TreeOf(node);
+        char *temp = NodeSetString(tree, node, valueString, strlen(valueString));
+        if (!temp) {
+            // Counter may have got in between
+            return (type == integerNode && __atomic_load_n(&node->value.integer, __ATOMIC_RELAXED)) ?
+                   (batchWrongType) : (batchNoMemory);
+        }
+        LogNode(tree, walSetString, node, temp, 0);
+        return batchOk;
+    }
+    return batchWrongType;
+}
+
+// Report outcome of setting integer (usage is SetInt() and SetIntH())
+static int SetIntReport(const enum batchStatus status) {
+    switch (status) {
+        case batchOk:
+            return OK;
+        case batchWrongType:
+            fprintf(stderr, "\nSet int error: node contains string value.\n");
+            break;
+        case batchParentNode:
+            fprintf(stderr, "\nSet int error: node is a parent node.\n");
+            break;
+        default:
+            fprintf(stderr, "\nSet int error: no such target key.\n");
+            break;
+    }
+    return ERROR;
+}
+
+// Report outcome of setting string (usage is SetString() and SetStringH())
+static int SetStringReport(const enum batchStatus status) {
+    switch (status) {
+        case batchOk:
+            return OK;
+        case batchNoMemory:
+            // We don't free old memory held by node string (if it fails, we'll keep the old data)
+            fprintf(stderr, "\nSet string error: reallocating memory failed.\n");
+            break;
+        case batchWrongType:
+            fprintf(stderr, "\nSet string error: node contains integer value.\n");
+            break;
+        case batchParentNode:
+            fprintf(stderr, "\nSet string error: node is a parent node.\n");
+            break;
+        default:
+            fprintf(stderr, "\nSet string error: no such target key.\n");
+            break;
+    }
+    return ERROR;
+}
+
+// Set node integer
+static int SetIntOp(NODE **root, char *targetKey, const unsigned long valueInteger) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nSet int error: root is null.\n");
+        return ERROR;
+    }
+
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nSet int error: tree is read-only.\n");
+        return ERROR;
+    }
+
+    short int iRc = OK;
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nSet int error: allocating memory for search failed.\n");
+        return ERROR;
+    }
+
+    TREE *writer = WriteBegin(root);
+    Search(root, &result, targetKey, targetNode);
+    iRc = SetIntReport(SetNodeInt(result->node, valueInteger));
+    WriteEnd(writer);
+    free (result);
+    return iRc;
+}
+
+// Set node integer (counted, see stats.h)
+int SetInt(NODE **root, char *targetKey, const unsigned long valueInteger) {
+    unsigned long started = StatBegin(statSet);
+    int iRc = SetIntOp(root, targetKey, valueInteger);
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Integer updates done in place (see UpdateNodeInt)
+enum intUpdate { intAdd, intCompareAndSet, intMax, intMin };
+
+// Update integer of node in place (atomic- value holds operand of compare and set, and is set to value held before,
+// changed tells if it was changed). Retried until no other thread got in between- node is checked to hold an integer
+// on every try, as writers set the type of a string before claiming the integer, and clear a string before its type
+// (see NodeSetString and ClearValue)
+static enum batchStatus UpdateNodeInt(NODE *node, const enum intUpdate update, const unsigned long operand,
+                                      unsigned long *value, short int *changed) {
+    unsigned long old,
+                  new;
+
+    if (!node) {
+        return batchNoSuchKey;
+    }
+
+    do {
+        unsigned char type = __atomic_load_n(&node->type, __ATOMIC_SEQ_CST);
+        old = __atomic_load_n(&node->value.integer, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&node->numChildren, __ATOMIC_RELAXED)) {
+            return batchParentNode;
+        }
+        if (type != integerValue || __atomic_load_n(&node->type, __ATOMIC_SEQ_CST) != integerValue) {
+            return batchWrongType;
+        }
+
+        switch (update) {
+            case intAdd:
+                new = old + operand;
+                break;
+            case intCompareAndSet:
+                new = (old == *value) ? (operand) : (old);
+                break;
+            default:
+                new = ((update == intMax) == (operand > old)) ? (operand) : (old);
+                break;
+        }
+    } while (new != old && !__atomic_compare_exchange_n(&node->value.integer, &old, new, FALSE,
+                                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    *value = old;
+    *changed = (new != old) ? (TRUE) : (FALSE);
+    return batchOk;
+}
+
+// Counter being logged (see CounterRead)
+typedef struct _COUNTERLOG {
+    SYNC            *sync;              // Writers to check for  (NULL if tree isn't concurrent)
+    unsigned long   sequence;           // Sequence path was taken at
+    NODE            *node;
+    short int       retry;              // Writer got in between
+} COUNTERLOG;
+
+// Read integer of counter to log (under log lock- nothing is logged if node holds no integer anymore, the writer that
+// changed it logs it)
+static int CounterRead(void *context, unsigned long *integer) {
+    COUNTERLOG *log = context;
+    unsigned char type = __atomic_load_n(&log->node->type, __ATOMIC_ACQUIRE);
+
+    *integer = __atomic_load_n(&log->node->value.integer, __ATOMIC_ACQUIRE);
+    short int holds = (type == integerValue && __atomic_load_n(&log->node->type, __ATOMIC_RELAXED) == integerValue
+                       && !__atomic_load_n(&log->node->numChildren, __ATOMIC_RELAXED)) ? (TRUE) : (FALSE);
+
+    // Records of writers in between must come first- read again once they're done
+    if (log->sync && !SyncReadValid(log->sync, log->sequence)) {
+        log->retry = TRUE;
+        return FALSE;
+    }
+    return holds;
+}
+
+// Get path of node for log record (keys from root, written back to front- writers may move nodes meanwhile, so it's
+// grown as it goes rather than measured first, see CounterRead)
+static int CounterPath(const NODE *node, char **path, size_t *capPath, size_t *pathLength) {
+    size_t length = 0;
+
+    while (node) {
+        const char *key = NodeKey(node);
+        size_t keyLength = strlen(key);
+
+        if (length + keyLength + 1 > *capPath) {
+            size_t capacity = (*capPath) ? (*capPath * 2) : (256);
+            while (length + keyLength + 1 > capacity) {
+                capacity *= 2;
+            }
+            char *temp = malloc (capacity);
+            if (!temp) {
+                return ERROR;
+            }
+            if (length) {
+                memcpy(temp + capacity - length, *path + *capPath - length, length);
+            }
+            free(*path);
+            *path = temp;
+            *capPath = capacity;
+        }
+
+        char *cursor = *path + *capPath - length;
+        if (length) {
+            *--cursor = '.';
+            length++;
+        }
+        memcpy(cursor - keyLength, key, keyLength);
+        length += keyLength;
+        node = NodeParent(node);
+    }
+
+    memmove(*path, *path + *capPath - length, length);
+    *pathLength = length;
+    return OK;
+}
+
+// Note counter updated in place (marks path for next version, logs integer held once no writer is in between)
+static void CounterLog(TREE *tree, NODE *node) {
+    COUNTERLOG log = { tree->sync, 0, node, FALSE };
+    char *path = NULL;
+    size_t capPath = 0,
+           pathLength;
+
+    MarkChanged(node);
+    if (!tree->wal) {
+        return;
+    }
+
+    do {
+        log.retry = FALSE;
+        log.sequence = (log.sync) ? (SyncReadBegin(log.sync)) : (0);
+        if (CounterPath(node, &path, &capPath, &pathLength) != OK) {
+            fprintf(stderr, "\nLog error: allocating memory for record failed (mutation isn't logged)!\n");
+            break;
+        }
+    } while (WalAppendInt(tree->wal, path, pathLength, CounterRead, &log) == OK && log.retry);
+    free(path);
+}
+
+// Update node integer in place (name is for messages- usage is AddInt(), CompareAndSetInt(), FetchMax() and FetchMin())
+static int UpdateIntOp(NODE **root, char *targetKey, const enum intUpdate update, const unsigned long operand,
+                       unsigned long *value, const char *name) {
+    // If no root
+    if (!root || !*root || !targetKey) {
+        fprintf(stderr, "\n%s error: root or key is null.\n", name);
+        return ERROR;
+    }
+
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\n%s error: tree is read-only.\n", name);
+        return ERROR;
+    }
+
+    TREE *tree = TreeOf(*root),
+         *concurrent = ConcurrentOf(root);
+    enum batchStatus status;
+    short int changed = FALSE;
+
+    // Resolved as readers do and updated with a single atomic operation- writers aren't held off (pinned, so node
+    // stays valid even if it's deleted meanwhile)
+    if (concurrent) {
+        unsigned long sequence;
+        short int retry;
+        NODE *node;
+
+        if (SyncPin(concurrent->sync) != OK) {
+            fprintf(stderr, "\n%s error: pinning tree failed.\n", name);
+            return ERROR;
+        }
+        do {
+            retry = FALSE;
+            sequence = SyncReadBegin(concurrent->sync);
+            node = ReadFind(concurrent, *root, targetKey, sequence, &retry);
+        } while (retry || !SyncReadValid(concurrent->sync, sequence));
+
+        status = UpdateNodeInt(node, update, operand, value, &changed);
+        if (changed) {
+            CounterLog(tree, node);
+        }
+        SyncUnpin(concurrent->sync);
+    }
+    else {
+        SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+        if (!result) {
+            fprintf(stderr, "\n%s error: allocating memory for search failed.\n", name);
+            return ERROR;
+        }
+
+        Search(root, &result, targetKey, targetNode);
+        status = UpdateNodeInt(result->node, update, operand, value, &changed);
+        if (changed && tree) {
+            CounterLog(tree, result->node);
+        }
+        free (result);
+    }
+
+    // Log grown past limit is checkpointed by a write section (as after any other write)
+    if (status == batchOk && tree && tree->wal && WalCompactDue(tree->wal, FALSE)) {
+        WriteEnd(WriteBegin(root));
+    }
+
+    switch (status) {
+        case batchOk:
+            return OK;
+        case batchWrongType:
+            fprintf(stderr, "\n%s error: node contains string value.\n", name);
+            break;
+        case batchParentNode:
+            fprintf(stderr, "\n%s error: node is a parent node.\n", name);
+            break;
+        default:
+            fprintf(stderr, "\n%s error: no such target key.\n", name);
+            break;
+    }
+    return ERROR;
+}
+
+// Add to node integer in place (delta may be negative- wraps as unsigned, new value is returned if asked for)
+int AddInt(NODE **root, char *targetKey, const long delta, unsigned long *newValue) {
+    unsigned long started = StatBegin(statSet),
+                  old;
+    int iRc = UpdateIntOp(root, targetKey, intAdd, (unsigned long) delta, &old, "Add int");
+
+    if (iRc == OK && newValue) {
+        *newValue = old + (unsigned long) delta;
+    }
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Set node integer if it holds expected (else ERROR, expected is set to value held- unless key isn't found)
+int CompareAndSetInt(NODE **root, char *targetKey, unsigned long *expected, const unsigned long desired) {
+    if (!expected) {
+        fprintf(stderr, "\nCompare and set int error: expected is null.\n");
+        return ERROR;
+    }
+
+    unsigned long started = StatBegin(statSet),
+                  held = *expected;
+    int iRc = UpdateIntOp(root, targetKey, intCompareAndSet, desired, &held, "Compare and set int");
+
+    if (iRc == OK && held != *expected) {
+        *expected = held;
+        iRc = ERROR;
+    }
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Raise node integer to value if it's below (value held before is returned if asked for)
+int FetchMax(NODE **root, char *targetKey, const unsigned long value, unsigned long *previous) {
+    unsigned long started = StatBegin(statSet),
+                  old;
+    int iRc = UpdateIntOp(root, targetKey, intMax, value, &old, "Fetch max");
+
+    if (iRc == OK && previous) {
+        *previous = old;
+    }
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Lower node integer to value if it's above (value held before is returned if asked for)
+int FetchMin(NODE **root, char *targetKey, const unsigned long value, unsigned long *previous) {
+    unsigned long started = StatBegin(statSet),
+                  old;
+    int iRc = UpdateIntOp(root, targetKey, intMin, value, &old, "Fetch min");
+
+    if (iRc == OK && previous) {
+        *previous = old;
+    }
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Set node string
+static int SetStringOp(NODE **root, char *targetKey, const char *valueString) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nSet string error: root is null.\n");
+        return ERROR;
+    }
+
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nSet string error: tree is read-only.\n");
+        return ERROR;
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nSet string error: allocating memory for search failed.\n");
+        return ERROR;
+    }
+
+    short int iRc = OK;
+    TREE *writer = WriteBegin(root);
+    Search(root, &result, targetKey, targetNode);
+    iRc = SetStringReport(SetNodeString(result->node, valueString));
+    WriteEnd(writer);
+    free (result);
+    return iRc;
+}
+
+// Set node string (counted, see stats.h)
+int SetString(NODE **root, char *targetKey, const char *valueString) {
+    unsigned long started = StatBegin(statSet);
+    int iRc = SetStringOp(root, targetKey, valueString);
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Get node integer
+static unsigned long GetIntOp(NODE **root, char *targetKey) {
+    // Chosen to return 0 if error due to unsigned value easily getting mistaken for real values.
+    // Returning a data structure with value and error code would be less prone to erroneous mistakes
+
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nGet int error: root is null.\n");
+        return 0;
+    }
+
+    // Image backed tree
+    IMAGE *image = ImageOf(root);
+    if (image) {
+        long node = ImageFind(image, 0, targetKey);
+        if (node < 0) {
+            fprintf(stderr, "\nGet int error: no such key in tree.\n");
+        }
+        else if (ImageNodeType(image, node) != integerNode) {
+            fprintf(stderr, "\nGet int error: wrong node type.\n");
+        }
+        else {
+            return image->nodes[node].integer;
+        }
+        return 0;
+    }
+
+    // Concurrent tree (lock free)
+    TREE *tree = ConcurrentOf(root);
+    if (tree) {
+        DATA value;
+        enum nodeType type = ReadValue(tree, *root, targetKey, &value, NULL);
+        if (type == noSuchNode) {
+            fprintf(stderr, "\nGet int error: no such key in tree.\n");
+        }
+        else if (type != integerNode) {
+            fprintf(stderr, "\nGet int error: wrong node type.\n");
+        }
+        return (type == integerNode) ? (value.integer) : (0);
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nGet int error: allocating memory for search failed.\n");
+        return 0;
+    }
+
+    Search(root, &result, targetKey, targetNode);
+    unsigned long value = 0;
+
+    if (result->node) {
+        // Get type
+        enum nodeType targetNode = NodeType(result->node);
+
+        if (targetNode == integerNode) {
+            value = __atomic_load_n(&result->node->value.integer, __ATOMIC_RELAXED);
+        }
+
+        else {
+            fprintf(stderr, "\nGet int error: wrong node type.\n");
+        }
+    }
+
+    else {
+        fprintf(stderr, "\nGet int error: no such key in tree.\n");
+    }
+    free (result);
+    return value;
+}
+
+// Get node integer (counted, see stats.h)
+unsigned long GetInt(NODE **root, char *targetKey) {
+    unsigned long started = StatBegin(statGet);
+    unsigned long value = GetIntOp(root, targetKey);
+    StatEnd(statGet, started, FALSE);
+    return value;
+}
+
+// Get node string
+static char *GetStringOp(NODE **root, char *targetKey) {
+    char *value = NULL;   // Trying to printf a null will crash
+
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nGet string error: root is null.\n");
+        return value;
+    }
+
+    // Image backed tree (string is handed out from image, no copy)
+    IMAGE *image = ImageOf(root);
+    if (image) {
+        long node = ImageFind(image, 0, targetKey);
+        if (node < 0) {
+            fprintf(stderr, "\nGet string error: no such key in tree.\n");
+        }
+        else if (ImageNodeType(image, node) != stringNode) {
+            fprintf(stderr, "\nGet string error: wrong node type.\n");
+        }
+        else {
+            value = (char *) image->pool + image->nodes[node].string;
+        }
+        return value;
+    }
+
+    // Concurrent tree (lock free- string stays valid while caller holds ReadLock)
+    TREE *tree = ConcurrentOf(root);
+    if (tree) {
+        DATA data;
+        enum nodeType type = ReadValue(tree, *root, targetKey, &data, NULL);
+        if (type == noSuchNode) {
+            fprintf(stderr, "\nGet string error: no such key in tree.\n");
+        }
+        else if (type != stringNode) {
+            fprintf(stderr, "\nGet string error: wrong node type.\n");
+        }
+        return (type == stringNode) ? (data.string) : (NULL);
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nGet string error: allocating memory for search failed.\n");
+        return value;
+    }
+
+    Search(root, &result, targetKey, targetNode);
+
+    if (result->node) {
+        // Get type
+        enum nodeType targetNode = NodeType(result->node);
+
+        if (targetNode == stringNode) {
+            value = result->node->value.string;
+        }
+
+        else {
+            fprintf(stderr, "\nGet string error: wrong node type.\n");
+        }
+    }
+
+    else {
+        fprintf(stderr, "\nGet string error: no such key in tree.\n");
+    }
+    free (result);
+    return value;
+}
+
+// Get node string (counted, see stats.h)
+char *GetString(NODE **root, char *targetKey) {
+    unsigned long started = StatBegin(statGet);
+    char *string = GetStringOp(root, targetKey);
+    StatEnd(statGet, started, !string);
+    return string;
+}
+
+// String / integer accessor (if string = null, then integer value- copied to data, NULL if key holds no value)
+static DATA *GetValueOp(NODE **root, char *targetKey, DATA *data) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nGet value error: root is null.\n");
+        return NULL;
+    }
+
+    if (!data) {
+        fprintf(stderr, "\nGet value error: data is null.\n");
+        return NULL;
+    }
+
+    // Image backed tree (strings point into image)
+    IMAGE *image = ImageOf(root);
+    if (image) {
+        long node = ImageFind(image, 0, targetKey);
+        enum nodeType type = ImageNodeType(image, node);
+
+        if (type != stringNode && type != integerNode) {
+            return NULL;
+        }
+        data->integer = image->nodes[node].integer;
+        data->string = (type == stringNode) ? ((char *) image->pool + image->nodes[node].string) : (NULL);
+        return data;
+    }
+
+    // Concurrent tree (lock free- string stays valid while caller holds ReadLock)
+    TREE *tree = ConcurrentOf(root);
+    if (tree) {
+        DATA value;
+        NODE *node;
+        enum nodeType type = ReadValue(tree, *root, targetKey, &value, &node);
+
+        if (type != stringNode && type != integerNode) {
+            return NULL;
+        }
+        *data = value;
+        return data;
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nGet value error: allocating memory for search failed.\n");
+        return NULL;
+    }
+
+    DATA *value = NULL;
+    Search(root, &result, targetKey, targetNode);
+    if (result->node) {
+        enum nodeType type = NodeType(result->node);
+
+        if (type == stringNode || type == integerNode) {
+            value = NodeData(result->node, data);
+        }
+    }
+    free (result);
+    return value;
+}
+
+// Get node value (counted, see stats.h)
+DATA *GetValue(NODE **root, char *targetKey, DATA *data) {
+    unsigned long started = StatBegin(statGet);
+    DATA *value = GetValueOp(root, targetKey, data);
+    StatEnd(statGet, started, !value);
+    return value;
+}
+
+// String / integer mutator (sets argument to corresponding format- %s for string, %d for int)
+int SetValue(NODE **root, char *targetKey, char *format, ...) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nSet value error: root is null.\n");
+        return ERROR;
+    }
+
+    // Points to each unnamed arg in turn
+    va_list ap;
+    char *p;
+
+    // Make ap point to 1st unnamed arg
+    va_start(ap, format);
+
+    // Iterate over args
+    for (p = format; *p; p++) {
+        if (*p != '%') {
+            fprintf(stderr, "Set value error: valid formats are '%%s' for string and '%%d' for integer.");
+            return ERROR;
+        }
+        switch (*++p) {
+            case 'd':
+                SetInt(root, targetKey, va_arg(ap, unsigned long));
+                break;
+            case 's':
+                SetString(root, targetKey, va_arg(ap, char *));
+                break;
+            default:
+                break;
+        }
+    }
+    // Clean up when done
+    va_end(ap);
+
+    return OK;
+}
+
+/*
+ *  Batches:
+ *      Keys are sorted first, so paths sharing leading components follow each other-
+ *      each path resumes from the components it shares with the previous one, rather than from root.
+ *      Plain keys are a single index probe (unique keys).
+ *
+ *      Nothing is allocated per key, and nothing is written to stderr- each key gets a status instead.
+ */
+
+// Resolved path of previous key in batch
+typedef struct _BATCHPATH {
+    const   char    *key;
+    NODE            *nodes[BATCHDEPTH]; // Node of each component
+    size_t          ends[BATCHDEPTH];   // End of each component in key
+    unsigned int    depth;
+} BATCHPATH;
+
+// Compare keys of batch (for qsort, elements point into keys)
+static int CompareBatchKeys(const void *x, const void *y) {
+    return strcmp(**(char * const * const *) x, **(char * const * const *) y);
+}
+
+// Resolve path from components shared with previous key (same rules as ResolvePath)
+static NODE *BatchResolve(BATCHPATH *previous, NODE *root, const char *key) {
+    NODE *current = root;
+    const char *component = key,
+               *end;
+    unsigned int depth = 0;
+    size_t length,
+           common = 0;
+
+    // Resume after last component shared with previous key
+    if (previous->key) {
+        while (key[common] && key[common] == previous->key[common]) {
+            common++;
+        }
+        while (depth < previous->depth && previous->ends[depth] <= common
+               && (key[previous->ends[depth]] == '.' || key[previous->ends[depth]] == '\0')) {
+            depth++;
+        }
+        if (depth) {
+            current = previous->nodes[depth - 1];
+            component = key + previous->ends[depth - 1];
+            if (*component == '.') {
+                component++;
+            }
+        }
+    }
+
+    while (current && *component) {
+        end = strchr(component, '.');
+        length = (end) ? ((size_t) (end - component)) : (strlen(component));
+
+        // Wildcard ends path
+        if (length == 1 && *component == '*') {
+            break;
+        }
+
+        NODE *child = FindChild(current, component, length, NULL);
+
+        // Path may start with root key
+        if (!child && current == root && component == key && CompareKey(NodeKey(root), component, length) == 0) {
+            child = root;
+        }
+        current = child;
+
+        component += length;
+        if (current && depth < BATCHDEPTH) {
+            previous->nodes[depth] = current;
+            previous->ends[depth++] = (size_t) (component - key);
+        }
+        if (*component == '.') {
+            component++;
+        }
+    }
+
+    previous->key = key;
+    previous->depth = depth;
+    return current;
+}
+
+// Find node of batch key (same rules as Search for single nodes)
+static NODE *BatchFind(BATCHPATH *previous, TREE *tree, NODE *root, const char *key) {
+    NODE *node = NULL;
+
+    // Walk path (also the only way to reach duplicate leaf names)
+    if (UNIQUEKEYS == FALSE || strchr(key, '.')) {
+        node = BatchResolve(previous, root, key);
+        if (node || UNIQUEKEYS == FALSE) {
+            return node;
+        }
+    }
+
+    if (!tree || !tree->index) {
+        return NULL;
+    }
+
+    // End key (excl. "*")
+    const char *dot;
+    size_t length = strlen(key);
+    if (strchr(key, '.')) {
+        while (length && (key[length - 1] == '*' || key[length - 1] == '.')) {
+            length--;
+        }
+        for (dot = key; (dot = memchr(key, '.', length)); ) {
+            length -= (size_t) (dot + 1 - key);
+            key = dot + 1;
+        }
+    }
+
+    node = IndexLookupLength(tree->index, key, length);
+    return (node && IsDescendant(node, root)) ? (node) : (NULL);
+}
+
+// Sort batch keys (order holds pointers into keys, scratch is used unless batch is larger)
+static char ***BatchOrder(char **keys, const unsigned int numKeys, char ***scratch) {
+    char ***order = (numKeys <= BATCHLIMIT) ? (scratch) : (malloc (sizeof(char **) * numKeys));
+    short int paths = (UNIQUEKEYS == FALSE) ? (TRUE) : (FALSE);
+    unsigned int i;
+
+    if (order) {
+        for (i = 0; i < numKeys; ++i) {
+            order[i] = &keys[i];
+            if (!paths && strchr(keys[i], '.')) {
+                paths = TRUE;
+            }
+        }
+
+        // Only paths gain from sorting (plain keys are probed in any order)
+        if (paths) {
+            qsort(order, numKeys, sizeof(char **), CompareBatchKeys);
+        }
+    }
+    return order;
+}
+
+// Get values of several keys at once (status per key- values are only set for batchOk, as by GetValue)
+static int MultiGetOp(NODE **root, char **keys, const unsigned int numKeys, DATA *values, enum batchStatus *status) {
+    short int iRc = OK;
+    unsigned int i;
+
+    // If no root
+    if (!root || !keys || !values || !status) {
+        fprintf(stderr, "\nMulti get error: root or arguments are null.\n");
+        return ERROR;
+    }
+
+    // Image backed tree (each key is a probe of the image)
+    IMAGE *image = ImageOf(root);
+    if (image) {
+        for (i = 0; i < numKeys; ++i) {
+            long node = ImageFind(image, 0, keys[i]);
+            enum nodeType type = ImageNodeType(image, node);
+
+            status[i] = (type == stringNode || type == integerNode) ? (batchOk) :
+                        ((type == parentNode) ? (batchParentNode) : (batchNoSuchKey));
+            if (status[i] == batchOk) {
+                values[i].integer = image->nodes[node].integer;
+                values[i].string = (type == stringNode) ? ((char *) image->pool + image->nodes[node].string) : (NULL);
+            }
+            else {
+                iRc = ERROR;
+            }
+        }
+        return iRc;
+    }
+
+    char **scratch[BATCHLIMIT],
+         ***order = BatchOrder(keys, numKeys, scratch);
+    if (!order) {
+        for (i = 0; i < numKeys; ++i) {
+            status[i] = batchNoMemory;
+        }
+        return ERROR;
+    }
+
+    // Writers are locked out of concurrent trees for the whole batch (keys are read as of one moment)
+    TREE *locked = LockTree(root),
+         *tree = TreeOf(*root);
+    BATCHPATH previous = { NULL };
+
+    for (i = 0; i < numKeys; ++i) {
+        unsigned int key = (unsigned int) (order[i] - keys);
+        NODE *node = BatchFind(&previous, tree, *root, keys[key]);
+        enum nodeType type = (node) ? (NodeType(node)) : (noSuchNode);
+
+        if (type == stringNode || type == integerNode) {
+            NodeData(node, &values[key]);
+            status[key] = batchOk;
+        }
+        else {
+            status[key] = (type == parentNode) ? (batchParentNode) : (batchNoSuchKey);
+            iRc = ERROR;
+        }
+    }
+    UnlockTree(locked);
+
+    if (order != scratch) {
+        free(order);
+    }
+    return iRc;
+}
+
+// Get values of keys (counted, see stats.h)
+int MultiGet(NODE **root, char **keys, const unsigned int numKeys, DATA *values, enum batchStatus *status) {
+    unsigned long started = StatBegin(statGet);
+    int iRc = MultiGetOp(root, keys, numKeys, values, status);
+    StatEnd(statGet, started, iRc != OK);
+    return iRc;
+}
+
+// Set values of several keys at once (strings as by SetString, integers as by SetInt if string is NULL- status per key)
+static int MultiSetOp(NODE **root, char **keys, const DATA *values, const unsigned int numKeys, enum batchStatus *status) {
+    short int iRc = OK;
+    unsigned int i;
+
+    // If no root
+    if (!root || !keys || !values || !status) {
+        fprintf(stderr, "\nMulti set error: root or arguments are null.\n");
+        return ERROR;
+    }
+
+    // Image backed trees are read-only
+    char **scratch[BATCHLIMIT],
+         ***order = (ImageOf(root)) ? (NULL) : (BatchOrder(keys, numKeys, scratch));
+    if (!order) {
+        for (i = 0; i < numKeys; ++i) {
+            status[i] = (ImageOf(root)) ? (batchReadOnly) : (batchNoMemory);
+        }
+        return ERROR;
+    }
+
+    // One write section for the whole batch
+    TREE *writer = WriteBegin(root),
+         *tree = TreeOf(*root);
+    BATCHPATH previous = { NULL };
+
+    for (i = 0; i < numKeys; ++i) {
+        unsigned int key = (unsigned int) (order[i] - keys);
+        NODE *node = BatchFind(&previous, tree, *root, keys[key]);
+
+        status[key] = (values[key].string) ? (SetNodeString(node, values[key].string)) :
+                      (SetNodeInt(node, values[key].integer));
+        if (status[key] != batchOk) {
+            iRc = ERROR;
+        }
+    }
+    WriteEnd(writer);
+
+    if (order != scratch) {
+        free(order);
+    }
+    return iRc;
+}
+
+// Set values of keys (counted, see stats.h)
+int MultiSet(NODE **root, char **keys, const DATA *values, const unsigned int numKeys, enum batchStatus *status) {
+    unsigned long started = StatBegin(statSet);
+    int iRc = MultiSetOp(root, keys, values, numKeys, status);
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
+
+// Print value of data to stream
+static int WriteValue(FILE *stream, const DATA *data) {
+    if (!data) {
+        return ERROR;
+    }
+    else if (!data->string) {
+        fprintf(stream, "integer value '%li'", data->integer);
+    }
+    else {
+        fprintf(stream, "string value \"%s\"", data->string);
+    }
+    return OK;
+}
+
+// Print value of data
+int PrintValue(const DATA *data) {
+    return WriteValue(stdout, data);
+}
+
+// Print key name and value of data to stream
+static int WriteKeyValue(FILE *stream, const char *targetKey, const DATA *data) {
+    fprintf(stream, "\n\t '%s'   \t :: \t", targetKey);
+    return WriteValue(stream, data);
+}
+
+// Print key name and value of data
+int EnumKeyValue(const char *targetKey, const DATA *data) {
+    WriteKeyValue(stdout, targetKey, data);
+    return OK;
+}
+
+// Visitor printing value holding nodes below target (Enumerate- context is stream printed into, NULL for stdout)
+static enum visitResult EnumVisitor(NODE *node, const unsigned long depth, void *context) {
+    // 0 is target node: 1 to go below target
+    if (depth > 0) {
+        enum nodeType type = NodeType(node);
+        // If holding value, callback
+        if (type == stringNode || type == integerNode) {
+            DATA data;
+            WriteKeyValue((context) ? (context) : (stdout), NodeKey(node), NodeData(node, &data));
+        }
+    }
+    return visitContinue;
+}
+
+// Enumerate all child nodes with values from given node
+int Enumerate(NODE **root, char *targetKey) {
+    short int iRc = ERROR;
+
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nEnumerate error: root is null.\n");
+        return iRc;
+    }
+
+    // Image backed tree
+    if (ImageOf(root)) {
+        return ImageEnumerate(ImageOf(root), targetKey);
+    }
+
+    // Get target
+    SEARCHRESULT *resultNode = calloc(1, sizeof(SEARCHRESULT));
+    if (!resultNode) {
+        fprintf(stderr, "\nEnumerate error: allocating memory for search failed.\n");
+        return iRc;
+    }
+
+    TREE *locked = LockTree(root);
+    Search(root, &resultNode, targetKey, targetNode);
+
+    if (resultNode->node) {
+        if (resultNode->node->numChildren > 0) {
+            printf("\nValue holding node(s) enumerated from '%s': ", targetKey);
+            iRc = TraverseParallel(resultNode->node, EnumVisitor, NULL, preOrder, stdout);
+            printf("\n");
+        }
+        else {
+            printf("\nNo value holding nodes found under '%s'.", targetKey);
+            iRc = OK;
+        }
+    }
+    UnlockTree(locked);
+    free (resultNode);
+    return iRc;
+}
+
+// Pattern components reached over "**" (may match no levels)
+static unsigned long QueryClosure(const CURSOR *cursor, unsigned long states) {
+    unsigned int i;
+
+    for (i = 0; i < cursor->numParts; ++i) {
+        if ((states & (1UL << i)) && cursor->parts[i].match == matchAny) {
+            states |= 1UL << (i + 1);
+        }
+    }
+    return states;
+}
+
+// Pattern components reached by child key from components reached by parent (0 if child can't match)
+static unsigned long QueryStep(const CURSOR *cursor, const unsigned long states, const char *key) {
+    unsigned long next = 0;
+    unsigned int i;
+
+    for (i = 0; i < cursor->numParts; ++i) {
+        const QUERYPART *part = &cursor->parts[i];
+
+        if (!(states & (1UL << i))) {
+            continue;
+        }
+        switch (part->match) {
+            case matchKey:
+                if (CompareKey(key, part->key, part->length) == 0) {
+                    next |= 1UL << (i + 1);
+                }
+                break;
+            case matchPrefix:
+                if (strncmp(key, part->key, part->length) == 0) {
+                    next |= 1UL << (i + 1);
+                }
+                break;
+            case matchOne:
+                next |= 1UL << (i + 1);
+                break;
+            case matchAny:
+                next |= 1UL << i;
+                break;
+        }
+    }
+    return QueryClosure(cursor, next);
+}
+
+// Number of children of node on path
+static unsigned int QueryNumChildren(const CURSOR *cursor, const QUERYFRAME *frame) {
+    return (cursor->image) ? (cursor->image->nodes[frame->index].numChildren) : (frame->node->numChildren);
+}
+
+// Key of child of node on path
+static const char *QueryChildKey(const CURSOR *cursor, const QUERYFRAME *frame, const unsigned int child) {
+    if (cursor->image) {
+        return cursor->image->pool + cursor->image->nodes[cursor->image->nodes[frame->index].firstChild + child].key;
+    }
+    return NodeKey(frame->node->children[child]);
+}
+
+// Push node onto path of cursor (children that can't match are cut off by binary search where possible)
+static int QueryPush(CURSOR *cursor, NODE *node, const long index, const unsigned long states, const size_t pathLength) {
+    if (cursor->depth == cursor->capStack) {
+        QUERYFRAME *temp = realloc (cursor->stack, sizeof(QUERYFRAME) * (cursor->capStack + MEMLIMIT));
+        if (!temp) {
+            fprintf(stderr, "\nQuery error: allocating memory failed!\n");
+            return ERROR;
+        }
+        cursor->stack = temp;
+        cursor->capStack += MEMLIMIT;
+    }
+
+    QUERYFRAME *frame = &cursor->stack[cursor->depth++];
+    *frame = (QUERYFRAME) { node, index, states, 0, 0, FALSE, pathLength };
+
+    // Nothing left to match below node
+    if (!(states & ((1UL << cursor->numParts) - 1))) {
+        return OK;
+    }
+    frame->end = QueryNumChildren(cursor, frame);
+
+    // Single key or prefix to match- binary search for first child that may match
+    unsigned int part = (unsigned int) __builtin_ctzl(states);
+    if ((states & (states - 1)) == 0
+        && (cursor->parts[part].match == matchKey || cursor->parts[part].match == matchPrefix)) {
+        const QUERYPART *match = &cursor->parts[part];
+        unsigned int low = 0,
+                     high = frame->end,
+                     mid;
+
+        while (low < high) {
+            mid = low + (high - low) / 2;
+            if (CompareKey(QueryChildKey(cursor, frame, mid), match->key, match->length) < 0) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+        frame->next = low;
+
+        // Keys are unique among children, prefixes match a range (ends at first child not matching)
+        if (match->match == matchKey) {
+            frame->end = (low < frame->end) ? (low + 1) : (low);
+        }
+        frame->prune = TRUE;
+    }
+    return OK;
+}
+
+// Query value holding nodes matching pattern (cursor must be closed by CursorClose)
+CURSOR *Query(NODE **root, const char *pattern) {
+    // If no root
+    if (!root || !*root || !pattern) {
+        fprintf(stderr, "\nQuery error: root or pattern is null.\n");
+        return NULL;
+    }
+
+    CURSOR *cursor = calloc (1, sizeof(CURSOR));
+    if (!cursor || !(cursor->pattern = strdup(pattern))) {
+        fprintf(stderr, "\nQuery error: allocating memory failed!\n");
+        free(cursor);
+        return NULL;
+    }
+
+    // Split pattern into components
+    char *component = cursor->pattern;
+    while (*component) {
+        char *end = strchr(component, '.');
+        size_t length = (end) ? ((size_t) (end - component)) : (strlen(component));
+
+        if (length == 0 || cursor->numParts + 2 > QUERYLIMIT) {
+            fprintf(stderr, "\nQuery error: invalid pattern '%s'.\n", pattern);
+            CursorClose(cursor);
+            return NULL;
+        }
+
+        QUERYPART *part = &cursor->parts[cursor->numParts++];
+        *part = (QUERYPART) { component, length, matchKey };
+        if (length == 2 && strncmp(component, "**", 2) == 0) {
+            part->match = matchAny;
+        }
+        else if (length == 1 && *component == '*') {
+            part->match = matchOne;
+
+            // Last component- anything below (one level or more)
+            if (!end) {
+                cursor->parts[cursor->numParts++] = (QUERYPART) { component, length, matchAny };
+            }
+        }
+        else if (component[length - 1] == '*') {
+            part->match = matchPrefix;
+            part->length--;
+        }
+
+        component += length;
+        if (*component == '.') {
+            component++;
+        }
+    }
+
+    // Pattern may start with root key
+    unsigned long states = QueryClosure(cursor, 1UL);
+    IMAGE *image = ImageOf(root);
+    const char *rootKey = (image) ? (image->pool + image->nodes[0].key) : (NodeKey(*root));
+    if (cursor->numParts && cursor->parts[0].match == matchKey
+        && CompareKey(rootKey, cursor->parts[0].key, cursor->parts[0].length) == 0) {
+        states |= QueryClosure(cursor, 1UL << 1);
+    }
+
+    cursor->image = image;
+    cursor->locked = LockTree(root);
+    if (QueryPush(cursor, (image) ? (NULL) : (*root), 0, states, 0) != OK) {
+        CursorClose(cursor);
+        return NULL;
+    }
+    return cursor;
+}
+
+// Next value holding node matching query (FALSE when no nodes are left- path and data are valid until next call)
+int CursorNext(CURSOR *cursor, char **path, DATA **data) {
+    if (!cursor) {
+        return FALSE;
+    }
+
+    while (cursor->depth) {
+        QUERYFRAME *frame = &cursor->stack[cursor->depth - 1];
+
+        // Done with children- back to parent
+        if (frame->next >= frame->end) {
+            cursor->depth--;
+            continue;
+        }
+
+        unsigned int child = frame->next++;
+        const char *key = QueryChildKey(cursor, frame, child);
+        unsigned long states = QueryStep(cursor, frame->states, key);
+
+        // Child can't match (nor can the rest of a prefix range)
+        if (!states) {
+            if (frame->prune) {
+                frame->end = frame->next;
+            }
+            continue;
+        }
+
+        // Append key to path
+        size_t keyLength = strlen(key),
+               pathLength = frame->pathLength + ((frame->pathLength) ? (1) : (0)) + keyLength;
+        if (pathLength + 1 > cursor->capPath) {
+            size_t capacity = (pathLength + 1) * 2;
+            char *temp = realloc (cursor->path, capacity);
+            if (!temp) {
+                fprintf(stderr, "\nQuery error: allocating memory failed!\n");
+                return FALSE;
+            }
+            cursor->path = temp;
+            cursor->capPath = capacity;
+        }
+        if (frame->pathLength) {
+            cursor->path[frame->pathLength] = '.';
+        }
+        memcpy(cursor->path + pathLength - keyLength, key, keyLength + 1);
+
+        // Value holding node matching pattern
+        NODE *node = NULL;
+        long index = 0;
+        unsigned int numChildren;
+        if (cursor->image) {
+            index = cursor->image->nodes[frame->index].firstChild + child;
+            numChildren = cursor->image->nodes[index].numChildren;
+        }
+        else {
+            node = frame->node->children[child];
+            numChildren = node->numChildren;
+        }
+
+        if (numChildren == 0) {
+            if (!(states & (1UL << cursor->numParts))) {
+                continue;
+            }
+            if (cursor->image) {
+                const IMAGENODE *imageNode = &cursor->image->nodes[index];
+                cursor->data.integer = imageNode->integer;
+                cursor->data.string = (imageNode->string != IMAGENONE) ?
+                                      ((char *) cursor->image->pool + imageNode->string) : (NULL);
+            }
+            else {
+                NodeData(node, &cursor->data);
+            }
+            if (path) {
+                *path = cursor->path;
+            }
+            if (data) {
+                *data = &cursor->data;
+            }
+            return TRUE;
+        }
+
+        // Descend
+        if (QueryPush(cursor, node, index, states, pathLength) != OK) {
+            return FALSE;
+        }
+    }
+    return FALSE;
+}
+
+// Close cursor (lets writers in again)
+int CursorClose(CURSOR *cursor) {
+    if (!cursor) {
+        return ERROR;
+    }
+    UnlockTree(cursor->locked);
+    free(cursor->pattern);
+    free(cursor->stack);
+    free(cursor->path);
+    free(cursor);
+    return OK;
+}
+
+// Visitor freeing nodes (postOrder- children are freed before their parent, context is tree or NULL)
+static enum visitResult FreeVisitor(NODE *node, const unsigned long depth, void *context) {
+    FreeNode(context, node);
+    return visitContinue;
+}
+
+// Visitor freeing nodes of interned tree (postOrder- strings go with the pool, context is NULL)
+static enum visitResult FreeInternedVisitor(NODE *node, const unsigned long depth, void *context) {
+    free(node->children);
+    free(node);
+    return visitContinue;
+}
+
+// Delete target node (incl. child nodes and empty parent nodes)
+static int DeleteOp(NODE **root, char *targetKey) {
+    short int iRc = ERROR;
+
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nDelete error: root is null.\n");
+        return iRc;
+    }
+
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nDelete error: tree is read-only.\n");
+        return iRc;
+    }
+
+    // Get target
+    SEARCHRESULT *result = calloc (1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nDelete error: allocating memory for search failed.\n");
+        return iRc;
+    }
+
+    TREE *writer = WriteBegin(root);
+    Search(root, &result, targetKey, targetNode);
+    NODE *target = result->node;
+
+    if (!target) {
+        fprintf(stderr, "\nDelete error: target key does not exist.\n");
+    }
+
+    // Deleting the tree root deletes the whole tree
+    else if (!NodeParent(target)) {
+        WriteEnd(writer);
+        writer = NULL;
+        iRc = DeinitTree(root);
+    }
+
+    else {
+        TREE *tree = TreeOf(*root);
+        NODE *parent = NodeParent(target);
+        LogNode(tree, walDelete, target, NULL, 0);
+
+        // Detach target, then walk upwards detaching parents left empty (but never the given root)
+        TreeUnpath(tree, target);
+        RemoveChild(parent, target);
+        while (parent->numChildren == 0 && parent != *root && NodeParent(parent)) {
+            NODE *empty = parent;
+            parent = NodeParent(parent);
+            TreeUnpath(tree, empty);
+            RemoveChild(parent, empty);
+            FreeNode(tree, empty);
+        }
+
+        // Free target and all of its children (on all cores- arenas, retire lists and pools take one thread at a time)
+        iRc = (tree && (tree->arena || tree->sync || tree->intern)) ?
+              (TraverseNodes(target, FreeVisitor, tree, postOrder)) :
+              (TraverseParallel(target, FreeVisitor, tree, postOrder, NULL));
+    }
+    WriteEnd(writer);
+
+    // Free search
+    free (result);
+
+    return iRc;
+}
+
+// Delete node (counted, see stats.h)
+int Delete(NODE **root, char *targetKey) {
+    unsigned long started = StatBegin(statDelete);
+    int iRc = DeleteOp(root, targetKey);
+    StatEnd(statDelete, started, iRc != OK);
+    return iRc;
+}
+
+// Return translation for node string value- or english text if translation is void
+static char *GetTextOp(NODE **root, char *targetKey, char *language) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nGet text error: root is null.\n");
+        return NULL;
+    }
+
+    // Image backed tree
+    if (ImageOf(root)) {
+        return ImageGetText(ImageOf(root), targetKey, language);
+    }
+
+    // Concurrent tree (lock free)
+    if (ConcurrentOf(root)) {
+        return ReadText(ConcurrentOf(root), *root, targetKey, language);
+    }
+
+    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nSet string error: allocating memory for search failed.\n");
+        return NULL;
+    }
+
+    Search(root, &result, language, targetNode);
+
+    // This is somewhat incomplete- I append language due to unique key values only
+    char *path = calloc (strlen(language) + strlen(targetKey) + 1, sizeof(char));
+    if (!path) {
+        fprintf(stderr, "\nSet string error: allocating memory for path failed.\n");
+        free (result);
+        return NULL;
+    }
+    strcat(path, language);
+    strcat(path, targetKey);
+
+    if (result->node) {
+        // Language found
+        Search(&result->node, &result, path, targetNode);
+        enum nodeType type = NodeType(result->node);
+
+        // If target language doesn't have the target, or no language found, search the EN node
+        if (type != stringNode) {
+            Search(root, &result, "en", targetNode);
+            Search(&result->node, &result, targetKey, targetNode);
+        }
+    }
+
+    char *value = (result->node && result->node->type == stringValue) ? (result->node->value.string) : (NULL);
+
+    free (path);
+    free (result);
+    return value;
+}
+
+// Get text (counted, see stats.h)
+char *GetText(NODE **root, char *targetKey, char *language) {
+    unsigned long started = StatBegin(statGet);
+    char *text = GetTextOp(root, targetKey, language);
+    StatEnd(statGet, started, !text);
+    return text;
+}
+
+/*
+ *  Loader:
+ *      The file is mapped into memory and scanned in place (no line buffers, no re-reads).
+ *      Keys of the previous line are kept as a cursor- lines sharing a path prefix skip resolving that prefix.
+ *      New children are appended to their parents, and each touched parent is sorted once when loading ends.
+ *      Since appended children are unsorted until then, a table of (parent, key) finds them while loading.
+ *
+ *      Files larger than LOADCHUNK are split at line breaks, one share per core. Each thread loads its share into a
+ *      tree of its own (own index and arena- nothing is shared). The trees are merged into the tree in file order
+ *      on the calling thread- every node is looked up as when loading (so keys found elsewhere in tree are merged
+ *      there), nodes not found are taken over as they are (no copying). Values are checked once when merged.
+ */
+
+// Key of previous line (cursor)
+typedef struct _LOADLEVEL {
+    const char      *key;               // Key in mapped file
+    size_t          length;             // Length of key
+    struct  _NODE   *node;              // Node resolved for key
+} LOADLEVEL;
+
+// Child lookup slot (node is parent itself when slot marks parent as touched)
+typedef struct _LOADSLOT {
+    unsigned long   hash;               // Hash of key mixed with parent
+    struct  _NODE   *parent;            // Parent of node
+    struct  _NODE   *node;              // Child (or parent, when marking)
+} LOADSLOT;
+
+// Loader state
+typedef struct _LOADER {
+    TREE            *tree;              // Tree being loaded
+    LOADSLOT        *slots;             // Child lookup (open addressing)
+    unsigned long   capacity,           // Slots (power of two)
+                    used;               // Slots in use
+    NODE            **touched;          // Parents given new children (sorted when done)
+    unsigned long   numTouched,
+                    capTouched;
+    char            *key;               // Scratch key (appended language keys)
+    size_t          capKey;
+    short int       sortedOut;          // Keys not marked NODESHARED are new to tree (merging shares)
+    FILE            *errors;            // Messages of bad lines  (NULL: stderr- shares keep theirs until merged)
+} LOADER;
+
+// Stream of loader messages
+#define LoadErrors(loader) (((loader)->errors) ? ((loader)->errors) : (stderr))
+
+// Share of file loaded by a thread (see DeserializeTextFile)
+typedef struct _LOADPART {
+    const   char    *begin,             // Lines of share
+                    *end;
+    unsigned long   lineNumber;         // Lines before share
+    TREE            tree;               // Tree of share          (own index and arena)
+    NODE            *root;              // Root of share          (stands for node loaded into)
+    LOADER          loader;
+    struct  _LOADPART *parts;           // Every share            (keys are sorted out across shares)
+    unsigned int    numParts,
+                    number;             // Number of share        (and of index slot range sorted out)
+    INDEX           *index;             // Index of tree loaded into
+    INDEXSLOT       *fresh;             // Keys new to tree       (home slot in range)
+    unsigned long   numFresh;
+    char            *messages;          // Messages of share      (printed in file order)
+    size_t          lengthMessages;
+    pthread_t       thread;
+    short int       iRc,
+                    unsorted;           // Keys weren't sorted out (allocating memory failed)
+} LOADPART;
+
+// Hash key under parent (parent pointer mixed into key hash)
+static unsigned long LoadHash(const NODE *parent, const char *key, const size_t length) {
+    unsigned long hash = HashKeyLength(key, length) ^ ((unsigned long) parent * 0x9E3779B97F4A7C15UL);
+    return hash ^ (hash >> 29);
+}
+
+// Put slot into loader table (grows at half load)
+static int LoadPut(LOADER *loader, NODE *parent, NODE *node, const unsigned long hash) {
+    unsigned long i, mask;
+
+    if ((loader->used + 1) * 2 > loader->capacity) {
+        unsigned long capacity = (loader->capacity) ? (loader->capacity * 2) : (INDEXSLOTS);
+        LOADSLOT *slots = calloc (capacity, sizeof(LOADSLOT)),
+                 *old = loader->slots;
+        if (!slots) {
+            return ERROR;
+        }
+
+        mask = capacity - 1;
+        for (i = 0; i < loader->capacity; ++i) {
+            if (old[i].parent) {
+                unsigned long z = old[i].hash & mask;
+                while (slots[z].parent) {
+                    z = (z + 1) & mask;
+                }
+                slots[z] = old[i];
+            }
+        }
+        free(old);
+        loader->slots = slots;
+        loader->capacity = capacity;
+    }
+
+    mask = loader->capacity - 1;
+    i = hash & mask;
+    while (loader->slots[i].parent) {
+        i = (i + 1) & mask;
+    }
+    loader->slots[i].hash = hash;
+    loader->slots[i].parent = parent;
+    loader->slots[i].node = node;
+    loader->used++;
+    return OK;
+}
+
+// Find slot in loader table (key NULL finds the touched mark of parent)
+static NODE *LoadGet(const LOADER *loader, const NODE *parent, const char *key, const size_t length,
+                     const unsigned long hash) {
+    if (!loader->capacity) {
+        return NULL;
+    }
+
+    unsigned long mask = loader->capacity - 1,
+                  i = hash & mask;
+
+    while (loader->slots[i].parent) {
+        LOADSLOT *slot = &loader->slots[i];
+        if (slot->hash == hash && slot->parent == parent) {
+            if (!key && slot->node == parent) {
+                return slot->node;
+            }
+            if (key && slot->node != parent && CompareKey(NodeKey(slot->node), key, length) == 0) {
+                return slot->node;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+// Mark parent as touched (existing children are put in table, since appends will unsort them)
+static int LoadTouch(LOADER *loader, NODE *parent) {
+    unsigned long hash = LoadHash(parent, NULL, 0);
+    unsigned int i;
+
+    if (LoadGet(loader, parent, NULL, 0, hash)) {
+        return OK;
+    }
+
+    if (loader->numTouched == loader->capTouched) {
+        unsigned long capacity = (loader->capTouched) ? (loader->capTouched * 2) : (MEMLIMIT);
+        NODE **touched = realloc (loader->touched, sizeof(NODE *) * capacity);
+        if (!touched) {
+            return ERROR;
+        }
+        loader->touched = touched;
+        loader->capTouched = capacity;
+    }
+    loader->touched[loader->numTouched++] = parent;
+
+    if (LoadPut(loader, parent, parent, hash) != OK) {
+        return ERROR;
+    }
+
+    // Without unique keys, children are found through the table only
+    for (i = 0; UNIQUEKEYS == FALSE && i < parent->numChildren; ++i) {
+        NODE *child = parent->children[i];
+        if (LoadPut(loader, parent, child, LoadHash(parent, NodeKey(child), strlen(NodeKey(child)))) != OK) {
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+// Find key under parent (unique keys are found anywhere in tree- key may live under another parent)
+static NODE *LoadFind(LOADER *loader, NODE *parent, const char *key, const size_t length) {
+    if (UNIQUEKEYS == TRUE) {
+        return IndexLookupLength(loader->tree->index, key, length);
+    }
+    if (LoadGet(loader, parent, NULL, 0, LoadHash(parent, NULL, 0))) {
+        return LoadGet(loader, parent, key, length, LoadHash(parent, key, length));
+    }
+    return FindChild(parent, key, length, NULL);
+}
+
+// Find or add key under parent (appended unsorted)
+static NODE *LoadChild(LOADER *loader, NODE *parent, const char *key, size_t length) {
+    NODE *child;
+
+    // Append language to keys below "no" (keys must be unique)
+    if (UNIQUEKEYS == TRUE && strcmp(NodeKey(parent), "no") == 0) {
+        if (loader->capKey < length + 3) {
+            char *buffer = realloc (loader->key, length + 3);
+            if (!buffer) {
+                return NULL;
+            }
+            loader->key = buffer;
+            loader->capKey = length + 3;
+        }
+        memcpy(loader->key, "no", 2);
+        memcpy(loader->key + 2, key, length);
+        key = loader->key;
+        length += 2;
+    }
+
+    if ((child = LoadFind(loader, parent, key, length))) {
+        return child;
+    }
+
+    // Add node (room in index is reserved first, so a node linked below is always indexed)
+    if (LoadTouch(loader, parent) != OK || ReserveChildren(parent, parent->numChildren + 1) != OK
+        || (loader->tree && loader->tree->index && TreeReserve(loader->tree, 1) != OK)
+        || !(child = CreateNode(loader->tree, key, length))) {
+        fprintf(LoadErrors(loader), "\nDeserialize text file error: adding key '%.*s' failed.", (int) length, key);
+        return NULL;
+    }
+
+    // Remove any values held by parent
+    ClearValue(loader->tree, parent);
+
+    NodeTags(parent)[parent->numChildren] = TagOf(child->hash);
+    parent->children[parent->numChildren++] = child;
+    child->up.parent = parent;
+
+    if (loader->tree && loader->tree->index) {
+        TreeIndex(loader->tree, child);
+    }
+    if (UNIQUEKEYS == FALSE) {
+        LoadPut(loader, parent, child, LoadHash(parent, key, length));
+    }
+    LogNode(loader->tree, walAdd, parent, NodeKey(child), 0);
+    return child;
+}
+
+// Set value of loaded node (same rules as SetString and SetInt- line 0 is a merged node)
+static void LoadValue(LOADER *loader, NODE *node, const char *string, const size_t length,
+                      const unsigned long integer, const unsigned long line) {
+    enum nodeType type = NodeType(node);
+
+    if (type == parentNode) {
+        if (line) {
+            fprintf(LoadErrors(loader), "\nDeserialize text file error: line %lu sets value of parent node.\n", line);
+        }
+        else {
+            fprintf(LoadErrors(loader),
+                    "\nDeserialize text file error: value of parent node '%s' is set.\n", NodeKey(node));
+        }
+    }
+    else if (string) {
+        if (type == stringNode || node->value.integer == 0) {
+            char *temp = NodeSetString(loader->tree, node, string, length);
+            if (temp) {
+                LogNode(loader->tree, walSetString, node, temp, 0);
+            }
+        }
+        else if (line) {
+            fprintf(LoadErrors(loader), "\nDeserialize text file error: line %lu sets string of integer node.\n", line);
+        }
+        else {
+            fprintf(LoadErrors(loader),
+                    "\nDeserialize text file error: string of integer node '%s' is set.\n", NodeKey(node));
+        }
+    }
+    else if (type == integerNode) {
+        __atomic_store_n(&node->value.integer, integer, __ATOMIC_RELAXED);
+        LogNode(loader->tree, walSetInt, node, NULL, integer);
+    }
+    else if (line) {
+        fprintf(LoadErrors(loader), "\nDeserialize text file error: line %lu sets integer of string node.\n", line);
+    }
+    else {
+        fprintf(LoadErrors(loader),
+                "\nDeserialize text file error: integer of string node '%s' is set.\n", NodeKey(node));
+    }
+}
+
+// Load lines into tree below root (numbered from lineNumber + 1- loading stops at first bad line)
+static int LoadLines(LOADER *loader, NODE *root, const char *cursor, const char *end, unsigned long lineNumber) {
+    LOADLEVEL *levels = NULL;
+    unsigned long numLevels = 0,
+                  capLevels = 0,
+                  level,
+                  integer;
+
+    const char *lineEnd,
+               *key,
+               *keyEnd,
+               *string;
+    size_t stringLength = 0;
+    short int iRc = OK;
+
+    // Scan line by line until end of file unless error occurs
+    while (iRc == OK && cursor < end) {
+        lineNumber++;
+        lineEnd = memchr(cursor, '\n', (size_t) (end - cursor));
+        if (!lineEnd) {
+            lineEnd = end;
+        }
+
+        // Skip leading white space and blank lines
+        while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+            cursor++;
+        }
+        if (cursor == lineEnd) {
+            cursor = lineEnd + 1;
+            continue;
+        }
+
+        // Full key path (until white space or equal sign)
+        key = cursor;
+        while (cursor < lineEnd && *cursor != ' ' && *cursor != '\t' && *cursor != '=') {
+            cursor++;
+        }
+        keyEnd = cursor;
+
+        // Value (string within quotes, otherwise integer)
+        while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t' || *cursor == '=')) {
+            cursor++;
+        }
+        string = NULL;
+        integer = 0;
+
+        if (cursor < lineEnd && *cursor == '"') {
+            string = ++cursor;
+            while (cursor < lineEnd && *cursor != '"') {
+                cursor++;
+            }
+            stringLength = (size_t) (cursor - string);
+        }
+        else if (cursor < lineEnd && *cursor >= '0' && *cursor <= '9') {
+            while (cursor < lineEnd && *cursor >= '0' && *cursor <= '9') {
+                integer = integer * 10 + (unsigned long) (*cursor++ - '0');
+            }
+        }
+        else {
+            fprintf(LoadErrors(loader), "Deserialize text file error: "
+                    "extracting values failed for line %li: '%.*s'.", lineNumber, (int) (lineEnd - key), key);
+            iRc = ERROR;
+            break;
+        }
+
+        // Resolve keys of path, starting where path differs from previous line
+        NODE *node = root;
+        short int matching = TRUE;
+        level = 0;
+        while (key < keyEnd) {
+            const char *dot = memchr(key, '.', (size_t) (keyEnd - key));
+            size_t length = (dot) ? ((size_t) (dot - key)) : ((size_t) (keyEnd - key));
+
+            matching = matching && level < numLevels && levels[level].length == length
+                       && memcmp(levels[level].key, key, length) == 0;
+            if (matching) {
+                node = levels[level].node;
+            }
+            else {
+                if (!(node = LoadChild(loader, node, key, length))) {
+                    iRc = ERROR;
+                    break;
+                }
+
+                // Remember key (previous line's keys below are no longer valid)
+                if (level >= capLevels) {
+                    unsigned long capacity = (capLevels) ? (capLevels * 2) : (MEMLIMIT);
+                    LOADLEVEL *temp = realloc (levels, sizeof(LOADLEVEL) * capacity);
+                    if (!temp) {
+                        iRc = ERROR;
+                        break;
+                    }
+                    levels = temp;
+                    capLevels = capacity;
+                }
+                levels[level].key = key;
+                levels[level].length = length;
+                levels[level].node = node;
+                numLevels = level + 1;
+            }
+            level++;
+            key += length + ((dot) ? (1) : (0));
+        }
+
+        // Set value of last node
+        if (iRc == OK && level) {
+            LoadValue(loader, node, string, stringLength, integer, lineNumber);
+        }
+        cursor = lineEnd + 1;
+    }
+
+    free(levels);
+    return iRc;
+}
+
+// Sort children of touched parents once (loading is done) and free loader state
+static void LoadFinish(LOADER *loader) {
+    unsigned long i;
+
+    for (i = 0; i < loader->numTouched; ++i) {
+        NODE *parent = loader->touched[i];
+        unsigned int z;
+
+        qsort(parent->children, parent->numChildren, sizeof(NODE *), CompareNodes);
+        for (z = 0; z < parent->numChildren; ++z) {
+            NodeTags(parent)[z] = TagOf(parent->children[z]->hash);
+        }
+    }
+    free(loader->slots);
+    free(loader->touched);
+    free(loader->key);
+}
+
+// Count lines of share (thread)
+static void *LoadCount(void *argument) {
+    LOADPART *part = argument;
+    const char *cursor = part->begin;
+
+    part->lineNumber = 0;
+    while (cursor < part->end && (cursor = memchr(cursor, '\n', (size_t) (part->end - cursor)))) {
+        part->lineNumber++;
+        cursor++;
+    }
+    return NULL;
+}
+
+// Load share into tree of share (thread)
+static void *LoadShare(void *argument) {
+    LOADPART *part = argument;
+
+    part->iRc = LoadLines(&part->loader, part->root, part->begin, part->end, part->lineNumber);
+    LoadFinish(&part->loader);
+    return NULL;
+}
+
+// Run function on every share (on threads- on calling thread if a thread can't be started)
+static void LoadRun(LOADPART *parts, const unsigned int numParts, void *(*function)(void *)) {
+    unsigned int i;
+    short int *started = calloc (numParts, sizeof(short int));
+
+    for (i = 0; i < numParts; ++i) {
+        if (!started || pthread_create(&parts[i].thread, NULL, function, &parts[i]) != 0) {
+            function(&parts[i]);
+        }
+        else {
+            started[i] = TRUE;
+        }
+    }
+    for (i = 0; i < numParts; ++i) {
+        if (started && started[i]) {
+            pthread_join(parts[i].thread, NULL);
+        }
+    }
+    free(started);
+}
+
+// Slot range of index sorted out by share (end of last range wraps to 0)
+#define LoadRange(part, n) ((((part)->index->capacity / (part)->numParts) * (n) + \
+                             (((n) == (part)->numParts) ? ((part)->index->capacity % (part)->numParts) : (0))) \
+                            & ((part)->index->capacity - 1))
+
+// Mark keys of shares found in tree or an earlier share (thread- keys with home slot in range of share, keys left
+// unmarked are new to tree when merged, so merging them looks nothing up)
+static void *LoadSortOut(void *argument) {
+    LOADPART *part = argument;
+    unsigned long capacity = INDEXSLOTS,
+                  count = 0,
+                  mask = part->index->capacity - 1,
+                  begin = LoadRange(part, part->number),
+                  end = LoadRange(part, part->number + 1),
+                  i,
+                  z;
+    unsigned int j;
+
+    for (j = 0; j < part->numParts; ++j) {
+        count += (part->parts[j].tree.index) ? (part->parts[j].tree.index->used) : (0);
+    }
+    while (capacity < 2 * count / part->numParts + 1) {
+        capacity <<= 1;
+    }
+
+    // First share holding each key (hash and node)
+    INDEXSLOT *seen = calloc (capacity, sizeof(INDEXSLOT));
+    if (!seen) {
+        part->unsorted = TRUE;
+        return NULL;
+    }
+    count = 0;
+
+    for (j = 0; j < part->numParts; ++j) {
+        const INDEX *index = part->parts[j].tree.index;
+
+        for (i = 0; index && i < index->capacity; ++i) {
+            const INDEXSLOT *slot = &index->slots[i];
+            NODE *node = slot->node;
+            unsigned long home = slot->hash & mask;
+
+            if (!node || node == TOMBSTONE || node == part->parts[j].root
+                || ((end > begin) ? (home < begin || home >= end) : (home < begin && home >= end))) {
+                continue;
+            }
+
+            // Grow at half load (ranges are about even, but not exactly)
+            if ((count + 1) * 2 > capacity) {
+                INDEXSLOT *grown = calloc (capacity * 2, sizeof(INDEXSLOT));
+                if (!grown) {
+                    free(seen);
+                    part->unsorted = TRUE;
+                    return NULL;
+                }
+                for (z = 0; z < capacity; ++z) {
+                    if (seen[z].node) {
+                        unsigned long y = seen[z].hash & (capacity * 2 - 1);
+                        while (grown[y].node) {
+                            y = (y + 1) & (capacity * 2 - 1);
+                        }
+                        grown[y] = seen[z];
+                    }
+                }
+                free(seen);
+                seen = grown;
+                capacity *= 2;
+            }
+
+            for (z = slot->hash & (capacity - 1); seen[z].node; z = (z + 1) & (capacity - 1)) {
+                if (seen[z].hash == slot->hash && strcmp(NodeKey(seen[z].node), NodeKey(node)) == 0) {
+                    break;
+                }
+            }
+            if (seen[z].node || IndexLookup(part->index, NodeKey(node))) {
+                node->flags |= NODESHARED;
+            }
+            else {
+                seen[z] = *slot;
+                count++;
+            }
+        }
+    }
+
+    // Keys new to tree (first share holding them- indexed by LoadIndexOut)
+    part->fresh = seen;
+    part->numFresh = capacity;
+    return NULL;
+}
+
+// Index keys new to tree (thread- into slot range of share, so threads never touch the same slots)
+static void *LoadIndexOut(void *argument) {
+    LOADPART *part = argument;
+    unsigned long end = LoadRange(part, part->number + 1),
+                  spilled = 0,
+                  i;
+
+    // Keys probing past range are placed by calling thread (kept at front of table)
+    for (i = 0; i < part->numFresh; ++i) {
+        INDEXSLOT slot = part->fresh[i];
+        part->fresh[i].node = NULL;
+        if (slot.node && IndexPlaceRange(part->index, slot.node, slot.hash, end) != OK) {
+            part->fresh[spilled++] = slot;
+        }
+    }
+    part->numFresh = spilled;
+    return NULL;
+}
+
+static int LoadMerge(LOADER *loader, TREE *share, NODE *parent, NODE *local, short int own);
+
+// Move strings of node taken over into pool of tree (copies of share go as tree memory- node is left as is on failure)
+static int LoadIntern(TREE *tree, NODE *local) {
+    char *key = (local->flags & NODEHEAPKEY) ? (local->name.heap) : (NULL),
+         *string = (local->type == stringValue) ? (local->value.string) : (NULL),
+         *pooledKey = (key) ? (InternString(tree->intern, key, strlen(key))) : (NULL),
+         *pooledString = (string) ? (InternString(tree->intern, string, strlen(string))) : (NULL);
+
+    if ((key && !pooledKey) || (string && !pooledString)) {
+        if (pooledKey) {
+            TreeFreeString(tree, pooledKey);
+        }
+        if (pooledString) {
+            TreeFreeString(tree, pooledString);
+        }
+        return ERROR;
+    }
+
+    if (key) {
+        local->name.heap = pooledKey;
+        TreeFree(tree, key, strlen(key) + 1);
+    }
+    if (string) {
+        local->value.string = pooledString;
+        TreeFree(tree, string, strlen(string) + 1);
+    }
+    return OK;
+}
+
+// Merge children of node of share into node of tree (node may be the node of share itself, once taken over)
+static int LoadMergeChildren(LOADER *loader, TREE *share, NODE *node, NODE *local) {
+    NODE **children = local->children;
+    unsigned int i,
+                 numChildren = local->numChildren,
+                 capChildren = local->capChildren;
+    short int iRc = OK;
+
+    local->children = NULL;
+    local->numChildren = 0;
+    local->capChildren = 0;
+
+    // Node taken over gets its own children back (in sorted order- unless found elsewhere in tree)
+    if (node == local && numChildren && ReserveChildren(node, numChildren) != OK) {
+        iRc = ERROR;
+    }
+
+    for (i = 0; i < numChildren; ++i) {
+        if (iRc == OK) {
+            iRc = LoadMerge(loader, share, node, children[i], (node == local) ? (TRUE) : (FALSE));
+        }
+        else {
+            TraverseNodes(children[i], FreeVisitor, share, postOrder);
+        }
+    }
+    TreeFree(share, children, ChildrenSize(capChildren));
+    return iRc;
+}
+
+// Merge node of share into tree below parent (taken over as is if key isn't found, else merged into node found)
+static int LoadMerge(LOADER *loader, TREE *share, NODE *parent, NODE *local, const short int own) {
+    const char *key = NodeKey(local);
+    size_t length = strlen(key);
+    // Keys new to tree are indexed already (see LoadSortOut)
+    short int indexed = (loader->sortedOut && !(local->flags & NODESHARED)) ? (TRUE) : (FALSE);
+    NODE *node = (indexed) ? (NULL) : (LoadFind(loader, parent, key, length));
+
+    __atomic_and_fetch(&local->flags, (unsigned char) ~NODESHARED, __ATOMIC_RELAXED);
+    if (!node) {
+        // Own children of node taken over are appended in order (parent stays sorted unless touched otherwise)
+        if ((!own && LoadTouch(loader, parent) != OK) || ReserveChildren(parent, parent->numChildren + 1) != OK
+            || (loader->tree->index && !indexed && TreeReserve(loader->tree, 1) != OK)
+            || (loader->tree->intern && LoadIntern(loader->tree, local) != OK)) {
+            fprintf(stderr, "\nDeserialize text file error: adding key '%s' failed.", key);
+            TraverseNodes(local, FreeVisitor, share, postOrder);
+            return ERROR;
+        }
+
+        // Remove any values held by parent
+        ClearValue(loader->tree, parent);
+
+        NodeTags(parent)[parent->numChildren] = TagOf(local->hash);
+        parent->children[parent->numChildren++] = local;
+        local->up.parent = parent;
+
+        if (loader->tree->index && !indexed) {
+            TreeIndex(loader->tree, local);
+        }
+        if (UNIQUEKEYS == FALSE) {
+            LoadPut(loader, parent, local, LoadHash(parent, key, length));
+        }
+        LogNode(loader->tree, walAdd, parent, key, 0);
+        if (local->numChildren == 0) {
+            if (local->type == stringValue) {
+                LogNode(loader->tree, walSetString, local, local->value.string, 0);
+            }
+            else {
+                LogNode(loader->tree, walSetInt, local, NULL, local->value.integer);
+            }
+        }
+        node = local;
+    }
+    else if (local->numChildren == 0) {
+        const char *string = (local->type == stringValue) ? (local->value.string) : (NULL);
+        LoadValue(loader, node, string, (string) ? (strlen(string)) : (0), (string) ? (0) : (local->value.integer), 0);
+    }
+
+    short int iRc = LoadMergeChildren(loader, share, node, local);
+    if (node != local) {
+        FreeNode(share, local);
+    }
+    return iRc;
+}
+
+// Load file on several threads (each share into a tree of its own, merged into tree in file order)
+static int LoadParallel(NODE **root, const char *data, const size_t size, const unsigned int numParts) {
+    TREE *tree = TreeOf(*root);
+    LOADPART *parts = calloc (numParts, sizeof(LOADPART));
+    unsigned int i;
+
+    if (!parts) {
+        fprintf(stderr, "\nDeserialize text file error: allocating memory failed!\n");
+        return ERROR;
+    }
+
+    // Split at line breaks
+    for (i = 0; i < numParts; ++i) {
+        const char *split = data + (size / numParts) * (i + 1),
+                   *lineEnd;
+        parts[i].begin = (i) ? (parts[i - 1].end) : (data);
+        if (i == numParts - 1 || split < parts[i].begin) {
+            split = (i == numParts - 1) ? (data + size) : (parts[i].begin);
+        }
+        lineEnd = (split < data + size) ? (memchr(split, '\n', (size_t) (data + size - split))) : (NULL);
+        parts[i].end = (lineEnd) ? (lineEnd + 1) : (data + size);
+    }
+
+    // Number lines (line numbers of errors)
+    LoadRun(parts, numParts, LoadCount);
+    unsigned long lineNumber = 0;
+    for (i = 0; i < numParts; ++i) {
+        unsigned long lines = parts[i].lineNumber;
+        parts[i].lineNumber = lineNumber;
+        lineNumber += lines;
+    }
+
+    // Trees of shares (root of share is indexed, so the leading root key of paths is found)
+    for (i = 0; i < numParts; ++i) {
+        LOADPART *part = &parts[i];
+        part->tree.index = (UNIQUEKEYS == TRUE) ? (IndexCreate(INDEXSLOTS)) : (NULL);
+        part->tree.arena = (tree->arena) ? (ArenaCreate()) : (NULL);
+        part->loader.tree = &part->tree;
+        part->root = ((UNIQUEKEYS == FALSE || part->tree.index) && (!tree->arena || part->tree.arena)) ?
+                     (CreateNode(&part->tree, NodeKey(*root), strlen(NodeKey(*root)))) : (NULL);
+        if (part->root) {
+            part->root->flags |= NODEROOT;
+            part->root->up.tree = &part->tree;
+        }
+        part->loader.errors = open_memstream(&part->messages, &part->lengthMessages);
+        if (!part->root || (part->tree.index && TreeIndex(&part->tree, part->root) != OK)) {
+            fprintf(stderr, "\nDeserialize text file error: allocating memory failed!\n");
+            part->begin = part->end;
+            part->iRc = ERROR;
+        }
+    }
+    LoadRun(parts, numParts, LoadShare);
+
+    // Sort out keys new to tree and index them in parallel (unique keys only- others are found through parents)
+    LOADER loader = { .tree = tree, .sortedOut = (UNIQUEKEYS == TRUE && tree->index) ? (TRUE) : (FALSE) };
+    if (loader.sortedOut) {
+        unsigned long count = 0;
+        for (i = 0; i < numParts; ++i) {
+            count += (parts[i].tree.index) ? (parts[i].tree.index->used) : (0);
+        }
+        loader.sortedOut = (TreeReserve(tree, count) == OK && tree->index->capacity >= numParts * INDEXSLOTS) ?
+                           (TRUE) : (FALSE);
+    }
+    if (loader.sortedOut) {
+        for (i = 0; i < numParts; ++i) {
+            parts[i].parts = parts;
+            parts[i].numParts = numParts;
+            parts[i].number = i;
+            parts[i].index = tree->index;
+        }
+        LoadRun(parts, numParts, LoadSortOut);
+        for (i = 0; i < numParts; ++i) {
+            loader.sortedOut = (parts[i].unsorted) ? (FALSE) : (loader.sortedOut);
+        }
+    }
+    if (loader.sortedOut) {
+        LoadRun(parts, numParts, LoadIndexOut);
+        for (i = 0; i < numParts; ++i) {
+            unsigned long z;
+            for (z = 0; z < parts[i].numFresh; ++z) {
+                IndexPlaceRange(tree->index, parts[i].fresh[z].node, parts[i].fresh[z].hash,
+                                parts[i].fresh[z].hash & (tree->index->capacity - 1));
+            }
+        }
+    }
+    for (i = 0; i < numParts; ++i) {
+        free(parts[i].fresh);
+    }
+
+    // Merge in file order (stops after first share failing- loading stops at first bad line)
+    short int iRc = OK;
+    for (i = 0; i < numParts; ++i) {
+        LOADPART *part = &parts[i];
+
+        // Nodes go to tree- memory of share is freed as tree memory from here (and unindexed, if indexed already)
+        IndexDestroy(part->tree.index);
+        part->tree.index = (loader.sortedOut) ? (tree->index) : (NULL);
+        if (part->tree.arena) {
+            ArenaAdopt(tree->arena, part->tree.arena);
+            part->tree.arena = tree->arena;
+        }
+
+        // Messages of shares not merged are dropped (they follow the first bad line)
+        if (part->loader.errors) {
+            fclose(part->loader.errors);
+            if (iRc == OK && part->messages) {
+                fputs(part->messages, stderr);
+            }
+            free(part->messages);
+        }
+
+        if (part->root && iRc == OK) {
+            NODE *local = part->root;
+            if (local->numChildren == 0 && (local->type == stringValue || local->value.integer)) {
+                const char *string = (local->type == stringValue) ? (local->value.string) : (NULL);
+                LoadValue(&loader, *root, string, (string) ? (strlen(string)) : (0), local->value.integer, 0);
+            }
+            iRc = LoadMergeChildren(&loader, &part->tree, *root, local);
+            FreeNode(&part->tree, local);
+        }
+        else if (part->root) {
+            TraverseNodes(part->root, FreeVisitor, &part->tree, postOrder);
+        }
+        if (part->iRc != OK) {
+            iRc = ERROR;
+        }
+    }
+    LoadFinish(&loader);
+
+    free(parts);
+    return iRc;
+}
+
+// Visitor adding paths of nodes to radix tree (preOrder- root has no path)
+static enum visitResult PathVisitor(NODE *node, const unsigned long depth, void *context) {
+    return (depth && TreePath(context, node) != OK) ? (visitStop) : (visitContinue);
+}
+
+// Deserialize database from text file (mapped and scanned in place)
+int DeserializeTextFile(NODE **root, const char *fileName) {
+    // Notice: this deserialization assumes no quotes '"', white spaces or equal signs '=' are used in keys
+    // General format should be: path.key = integer OR path.key = "string"
+
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nDeserialize text file error: root is null.\n");
+        return ERROR;
+    }
+
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nDeserialize text file error: tree is read-only.\n");
+        return ERROR;
+    }
+
+    int file = open(fileName, O_RDONLY);
+    struct stat status;
+
+    if (file < 0 || fstat(file, &status) != 0) {
+        fprintf(stderr, "Deserialize text file error: problem reading file.");
+        if (file >= 0) {
+            close(file);
+        }
+        return ERROR;
+    }
+
+    // Nothing to load
+    if (status.st_size == 0) {
+        close(file);
+        return OK;
+    }
+
+    const char *data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Deserialize text file error: problem mapping file.");
+        return ERROR;
+    }
+    madvise((void *) data, (size_t) status.st_size, MADV_SEQUENTIAL);
+
+    // Large files are split across cores
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long numParts = (unsigned long) status.st_size / LOADCHUNK;
+    if (cores > 0 && numParts > (unsigned long) cores) {
+        numParts = (unsigned long) cores;
+    }
+
+    TREE *writer = WriteBegin(root);
+    short int iRc;
+    if (numParts > 1) {
+        iRc = LoadParallel(root, data, (size_t) status.st_size, (unsigned int) numParts);
+    }
+    else {
+        LOADER loader = { .tree = TreeOf(*root) };
+        iRc = LoadLines(&loader, *root, data, data + status.st_size, 0);
+        LoadFinish(&loader);
+    }
+
+    // Nodes loaded are not added one by one- paths are added afterwards
+    TREE *tree = TreeOf(*root);
+    if (tree && tree->art) {
+        TraverseNodes(tree->root, PathVisitor, tree, preOrder);
+    }
+    WriteEnd(writer);
+
+    munmap((void *) data, (size_t) status.st_size);
+    return iRc;
+}
+
+/*
+ *  Serializer:
+ *      Lines are formatted into one large buffer, which is handed to write() whenever it fills up.
+ *      Paths are rebuilt from a stack of keys during a single depth first traversal (no parent walks per line).
+ */
+
+// Serializer output
+typedef struct _WRITER {
+    int             file;               // File being written
+    char            *temporary;         // Name of file being written (renamed once closed)
+    char            *buffer;            // Output buffer (SERIALBUFFER bytes)
+    size_t          used;               // Bytes in buffer
+    short int       iRc;                // ERROR once writing fails
+} WRITER;
+
+// Hand buffer to file
+static void WriterFlush(WRITER *writer) {
+    const char *cursor = writer->buffer;
+
+    while (writer->iRc == OK && writer->used) {
+        ssize_t written = write(writer->file, cursor, writer->used);
+        if (written <= 0) {
+            writer->iRc = ERROR;
+            break;
+        }
+        cursor += written;
+        writer->used -= (size_t) written;
+    }
+    writer->used = 0;
+}
+
+// Append bytes to buffer (flushed when full)
+static void WriterPut(WRITER *writer, const char *data, size_t length) {
+    while (length) {
+        size_t part = SERIALBUFFER - writer->used;
+        if (part > length) {
+            part = length;
+        }
+        memcpy(writer->buffer + writer->used, data, part);
+        writer->used += part;
+        data += part;
+        length -= part;
+
+        if (writer->used == SERIALBUFFER) {
+            WriterFlush(writer);
+        }
+    }
+}
+
+// Open writer on temporary file next to file (see WriterClose)
+static int WriterOpen(WRITER *writer, const char *fileName) {
+    *writer = (WRITER) { .file = -1, .iRc = OK, .temporary = malloc (strlen(fileName) + 5),
+                         .buffer = malloc (SERIALBUFFER) };
+    if (writer->temporary && writer->buffer) {
+        sprintf(writer->temporary, "%s.tmp", fileName);
+        writer->file = open(writer->temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if (writer->file < 0) {
+        free(writer->temporary);
+        free(writer->buffer);
+        return ERROR;
+    }
+    return OK;
+}
+
+// Close writer (written file replaces file, synced first if asked- nothing is replaced if writing failed)
+static int WriterClose(WRITER *writer, const char *fileName, const short int sync) {
+    WriterFlush(writer);
+
+    short int iRc = writer->iRc;
+    if (iRc == OK && sync && fsync(writer->file) != 0) {
+        iRc = ERROR;
+    }
+    if (close(writer->file) != 0 || iRc != OK || rename(writer->temporary, fileName) != 0) {
+        unlink(writer->temporary);
+        iRc = ERROR;
+    }
+
+    free(writer->temporary);
+    free(writer->buffer);
+    return iRc;
+}
+
+// Append line of value holding node (path.key = integer OR path.key = "string")
+static void WriterLine(WRITER *writer, const char *path, const size_t pathLength,
+                       const char *string, const unsigned long integer) {
+    char digits[24],
+         *digit = digits + sizeof(digits);
+    unsigned long rest = integer;
+
+    WriterPut(writer, path, pathLength);
+    if (string) {
+        WriterPut(writer, " = \"", 4);
+        WriterPut(writer, string, strlen(string));
+        WriterPut(writer, "\"\n", 2);
+    }
+    else {
+        do {
+            *--digit = (char) ('0' + rest % 10);
+            rest /= 10;
+        } while (rest);
+        WriterPut(writer, " = ", 3);
+        WriterPut(writer, digit, (size_t) (digits + sizeof(digits) - digit));
+        WriterPut(writer, "\n", 1);
+    }
+}
+
+// Append key to path (keys below "no" have language removed, as DeserializeTextFile appends it)
+static int PathPush(char **path, size_t *capPath, size_t *pathLength, const char *parentKey, const char *key) {
+    size_t length = strlen(key);
+
+    if (UNIQUEKEYS == TRUE && strcmp(parentKey, "no") == 0 && strncmp(key, "no", 2) == 0 && key[2] != '\0') {
+        key += 2;
+        length -= 2;
+    }
+
+    if (*pathLength + length + 2 > *capPath) {
+        size_t capacity = (*capPath) ? (*capPath * 2) : (256);
+        while (*pathLength + length + 2 > capacity) {
+            capacity *= 2;
+        }
+        char *temp = realloc (*path, capacity);
+        if (!temp) {
+            return ERROR;
+        }
+        *path = temp;
+        *capPath = capacity;
+    }
+
+    if (*pathLength) {
+        (*path)[(*pathLength)++] = '.';
+    }
+    memcpy(*path + *pathLength, key, length);
+    *pathLength += length;
+    return OK;
+}
+
+// Serialize nodes below root (children in sorted order, so output is sorted by path)
+static int SerializeNodes(WRITER *writer, NODE *root) {
+    // Stack of nodes on path, with next child to visit
+    typedef struct { NODE *node; unsigned int next; size_t pathLength; } FRAME;
+    FRAME *stack = malloc (sizeof(FRAME) * MEMLIMIT);
+    unsigned long depth = 0,
+                  capStack = MEMLIMIT;
+    char *path = NULL;
+    size_t capPath = 0,
+           pathLength = 0;
+
+    if (!stack) {
+        return ERROR;
+    }
+    stack[0] = (FRAME) { root, 0, 0 };
+
+    while (writer->iRc == OK) {
+        FRAME *frame = &stack[depth];
+
+        // Done with node- back to parent
+        if (frame->next == frame->node->numChildren) {
+            if (depth == 0) {
+                break;
+            }
+            depth--;
+            pathLength = stack[depth].pathLength;
+            continue;
+        }
+
+        NODE *child = frame->node->children[frame->next++];
+        if (PathPush(&path, &capPath, &pathLength, NodeKey(frame->node), NodeKey(child)) != OK) {
+            writer->iRc = ERROR;
+            break;
+        }
+
+        if (child->numChildren == 0) {
+            DATA data;
+            NodeData(child, &data);
+            WriterLine(writer, path, pathLength, data.string, data.integer);
+            pathLength = frame->pathLength;
+            continue;
+        }
+
+        // Descend
+        if (depth + 1 == capStack) {
+            FRAME *temp = realloc (stack, sizeof(FRAME) * capStack * 2);
+            if (!temp) {
+                writer->iRc = ERROR;
+                break;
+            }
+            stack = temp;
+            capStack *= 2;
+        }
+        stack[++depth] = (FRAME) { child, 0, pathLength };
+    }
+
+    free(stack);
+    free(path);
+    return writer->iRc;
+}
 
-                        // Remove any values held by parent
-                        result->node->value.integer = 0;
-                        if (result->node->value.string != NULL) {
-                            free(result->node->value.string);
-                            result->node->value.string = NULL;
-                        }
+// Serialize image nodes below root (same output as SerializeNodes- children ranges are sorted)
+static int SerializeImage(WRITER *writer, const IMAGE *image) {
+    typedef struct { long node; uint32_t next; size_t pathLength; } FRAME;
+    FRAME *stack = malloc (sizeof(FRAME) * MEMLIMIT);
+    unsigned long depth = 0,
+                  capStack = MEMLIMIT;
+    char *path = NULL;
+    size_t capPath = 0,
+           pathLength = 0;
 
-                        // Re-allocate memory to match number of children
-                        result->node->children = ReallocHandling(result->node->children,
-                                                                 sizeof(NODE *) * (result->node->numChildren + 1));
+    if (!stack) {
+        return ERROR;
+    }
+    stack[0] = (FRAME) { 0, 0, 0 };
 
-                        if (result->node->children != NULL) {
-                            // Increment number of children
-                            result->node->numChildren++;
+    while (writer->iRc == OK) {
+        FRAME *frame = &stack[depth];
+        const IMAGENODE *node = &image->nodes[frame->node];
 
-                            // Add child to parents children
-                            result->node->children[result->node->numChildren - 1] = newNode;
+        if (frame->next == node->numChildren) {
+            if (depth == 0) {
+                break;
+            }
+            depth--;
+            pathLength = stack[depth].pathLength;
+            continue;
+        }
 
-                            // Sort children's keys
-                            BubbleSort(&result->node, result->node->numChildren);
+        long child = (long) (node->firstChild + frame->next++);
+        if (PathPush(&path, &capPath, &pathLength, image->pool + node->key, image->pool + image->nodes[child].key) != OK) {
+            writer->iRc = ERROR;
+            break;
+        }
 
-                            iRc = OK;
-                        }
-                        else {
-                            strcpy(error, "allocating memory for children failed!");
-                        }
-                    }
-                }
+        if (image->nodes[child].numChildren == 0) {
+            WriterLine(writer, path, pathLength,
+                       (image->nodes[child].string != IMAGENONE) ? (image->pool + image->nodes[child].string) : (NULL),
+                       image->nodes[child].integer);
+            pathLength = frame->pathLength;
+            continue;
+        }
+
+        if (depth + 1 == capStack) {
+            FRAME *temp = realloc (stack, sizeof(FRAME) * capStack * 2);
+            if (!temp) {
+                writer->iRc = ERROR;
+                break;
             }
-            free(result);
+            stack = temp;
+            capStack *= 2;
         }
+        stack[++depth] = (FRAME) { child, 0, pathLength };
     }
-    if (iRc != OK) {
-        fprintf(stderr, "\nAdd node '%s' error: %s", key, error);
-    }
-    return iRc;
+
+    free(stack);
+    free(path);
+    return writer->iRc;
 }
 
-// Get node type by node
-enum nodeType NodeType(NODE *node) {
-    enum nodeType type;
+// Take bytes of log record (usage is WalPutRecord)
+static void WriterRecord(void *context, const char *data, size_t length) {
+    WriterPut(context, data, length);
+}
 
-    if (!node) {
-        fprintf(stderr, "\nGet type error: node is null.\n");
-        type = noSuchNode;
+// Append records of version node (added below parent, then given its value- no add record for root)
+static void SnapshotNode(WRITER *writer, const char *path, const size_t parentLength, const size_t pathLength,
+                         const VNODE *node) {
+    if (parentLength < pathLength) {
+        WalPutRecord(WriterRecord, writer, walAdd, path, parentLength, node->key, strlen(node->key), 0);
     }
 
-    else if (node->numChildren != 0) {
-        type = parentNode;
+    if (node->data.string) {
+        WalPutRecord(WriterRecord, writer, walSetString, path, pathLength, node->data.string,
+                     strlen(node->data.string), 0);
+    }
+    else if (node->data.integer) {
+        WalPutRecord(WriterRecord, writer, walSetInt, path, pathLength, NULL, 0, node->data.integer);
     }
+}
 
-    else if (node->value.string) {
-        type = stringNode;
+// Append records of version nodes below root (parents first- keys and strings are length prefixed, so any of them
+// reads back)
+static int SnapshotNodes(WRITER *writer, const VNODE *root) {
+    typedef struct { const VNODE *node; unsigned int next; size_t pathLength; } FRAME;
+    FRAME *stack = malloc (sizeof(FRAME) * MEMLIMIT);
+    unsigned long depth = 0,
+                  capStack = MEMLIMIT;
+    size_t rootLength = strlen(root->key),
+           capPath = rootLength + 256,
+           pathLength = rootLength;
+    char *path = malloc (capPath);
+
+    if (!stack || !path) {
+        free(stack);
+        free(path);
+        return ERROR;
     }
+    memcpy(path, root->key, rootLength);
+    stack[0] = (FRAME) { root, 0, rootLength };
+    SnapshotNode(writer, path, rootLength, rootLength, root);
 
-    else {
-        type = integerNode;
+    while (writer->iRc == OK) {
+        FRAME *frame = &stack[depth];
+
+        // Done with node- back to parent
+        if (frame->next == frame->node->numChildren) {
+            if (depth == 0) {
+                break;
+            }
+            depth--;
+            continue;
+        }
+
+        // Records hold raw keys (no language handling, as replay adds through AddNode)
+        const VNODE *child = frame->node->children[frame->next++];
+        size_t keyLength = strlen(child->key);
+        pathLength = frame->pathLength + 1 + keyLength;
+        if (pathLength > capPath) {
+            size_t capacity = capPath * 2;
+            while (pathLength > capacity) {
+                capacity *= 2;
+            }
+            char *temp = realloc (path, capacity);
+            if (!temp) {
+                writer->iRc = ERROR;
+                break;
+            }
+            path = temp;
+            capPath = capacity;
+        }
+        path[frame->pathLength] = '.';
+        memcpy(path + frame->pathLength + 1, child->key, keyLength);
+        SnapshotNode(writer, path, frame->pathLength, pathLength, child);
+
+        if (child->numChildren == 0) {
+            continue;
+        }
+
+        // Descend
+        if (depth + 1 == capStack) {
+            FRAME *temp = realloc (stack, sizeof(FRAME) * capStack * 2);
+            if (!temp) {
+                writer->iRc = ERROR;
+                break;
+            }
+            stack = temp;
+            capStack *= 2;
+        }
+        stack[++depth] = (FRAME) { child, 0, pathLength };
     }
 
-    return type;
+    free(stack);
+    free(path);
+    return writer->iRc;
 }
 
-// Get node type by key
-enum nodeType GetType(NODE **root, char *targetKey) {
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nGet type error: root is null.\n");
-        return errorUndefinedNode;
-    }
+// Write snapshot of version as log records, then release it (runs on checkpointer thread- version is immutable, so no
+// locks are taken, file is synced)
+static int LogSnapshot(void *context, const char *fileName) {
+    VERSION *version = context;
+    WRITER writer;
+    short int iRc = ERROR;
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nGet type error: allocating memory for search failed.\n");
-        return errorUndefinedNode;
+    if (WriterOpen(&writer, fileName) != OK) {
+        fprintf(stderr, "\nCheckpoint log error: problem creating snapshot '%s'.\n", fileName);
+    }
+    else {
+        SnapshotNodes(&writer, version->root);
+        iRc = WriterClose(&writer, fileName, TRUE);
+        if (iRc != OK) {
+            fprintf(stderr, "\nCheckpoint log error: problem writing snapshot '%s'.\n", fileName);
+        }
     }
 
-    Search(root, &result, targetKey, targetNode);
-    enum nodeType type = noSuchNode;
+    VersionRelease(version);
+    return iRc;
+}
 
-    if (!result->node) {
-        fprintf(stderr, "\nGet type error: no such key in tree.\n");
+// Write tree to text file
+static int SerializeText(NODE **root, const char *fileName) {
+    WRITER writer;
+
+    if (WriterOpen(&writer, fileName) != OK) {
+        fprintf(stderr, "\nSerialize text file error: problem creating file '%s'.\n", fileName);
+        return ERROR;
+    }
+
+    if (ImageOf(root)) {
+        SerializeImage(&writer, ImageOf(root));
     }
     else {
-        type = NodeType(result->node);
+        TREE *locked = LockTree(root);
+        SerializeNodes(&writer, *root);
+        UnlockTree(locked);
     }
-    free (result);
-    return type;
+
+    if (WriterClose(&writer, fileName, FALSE) != OK) {
+        fprintf(stderr, "\nSerialize text file error: problem writing file '%s'.\n", fileName);
+        return ERROR;
+    }
+    return OK;
 }
 
-// Set node integer
-int SetInt(NODE **root, char *targetKey, const unsigned long valueInteger) {
+// Serialize database to text file (format read by DeserializeTextFile, replaces file when complete)
+int SerializeTextFile(NODE **root, const char *fileName) {
+    // Notice: strings are written as is- strings holding quotes '"' or line breaks can't be read back
+
     // If no root
-    if (!root) {
-        fprintf(stderr, "\nSet int error: root is null.\n");
+    if (!root || !*root) {
+        fprintf(stderr, "\nSerialize text file error: root is null.\n");
         return ERROR;
     }
+    return SerializeText(root, fileName);
+}
 
-    short int iRc = OK;
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nSet int error: allocating memory for search failed.\n");
+// Deinit tree root (can be replaced with Delete(&root, "root"))
+int DeinitTree(NODE **root) {
+    // If no root
+    if (!root) {
+        fprintf(stderr, "\nDeinit error: root is null.\n");
         return ERROR;
     }
 
-    Search(root, &result, targetKey, targetNode);
+    TREE *tree = ((*root)->flags & NODEROOT) ? ((*root)->up.tree) : (NULL);
 
-    if (result->node) {
-        // Get type
-        enum nodeType targetNode = NodeType(result->node);
+    // Write out and close log (nothing more is logged- the tree goes)
+    if (tree && tree->wal) {
+        WalClose(tree->wal);
+        tree->wal = NULL;
+    }
 
-        if (targetNode != parentNode) {
-            if (targetNode == integerNode) {
-                result->node->value.integer = valueInteger;
-            }
+    // Versions pinned by readers stay (they hold no tree memory)
+    if (tree) {
+        VersionRelease(tree->version);
+        tree->version = NULL;
+    }
 
-            else {
-                fprintf(stderr, "\nSet int error: node contains string value.\n");
-                iRc = ERROR;
-            }
-        }
+    // Image backed- root is the only node
+    if (tree && tree->image) {
+        ImageClose(tree->image);
+        free(tree);
+        FreeNode(NULL, *root);
+        return OK;
+    }
 
-            // If target is parent
-        else {
-            fprintf(stderr, "\nSet int error: node is a parent node.\n");
-            iRc = ERROR;
-        }
+    // Concurrent- nobody may be reading by now, so retired memory goes at once
+    if (tree && tree->sync) {
+        SyncDestroy(tree->sync, tree);
+        tree->sync = NULL;
     }
-    else {
-        fprintf(stderr, "\nSet int error: no such target key.\n");
-        iRc = ERROR;
+
+    // Arena- every node goes with its chunks (no traversal)
+    if (tree && tree->arena) {
+        IndexDestroy(tree->index);
+        InternDestroy(tree->intern);
+        HandlesDestroy(tree->handles);
+        ArtDestroy(tree->art);
+        ArenaDestroy(tree->arena);
+        free(tree);
+        return OK;
     }
-    free (result);
-    return iRc;
+
+    // Free tree state (whole tree goes, no need to unindex node by node- nor to release strings one by one)
+    VISITOR visitor = (tree && tree->intern) ? (FreeInternedVisitor) : (FreeVisitor);
+    if (tree) {
+        IndexDestroy(tree->index);
+        InternDestroy(tree->intern);
+        HandlesDestroy(tree->handles);
+        ArtDestroy(tree->art);
+        free(tree);
+    }
+
+    // Free memory of nodes (on all cores)
+    if (TraverseParallel(*root, visitor, NULL, postOrder, NULL) != OK) {
+        fprintf(stderr, "ERROR: Deinitialization failed!");
+        return ERROR;
+    }
+
+    return OK;
 }
 
-// Set node string
-int SetString(NODE **root, char *targetKey, const char *valueString) {
+// Serialize tree to binary image file (see image.h for format)
+int SerializeBinary(NODE **root, const char *fileName) {
     // If no root
     if (!root) {
-        fprintf(stderr, "\nSet string error: root is null.\n");
+        fprintf(stderr, "\nSerialize binary error: root is null.\n");
         return ERROR;
     }
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nSet string error: allocating memory for search failed.\n");
+    // Image backed- write image as is
+    if (ImageOf(root)) {
+        return ImageWrite(ImageOf(root), fileName);
+    }
+
+    TREE *locked = LockTree(root);
+    IMAGE *image = ImageBuild(*root);
+    UnlockTree(locked);
+    if (!image) {
+        fprintf(stderr, "\nSerialize binary error: building image failed.\n");
         return ERROR;
     }
 
-    short int iRc = OK;
-    Search(root, &result, targetKey, targetNode);
+    int iRc = ImageWrite(image, fileName);
+    ImageClose(image);
+    return iRc;
+}
 
-    if (result->node) {
-        // Get type
-        enum nodeType targetNode = NodeType(result->node);
+// Create read-only tree of image (root is the only node, image is closed if it fails)
+static NODE *ImageTree(IMAGE *image) {
+    TREE *tree = calloc(1, sizeof(TREE));
+    NODE *root = (tree) ? (CreateNode(NULL, image->pool + image->nodes[0].key, image->nodes[0].keyLength)) : (NULL);
+    if (!root) {
+        fprintf(stderr, "ERROR: creating root node failed!");
+        free(tree);
+        ImageClose(image);
+        return NULL;
+    }
 
-        if (targetNode != parentNode) {
-            // If stringNode- or if string is null and integer is 0
-            // (we allow setting string if integer is 0)
-            if (targetNode == stringNode || result->node->value.integer == 0) {
-                char *temp = realloc(result->node->value.string,
-                                     sizeof(char) * (strlen(valueString) + 1));
+    tree->image = image;
+    tree->root = root;
+    root->flags |= NODEROOT;
+    root->up.tree = tree;
+    return root;
+}
 
-                if (temp) {
-                    strcpy(temp, valueString);
-                    result->node->value.string = temp;
-                }
-                else {
-                    // We don't free old memory held by node string (if it fails, we'll keep the old data)
-                    fprintf(stderr, "\nSet string error: reallocating memory failed.\n");
-                    iRc = ERROR;
-                }
-            }
+// Load binary image file as read-only tree (mapped- values are served from image without parsing)
+NODE *LoadBinary(const char *fileName) {
+    IMAGE *image = ImageOpen(fileName);
+    return (image) ? (ImageTree(image)) : (NULL);
+}
 
-            else {
-                fprintf(stderr, "\nSet string error: node contains integer value.\n");
-                iRc = ERROR;
-            }
-        }
+// Freeze tree into read-only image (nodes go- root is replaced, every call but reads fails from then on)
+int FreezeTree(NODE **root) {
+    // If no root
+    if (!root || !*root) {
+        fprintf(stderr, "\nFreeze tree error: root is null.\n");
+        return ERROR;
+    }
 
-            // If target is parent
-        else {
-            fprintf(stderr, "\nSet string error: node is a parent node.\n");
-            iRc = ERROR;
-        }
+    // Frozen already
+    if (ImageOf(root)) {
+        return OK;
     }
 
-    else {
-        fprintf(stderr, "\nSet string error: no such target key.\n");
-        iRc = ERROR;
+    // Frozen trees log nothing
+    TREE *tree = ((*root)->flags & NODEROOT) ? ((*root)->up.tree) : (NULL);
+    if (!tree || tree->wal) {
+        fprintf(stderr, "\nFreeze tree error: %s.\n", (tree) ? ("tree has a log") : ("node is not tree root"));
+        return ERROR;
     }
-    free (result);
-    return iRc;
+
+    TREE *locked = LockTree(root);
+    IMAGE *image = ImageBuild(*root);
+    UnlockTree(locked);
+
+    NODE *frozen = (image) ? (ImageTree(image)) : (NULL);
+    if (!frozen) {
+        fprintf(stderr, "\nFreeze tree error: building image failed.\n");
+        return ERROR;
+    }
+
+    DeinitTree(root);
+    *root = frozen;
+    return OK;
 }
 
-// Get node integer
-unsigned long GetInt(NODE **root, char *targetKey) {
-    // Chosen to return 0 if error due to unsigned value easily getting mistaken for real values.
-    // Returning a data structure with value and error code would be less prone to erroneous mistakes
+// Apply replayed log record (through the API, so the same rules apply as when logged- replay isn't counted)
+static int LogReplay(void *context, const enum walOp op, const char *path, const char *text, const unsigned long integer) {
+    NODE **root = context;
+
+    switch (op) {
+        case walAdd:
+            return AddNodeOp(root, (char *) path, (char *) text);
+        case walSetInt:
+            return SetIntOp(root, (char *) path, integer);
+        case walSetString:
+            return SetStringOp(root, (char *) path, text);
+        case walDelete:
+            return DeleteOp(root, (char *) path);
+        case walSnapshot:
+            // Snapshots are replayed by their records (see WalReplay)
+            return OK;
+    }
+    fprintf(stderr, "\nOpen log error: unknown record in log.\n");
+    return ERROR;
+}
 
+// Open write-ahead log of tree (replays log onto tree first- open on an empty tree once checkpointed, window in microseconds)
+int OpenLog(NODE **root, const char *fileName, const unsigned long window) {
     // If no root
-    if (!root) {
-        fprintf(stderr, "\nGet int error: root is null.\n");
-        return 0;
+    if (!root || !*root || !fileName) {
+        fprintf(stderr, "\nOpen log error: root or file name is null.\n");
+        return ERROR;
     }
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nGet int error: allocating memory for search failed.\n");
-        return 0;
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nOpen log error: tree is read-only.\n");
+        return ERROR;
     }
 
-    Search(root, &result, targetKey, targetNode);
-    unsigned long value = 0;
+    // Records hold paths from tree root
+    TREE *tree = ((*root)->flags & NODEROOT) ? ((*root)->up.tree) : (NULL);
+    if (!tree || tree->wal) {
+        fprintf(stderr, "\nOpen log error: %s.\n", (tree) ? ("tree already has a log") : ("node is not tree root"));
+        return ERROR;
+    }
 
-    if (result->node) {
-        // Get type
-        enum nodeType targetNode = NodeType(result->node);
+    TREE *writer = WriteBegin(root);
+    tree->wal = WalOpen(fileName, window, LogReplay, root);
+    WriteEnd(writer);
 
-        if (targetNode == integerNode) {
-            value = result->node->value.integer;
-        }
+    return (tree->wal) ? (OK) : (ERROR);
+}
 
-        else {
-            fprintf(stderr, "\nGet int error: wrong node type.\n");
-        }
-    }
+// Write out and sync every mutation logged so far (whatever the window)
+int SyncLog(NODE **root) {
+    TREE *tree = (root && *root) ? (TreeOf(*root)) : (NULL);
 
-    else {
-        fprintf(stderr, "\nGet int error: no such key in tree.\n");
+    if (!tree || !tree->wal) {
+        fprintf(stderr, "\nSync log error: tree has no log.\n");
+        return ERROR;
     }
-    free (result);
-    return value;
+    return WalSync(tree->wal);
 }
 
-// Get node string
-char *GetString(NODE **root, char *targetKey) {
-    char *value = NULL;   // Trying to printf a null will crash
+// Start checkpoint of log now (rather than when log has grown to LOGCOMPACT- writes go on meanwhile)
+int CheckpointLog(NODE **root) {
+    TREE *tree = (root && *root) ? (TreeOf(*root)) : (NULL);
 
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nGet string error: root is null.\n");
-        return value;
+    if (!tree || !tree->wal) {
+        fprintf(stderr, "\nCheckpoint log error: tree has no log.\n");
+        return ERROR;
     }
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nGet string error: allocating memory for search failed.\n");
-        return value;
+    // Pin while writers are held off (tree is whole)
+    TREE *writer = WriteBegin(root);
+    short int iRc = ERROR;
+    if (!WalCompactDue(tree->wal, TRUE)) {
+        fprintf(stderr, "\nCheckpoint log error: checkpoint is already running.\n");
     }
+    else {
+        iRc = LogCheckpoint(tree);
+    }
+    WriteEnd(writer);
+    return iRc;
+}
 
-    Search(root, &result, targetKey, targetNode);
-
-    if (result->node) {
-        // Get type
-        enum nodeType targetNode = NodeType(result->node);
-
-        if (targetNode == stringNode) {
-            value = result->node->value.string;
-        }
+// Close write-ahead log of tree (logged mutations are written out and synced first)
+int CloseLog(NODE **root) {
+    TREE *tree = (root && *root) ? (TreeOf(*root)) : (NULL);
 
-        else {
-            fprintf(stderr, "\nGet string error: wrong node type.\n");
-        }
+    if (!tree || !tree->wal) {
+        fprintf(stderr, "\nClose log error: tree has no log.\n");
+        return ERROR;
     }
 
-    else {
-        fprintf(stderr, "\nGet string error: no such key in tree.\n");
-    }
-    free (result);
-    return value;
+    TREE *writer = WriteBegin(root);
+    int iRc = WalClose(tree->wal);
+    tree->wal = NULL;
+    WriteEnd(writer);
+    return iRc;
 }
 
-// String / integer accessor (if string = null, then integer value)
-DATA *GetValue(NODE **root, char *targetKey) {
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nGet value error: root is null.\n");
+// Pin version of tree (immutable- read it from any thread without locks, writers go on, see version.h)
+// The first pin is a full copy of the tree, writers wait for it (pin early, before the tree grows large)
+VERSION *PinVersion(NODE **root) {
+    TREE *tree = (root && *root) ? (TreeOf(*root)) : (NULL);
+
+    if (!tree) {
+        fprintf(stderr, "\nPin version error: root is null.\n");
         return NULL;
     }
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nGet value error: allocating memory for search failed.\n");
+    // Images are immutable already
+    if (tree->image) {
+        fprintf(stderr, "\nPin version error: tree is read-only (read image directly).\n");
         return NULL;
     }
 
-    DATA *data = NULL;
-    Search(root, &result, targetKey, targetNode);
-    if (result->node) {
-        enum nodeType type = NodeType(result->node);
-
-        if (type == stringNode || type == integerNode) {
-            data = &result->node->value;
-        }
+    TREE *locked = LockTree(root);
+    VERSION *version = TreeVersion(tree);
+    if (version) {
+        VersionHold(version);
     }
-    free (result);
-    return data;
+    UnlockTree(locked);
+    return version;
 }
 
-// String / integer mutator (sets argument to corresponding format- %s for string, %d for int)
-int SetValue(NODE **root, char *targetKey, char *format, ...) {
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nSet value error: root is null.\n");
+// Release version pinned by PinVersion (data handed out by it is no longer valid)
+int ReleaseVersion(VERSION *version) {
+    if (!version) {
+        fprintf(stderr, "\nRelease version error: version is null.\n");
         return ERROR;
     }
+    VersionRelease(version);
+    return OK;
+}
 
-    // Points to each unnamed arg in turn
-    va_list ap;
-    char *p;
-
-    // Make ap point to 1st unnamed arg
-    va_start(ap, format);
+// Get value of node in version by key (valid until version is released)
+DATA *GetVersionValue(VERSION *version, char *targetKey) {
+    const VNODE *node = VersionFind(version, targetKey);
 
-    // Iterate over args
-    for (p = format; *p; p++) {
-        if (*p != '%') {
-            fprintf(stderr, "Set value error: valid formats are '%%s' for string and '%%d' for integer.");
-            return ERROR;
-        }
-        switch (*++p) {
-            case 'd':
-                SetInt(root, targetKey, va_arg(ap, unsigned long));
-                break;
-            case 's':
-                SetString(root, targetKey, va_arg(ap, char *));
-                break;
-            default:
-                break;
-        }
+    if (!node || (node->type != stringNode && node->type != integerNode)) {
+        return NULL;
     }
-    // Clean up when done
-    va_end(ap);
+    return (DATA *) &node->data;
+}
 
-    return OK;
+// Get node type in version by key
+enum nodeType GetVersionType(VERSION *version, char *targetKey) {
+    const VNODE *node = VersionFind(version, targetKey);
+    return (node) ? ((enum nodeType) node->type) : (noSuchNode);
 }
 
-// Print value of data
-int PrintValue(const DATA *data) {
-    if (!data) {
+// Enumerate all child nodes with values from given node of version (tree may change meanwhile)
+int EnumerateVersion(VERSION *version, char *targetKey) {
+    if (!version) {
+        fprintf(stderr, "\nEnumerate version error: version is null.\n");
         return ERROR;
     }
-    else if (!data->string) {
-        printf("integer value '%li'", data->integer);
-    }
-    else {
-        printf("string value \"%s\"", data->string);
+    if (VersionEnumerate(version, targetKey) != OK) {
+        fprintf(stderr, "\nEnumerate version error: target key does not exist.\n");
+        return ERROR;
     }
     return OK;
 }
 
-// Print key name and value of data
-int EnumKeyValue(const char *targetKey, const DATA *data) {
-    printf("\n\t '%s'   \t :: \t", targetKey);
-    PrintValue(data);
+// Pin concurrent tree for reading (strings and values handed out stay valid until ReadUnlock, nests)
+int ReadLock(NODE **root) {
+    if (!root || !*root) {
+        fprintf(stderr, "\nRead lock error: root is null.\n");
+        return ERROR;
+    }
+    TREE *tree = ConcurrentOf(root);
+    return (tree) ? (SyncPin(tree->sync)) : (OK);
+}
+
+// Unpin concurrent tree
+int ReadUnlock(NODE **root) {
+    if (!root || !*root) {
+        fprintf(stderr, "\nRead unlock error: root is null.\n");
+        return ERROR;
+    }
+    TREE *tree = ConcurrentOf(root);
+    if (tree) {
+        SyncUnpin(tree->sync);
+    }
     return OK;
 }
 
-// Enumerate all child nodes with values from given node
-int Enumerate(NODE **root, char *targetKey) {
-    short int iRc = ERROR;
+// Count node into statistics of tree
+static enum visitResult StatsVisitor(NODE *node, const unsigned long depth, void *context) {
+    TREESTATS *stats = context;
 
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nEnumerate error: root is null.\n");
-        return iRc;
+    stats->nodes++;
+    stats->depths[(depth < STATBUCKETS) ? (depth) : (STATBUCKETS - 1)]++;
+    stats->depth = (depth > stats->depth) ? (depth) : (stats->depth);
+    if (node->numChildren) {
+        stats->fanouts[StatsBucket(node->numChildren)]++;
+        stats->fanout = (node->numChildren > stats->fanout) ? (node->numChildren) : (stats->fanout);
     }
-
-    // Get target
-    SEARCHRESULT *resultNode = calloc(1, sizeof(SEARCHRESULT));
-    if (!resultNode) {
-        fprintf(stderr, "\nEnumerate error: allocating memory for search failed.\n");
-        return iRc;
+    else {
+        stats->leaves++;
     }
+    return visitContinue;
+}
 
-    Search(root, &resultNode, targetKey, targetNode);
+// Count nodes of image into statistics of tree (nodes are in breadth first order, one level after the other)
+static void StatsImage(const IMAGE *image, TREESTATS *stats) {
+    unsigned long numNodes = image->header->numNodes,
+                  levelEnd = 1,
+                  nextEnd = 1,
+                  depth = 0,
+                  i;
+
+    for (i = 0; i < numNodes; ++i) {
+        if (i == levelEnd) {
+            depth++;
+            levelEnd = nextEnd;
+        }
 
-    if (resultNode->node) {
-        // Get targets children
-        SEARCHRESULT *resultNodeChildren = calloc(1, sizeof(SEARCHRESULT));
-        if (!resultNodeChildren) {
-            fprintf(stderr, "\nEnumerate error: allocating memory for search failed.\n");
+        unsigned long numChildren = image->nodes[i].numChildren;
+        stats->nodes++;
+        stats->depths[(depth < STATBUCKETS) ? (depth) : (STATBUCKETS - 1)]++;
+        stats->depth = depth;
+        if (numChildren) {
+            stats->fanouts[StatsBucket(numChildren)]++;
+            stats->fanout = (numChildren > stats->fanout) ? (numChildren) : (stats->fanout);
+            nextEnd = image->nodes[i].firstChild + numChildren;
         }
         else {
-            Search(&resultNode->node, &resultNodeChildren, "dummy", fullTree);
-            if (resultNodeChildren->numNodes > 1) {
-                printf("\nValue holding node(s) enumerated from '%s': ", targetKey);
-                // Function pointer (callback) to KeyValue
-                int (*KeyValuePtr)(const char *, const DATA *);
-                KeyValuePtr = &EnumKeyValue;    // Would be less code and overhead to call method directly
-
-                enum nodeType type;
-                int cnt = 1;    // 0 is target node: 1 to go below target
-                while (cnt < resultNodeChildren->numNodes) {
-                    type = NodeType(resultNodeChildren->nodes[cnt]);
-                    // If holding value, callback
-                    if (type == stringNode || type == integerNode) {
-                        KeyValuePtr(resultNodeChildren->nodes[cnt]->key, &resultNodeChildren->nodes[cnt]->value);
-                    }
-                    cnt++;
-                }
-                printf("\n");
-            }
-            else {
-                printf("\nNo value holding nodes found under '%s'.", targetKey);
-            }
-            free(resultNodeChildren->nodes);
-            free(resultNodeChildren);
-            iRc = OK;
+            stats->leaves++;
         }
     }
-    free (resultNode);
-    return iRc;
+    stats->slots = image->header->numSlots;
+    stats->indexed = (image->header->numSlots) ? (numNodes) : (0);
+    stats->paths = image->header->numPaths;
 }
 
-// Delete target node (incl. child nodes and empty parent nodes)
-int Delete(NODE **root, char *targetKey) {
-    short int iRc = ERROR;
-
+// Get statistics of tree and of operations (counters are process wide, writers are locked out meanwhile)
+int GetTreeStats(NODE **root, TREESTATS *stats) {
     // If no root
-    if (!root) {
-        fprintf(stderr, "\nDelete error: root is null.\n");
-        return iRc;
-    }
-
-    // Get target and all traversed nodes
-    SEARCHRESULT *resultToNode = calloc (1, sizeof(SEARCHRESULT));
-    if (!resultToNode) {
-        fprintf(stderr, "\nDelete error: allocating memory for search failed.\n");
-        return iRc;
+    if (!root || !*root || !stats) {
+        fprintf(stderr, "\nTree stats error: root or stats is null.\n");
+        return ERROR;
     }
 
-    Search(root, &resultToNode, targetKey, traversedTarget);
-
-    // If anything- and if return matches target
-    if (resultToNode->nodes) {
-        if (!strcmp(resultToNode->nodes[resultToNode->numNodes - 1]->key, targetKey)) {
-            // Get targets children
-            SEARCHRESULT *resultNodeChildren = calloc(1, sizeof(SEARCHRESULT));
-            if (!resultNodeChildren) {
-                fprintf(stderr, "\nDelete error: allocating memory for search failed.\n");
-            } else {
-                // Get all children of target (using target as root)
-                Search(&resultToNode->nodes[resultToNode->numNodes - 1], &resultNodeChildren, "dummy", fullTree);
-
-                long cnt = 1, queued = 0, i, z, x; // long to match numNodes (cnt 1 avoids target)
-                if (resultNodeChildren->nodes) {
-                    // Free children
-                    while (cnt < resultNodeChildren->numNodes) {
-                        free(resultNodeChildren->nodes[cnt]->key);
-                        free(resultNodeChildren->nodes[cnt]->children);
-                        if (resultNodeChildren->nodes[cnt]->value.string) {
-                            free(resultNodeChildren->nodes[cnt]->value.string);
-                        }
-                        free(resultNodeChildren->nodes[cnt]);
-                        cnt++;
-                    }
-                    // Free search
-                    free(resultNodeChildren->nodes);
-                }
-                free(resultNodeChildren);
-
-                // Check parents backwards
-                cnt = resultToNode->numNodes - 2;   // Last is target, thus -2 accounting for element 0
+    memset(stats, 0, sizeof(TREESTATS));
+    StatsCollect(&stats->counters);
 
-                // Set target as current
-                NODE *current = resultToNode->nodes[resultToNode->numNodes - 1],
-                     **toFree = calloc(resultToNode->numNodes, sizeof(NODE));
-
-                short int modifiedPrevious = FALSE;
-
-                if (!toFree) {
-                    fprintf(stderr, "\nDelete error: allocating memory failed.\n");
-                } else {
-                    toFree[queued] = current;
-                    while (cnt >= 0) {
-
-                        for (i = 0; i < resultToNode->nodes[cnt]->numChildren; ++i) {
-                            if (strcmp(resultToNode->nodes[cnt]->children[i]->key, current->key) == 0) {
-                                // Set parent as current
-                                current = resultToNode->nodes[cnt];
-
-                                // If parent is empty (and not root)
-                                if (current->numChildren <= 1 && current != *root) {
-                                    toFree[++queued] = current;
-                                }
-
-                                // If parent should be modified
-                                else if (modifiedPrevious == FALSE) {
-                                    // Decrement children
-                                    current->numChildren--;
-
-                                    // Remove child from parents children
-                                    // Find child and swap
-                                    for (z = 0; z <= current->numChildren; z++) {
-                                        for (x = 0; x <= queued; x++) {
-                                            if (strcmp(toFree[x]->key, current->children[z]->key) == 0) {
-                                                // Swap to end
-                                                current->children[z] = current->children[current->numChildren];
-                                            }
-                                        }
-                                    }
-
-                                    // Re-allocate memory to match number of children
-                                    current->children = ReallocHandling(current->children,
-                                                                        sizeof(NODE) * (current->numChildren + 1));
-
-                                    modifiedPrevious = TRUE;
-                                }
-                            }
-                        }
-                        cnt--;
-                    }
-                    // Free empty parents (and target)
-                    while (queued >= 0) {
-                        free(toFree[queued]->key);
-                        free(toFree[queued]->children);
-                        if (toFree[queued]->value.string) {
-                            free(toFree[queued]->value.string);
-                        }
-                        free(toFree[queued]);
-                        queued--;
-                    }
-                    free(toFree);
-                    iRc = OK;
-                }
-            }
-        }
-        else {
-            fprintf(stderr, "\nDelete error: target key does not exist.\n");
-        }
+    IMAGE *image = ImageOf(root);
+    if (image) {
+        StatsImage(image, stats);
+        return OK;
     }
 
-    // Free search
-    free (resultToNode->nodes);
-    free (resultToNode);
+    TREE *tree = LockTree(root),
+         *state = TreeOf(*root);
+    int iRc = TraverseNodes(*root, StatsVisitor, stats, preOrder);
 
+    if (state && state->index) {
+        stats->indexed = state->index->used;
+        stats->slots = state->index->capacity;
+    }
+    if (state && state->art) {
+        stats->paths = state->art->size;
+    }
+    if (state && state->intern) {
+        stats->interned = state->intern->used;
+        stats->holders = state->intern->holders;
+        stats->pooled = state->intern->bytes;
+    }
+    UnlockTree(tree);
     return iRc;
 }
 
-// Return translation for node string value- or english text if translation is void
-char *GetText(NODE **root, char *targetKey, char *language) {
+// Release retired slots of handle table
+static void HandlesRelease(void *context, void *memory, const size_t size) {
+    free(memory);
+}
+
+// Resolve key to handle of node (same rules as Search- 0 if no such key, handle is of tree of root)
+HANDLE ResolveHandle(NODE **root, char *targetKey) {
     // If no root
-    if (!root) {
-        fprintf(stderr, "\nGet text error: root is null.\n");
-        return NULL;
+    if (!root || !*root || !targetKey) {
+        fprintf(stderr, "\nResolve handle error: root or key is null.\n");
+        return 0;
     }
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nSet string error: allocating memory for search failed.\n");
-        return NULL;
+    // Image backed trees hold no nodes to hand out
+    TREE *state = TreeOf(*root);
+    if (!state || ImageOf(root)) {
+        fprintf(stderr, "\nResolve handle error: tree has no nodes to hand out.\n");
+        return 0;
     }
 
-    Search(root, &result, language, targetNode);
-
-    // This is somewhat incomplete- I append language due to unique key values only
-    char *path = calloc (strlen(language) + strlen(targetKey), sizeof(char));
-    if (!path) {
-        fprintf(stderr, "\nSet string error: allocating memory for path failed.\n");
-        free (result);
-        return NULL;
+    SEARCHRESULT *result = calloc (1, sizeof(SEARCHRESULT));
+    if (!result) {
+        fprintf(stderr, "\nResolve handle error: allocating memory for search failed.\n");
+        return 0;
     }
-    strcat(path, language);
-    strcat(path, targetKey);
 
-    if (result->node) {
-        // Language found
-        Search(&result->node, &result, path, targetNode);
-        enum nodeType type = NodeType(result->node);
+    // Readers go on meanwhile (they never see a slot before its node, see handle.h)
+    TREE *tree = LockTree(root);
+    HANDLESLOT *retired = NULL;
+    HANDLE handle = 0;
 
-        // If target language doesn't have the target, or no language found, search the EN node
-        if (type != stringNode) {
-            Search(root, &result, "en", targetNode);
-            Search(&result->node, &result, targetKey, targetNode);
-        }
+    Search(root, &result, targetKey, targetNode);
+    if (!result->node) {
+        fprintf(stderr, "\nResolve handle error: no such target key.\n");
     }
-
-    free (path);
-    free (result);
-    return result->node->value.string;
-}
-
-// Get length of line from file
-static long GetLineLength (FILE *file) {
-    long length = 0;
-    int character;
-
-    long position = ftell(file);
-    while (!feof(file)) {
-        character = fgetc(file);
-        length++;
-        if (character == '\n') {
-            break;
+    else {
+        if (!state->handles) {
+            __atomic_store_n(&state->handles, HandlesCreate(), __ATOMIC_RELEASE);
         }
+        if (state->handles) {
+            handle = HandleTake(state->handles, result->node, (state->sync) ? (&retired) : (NULL));
+        }
+    }
+    if (retired) {
+        SyncRetire(state->sync, retired, 0, HandlesRelease);
     }
-    fseek(file, position, SEEK_SET); // Set file position to start of line.
-    return length;
+    UnlockTree(tree);
+    free(result);
+    return handle;
 }
 
-// Deserialize database from text file (parsed line by line)
-int DeserializeTextFile(NODE **root, const char *fileName) {
-    // Notice: this deserialization assumes no quotes '"', white spaces or equal signs '=' are used in keys
-    // General format should be: path.key = integer OR path.key = "string"
+// Read node of handle from concurrent tree (lock free- read again if a writer got in between)
+static enum nodeType ReadHandle(TREE *tree, const HANDLE handle, DATA *value) {
+    enum nodeType type;
+    unsigned long sequence;
+    NODE *node;
 
-    // If no root
-    if (!root) {
-        fprintf(stderr, "\nDeserialize text file error: root is null.\n");
-        return ERROR;
+    if (SyncPin(tree->sync) != OK) {
+        return errorUndefinedNode;
     }
 
-    unsigned long
-            integer = 0,
-            cnt = 0;
-
-    char    *keyPath,
-            *targetKey,
-            *string = NULL,
-            *line = NULL,
-            *token,
-            *path = NULL;
+    do {
+        sequence = SyncReadBegin(tree->sync);
+        node = HandleNode(__atomic_load_n(&tree->handles, __ATOMIC_ACQUIRE), handle);
+        type = (node) ? (ReadNode(node, value)) : (noSuchNode);
+    } while (!SyncReadValid(tree->sync, sequence));
 
-    short int iRc = OK;
+    SyncUnpin(tree->sync);
+    return type;
+}
 
-    long lineLength;
-    FILE *file;
+// Get value of node by handle (noSuchNode if handle is stale)
+static enum nodeType HandleValue(NODE **root, const HANDLE handle, DATA *value) {
+    TREE *tree = (root && *root) ? (TreeOf(*root)) : (NULL);
 
-    if (!(file = fopen(fileName, "r"))) {
-        fprintf(stderr, "Deserialize text file error: problem reading file.");
-        return ERROR;
+    if (!tree) {
+        return errorUndefinedNode;
+    }
+    if (tree->sync) {
+        return ReadHandle(tree, handle, value);
     }
 
-    // Not critical if it fails- will be checked by AddNode (we check to avoid warnings of existing keys)
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-
-    // Read until end of file unless error occurs
-    while (iRc == OK && !feof (file)) {
-        lineLength = GetLineLength(file);               // Get line length
-        line = malloc ((size_t) lineLength);            // Allocate buffer to correct length
-        cnt++;                                          // Count iterations / line number
-
-        if (line) {
-            if (fscanf(file, "%[^\n] \n", line) == 1) {  // Scan to \n (and add \n to retain format)
-                // We got the line, including '\n'
-                // Split into tokens (starting within " " to allow white spaces in string values)
-                strtok(line, "\"");             // Initialize tokens
-                token = strtok(NULL, "\"");     // Jump to second token and assign to token
-
-                // If string
-                if (token) {
-                    string = token;
-                }
-
-                // Or if integer
-                else {
-                    strtok(line, "\t =");                   // Delimiter by tabs, spaces and equal signs
-                    token = strtok(NULL, "\t =");
-
-                    if (token) {
-                        integer = strtoul(token, NULL, 10); // Get unsigned long from string in base 10
-                    }
-                    else {
-                        fprintf(stderr, "Deserialize text file error: "
-                                "extracting values failed for line %li: '%s'.", cnt, line);
-                        iRc = ERROR;
-                    }
-                }
-
-                // Full key path
-                keyPath = strtok(line, "\t =");
-
-                // Split keys (first is parent of root, second is parent of first, etc- last one holds value)
-                token = strtok(keyPath, ".");
-                targetKey = (*root)->key;
-                while (token) {
-                    // Check if key exists in tree
-                    Search(root, &result, token, targetNode);
-
-                    // If not found, add node
-                    if (!result->node) {
-                        // To avoid replicate nodes (hack for "no")
-                        char no[] = "no";
-                        if (strcmp(targetKey, no) == 0) {
-                            path = calloc (strlen(no) + strlen(token), sizeof(char));
-                            if (!path) {
-                                iRc = ERROR;
-                                break;
-                            }
-                            strcat(path, no);
-                            strcat(path, token);
+    NODE *node = HandleNode(tree->handles, handle);
+    if (!node) {
+        return noSuchNode;
+    }
+    NodeData(node, value);
+    return NodeType(node);
+}
 
-                            AddNode(root, targetKey, path);
-                        }
-                        else {
-                            // Generate node, add to respective parent
-                            AddNode(root, targetKey, token);
-                        }
-                    }
+// Get node integer by handle (0 if error, as GetInt)
+unsigned long GetIntH(NODE **root, const HANDLE handle) {
+    unsigned long started = StatBegin(statGet);
+    DATA value = { 0, NULL };
+    enum nodeType type = HandleValue(root, handle, &value);
 
-                    targetKey = token;
-                    token = strtok(NULL, ".");
+    if (type == errorUndefinedNode) {
+        fprintf(stderr, "\nGet int error: root is null.\n");
+    }
+    else if (type == noSuchNode) {
+        fprintf(stderr, "\nGet int error: handle is stale.\n");
+    }
+    else if (type != integerNode) {
+        fprintf(stderr, "\nGet int error: wrong node type.\n");
+    }
+    StatEnd(statGet, started, FALSE);
+    return (type == integerNode) ? (value.integer) : (0);
+}
 
-                    // Reset search
-                    result->node = NULL;
-                }
-                // Set value of last node
-                if (string) {
-                    if (path) {
-                        SetString(root, path, string);
-                        free (path);
-                        path = NULL;
-                    }
-                    else {
-                        SetString(root, targetKey, string);
-                    }
-                }
+// Get node string by handle (NULL if error, as GetString)
+char *GetStringH(NODE **root, const HANDLE handle) {
+    unsigned long started = StatBegin(statGet);
+    DATA value = { 0, NULL };
+    enum nodeType type = HandleValue(root, handle, &value);
 
-                else {
-                    SetInt(root, targetKey, integer);
-                }
-                // Reset string
-                string = NULL;
-            }
-            free (line);
-        }
+    if (type == errorUndefinedNode) {
+        fprintf(stderr, "\nGet string error: root is null.\n");
     }
-    fclose(file);
-    if (result) {
-        free (result);
+    else if (type == noSuchNode) {
+        fprintf(stderr, "\nGet string error: handle is stale.\n");
     }
-    return iRc;
+    else if (type != stringNode) {
+        fprintf(stderr, "\nGet string error: wrong node type.\n");
+    }
+    StatEnd(statGet, started, type != stringNode);
+    return (type == stringNode) ? (value.string) : (NULL);
 }
 
-// Deinit tree root (can be replaced with Delete(&root, "root"))
-int DeinitTree(NODE **root) {
+// Set node integer by handle (stale handles are reported as no such key)
+int SetIntH(NODE **root, const HANDLE handle, const unsigned long valueInteger) {
     // If no root
-    if (!root) {
-        fprintf(stderr, "\nDeinit error: root is null.\n");
+    if (!root || !*root) {
+        fprintf(stderr, "\nSet int error: root is null.\n");
         return ERROR;
     }
 
-    SEARCHRESULT *result = calloc(1, sizeof(SEARCHRESULT));
-    if (!result) {
-        fprintf(stderr, "\nDeinit error: allocating memory for search failed.\n");
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nSet int error: tree is read-only.\n");
         return ERROR;
     }
 
-    Search(root, &result, "dummy", fullTree);
+    unsigned long started = StatBegin(statSet);
+    TREE *writer = WriteBegin(root),
+         *tree = TreeOf(*root);
+    int iRc = SetIntReport(SetNodeInt((tree) ? (HandleNode(tree->handles, handle)) : (NULL), valueInteger));
+    WriteEnd(writer);
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
+}
 
-    if (!result->nodes) {
-        fprintf(stderr, "ERROR: Deinitialization failed!");
+// Set node string by handle (stale handles are reported as no such key)
+int SetStringH(NODE **root, const HANDLE handle, const char *valueString) {
+    // If no root
+    if (!root || !*root || !valueString) {
+        fprintf(stderr, "\nSet string error: root or string is null.\n");
         return ERROR;
     }
 
-    else {
-        // Free memory of nodes
-        int i;
-        for (i = 0; i < result->numNodes; ++i) {
-            free(result->nodes[i]->key);
-            free(result->nodes[i]->children);
-            if (result->nodes[i]->value.string) {
-                free(result->nodes[i]->value.string);
-            }
-            free(result->nodes[i]);
-        }
-
-        // Free search
-        free(result->nodes);
+    // Image backed trees are read-only
+    if (ImageOf(root)) {
+        fprintf(stderr, "\nSet string error: tree is read-only.\n");
+        return ERROR;
     }
-    free (result);
 
-    return OK;
+    unsigned long started = StatBegin(statSet);
+    TREE *writer = WriteBegin(root),
+         *tree = TreeOf(*root);
+    int iRc = SetStringReport(SetNodeString((tree) ? (HandleNode(tree->handles, handle)) : (NULL), valueString));
+    WriteEnd(writer);
+    StatEnd(statSet, started, iRc != OK);
+    return iRc;
 }
 
-// Init tree root
-NODE *InitTree() {
-    register NODE *root = CreateNode("root");
+// Init tree root with options (TREEARENA, TREECONCURRENT, TREEINTERN, TREEART)
+NODE *InitTreeEx(const unsigned int options) {
+    // Allocate tree state (index only required for unique keys)
+    TREE *tree = calloc(1, sizeof(TREE));
+    if (!tree || ((options & TREEARENA) && !(tree->arena = ArenaCreate()))
+              || ((options & TREEINTERN) && !(tree->intern = InternCreate()))
+              || ((options & TREEART) && !(tree->art = ArtCreate()))
+              || (UNIQUEKEYS == TRUE && !(tree->index = IndexCreate(INDEXSLOTS)))) {
+        fprintf(stderr, "ERROR: creating tree state failed!");
+        if (tree) {
+            ArtDestroy(tree->art);
+            InternDestroy(tree->intern);
+            ArenaDestroy(tree->arena);
+            free(tree);
+        }
+        return NULL;
+    }
 
-    // Check if create node was successful
-    if (!root) {
+    register NODE *root = CreateNode(tree, "root", strlen("root"));
+
+    // Check if create node was successful (concurrency state last- nothing to retire on failure)
+    if (!root || (tree->index && TreeIndex(tree, root) != OK)
+              || ((options & TREECONCURRENT) && !(tree->sync = SyncCreate()))) {
         fprintf(stderr, "ERROR: creating root node failed!");
+        if (root) {
+            FreeNode(tree, root);
+        }
+        IndexDestroy(tree->index);
+        ArtDestroy(tree->art);
+        InternDestroy(tree->intern);
+        ArenaDestroy(tree->arena);
+        free(tree);
+        return NULL;
     }
+    root->flags |= NODEROOT;
+    root->up.tree = tree;
+    tree->root = root;
     return root;
-}
\ No newline at end of file
+}
+
+// Init tree root
+NODE *InitTree() {
+    return InitTreeEx(0);
+}
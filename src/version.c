@@ -0,0 +1,501 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "index.h"
+#include "version.h"
+
+// Slot of hash at level of key map
+#define MapSlot(hash, level)    ((unsigned int) ((hash) >> ((level) * VMAPBITS)) & 31U)
+
+// Number of set bits (slots taken)
+#define MapCount(bits)          ((unsigned int) __builtin_popcount(bits))
+
+// Release version node (children go with the last holder)
+static void VersionNodeRelease(VNODE *node) {
+    if (node && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        unsigned int i;
+
+        for (i = 0; i < node->numChildren; ++i) {
+            VersionNodeRelease(node->children[i]);
+        }
+        free(node->children);
+        free(node);
+    }
+}
+
+// Number of version nodes held by map node of level
+static unsigned int MapNodes(const VMAP *map, const unsigned int level) {
+    return (level < VMAPDEPTH) ? (MapCount(map->nodes)) : (map->nodes);
+}
+
+// Hold map node for another version (NULL is ignored)
+static VMAP *MapHold(VMAP *map) {
+    if (map) {
+        __atomic_add_fetch(&map->refs, 1, __ATOMIC_RELAXED);
+    }
+    return map;
+}
+
+// Release map node (map nodes below go with the last holder- none are held below VMAPDEPTH, NULL is ignored)
+static void MapRelease(VMAP *map) {
+    if (map && __atomic_sub_fetch(&map->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        unsigned int first = MapCount(map->nodes),
+                     i;
+
+        for (i = 0; i < MapCount(map->maps); ++i) {
+            MapRelease(map->slots[first + i]);
+        }
+        free(map);
+    }
+}
+
+// Make map node exclusive to version being built, with room for count slots (shared map nodes are copied, NULL if out of memory)
+static VMAP *MapOwn(VMAP *map, const unsigned int used, const unsigned int count) {
+    size_t size = sizeof(VMAP) + sizeof(void *) * count;
+    VMAP *own;
+
+    if (!map) {
+        own = calloc (1, size);
+        if (own) {
+            own->refs = 1;
+        }
+        return own;
+    }
+
+    // Held by version being built only
+    if (__atomic_load_n(&map->refs, __ATOMIC_ACQUIRE) == 1) {
+        return (count > used) ? (realloc (map, size)) : (map);
+    }
+
+    own = malloc (size);
+    if (!own) {
+        return NULL;
+    }
+    own->refs = 1;
+    own->nodes = map->nodes;
+    own->maps = map->maps;
+    memcpy(own->slots, map->slots, sizeof(void *) * used);
+
+    // Map nodes below are held by copy too
+    unsigned int i;
+    for (i = used - MapCount(map->maps); i < used; ++i) {
+        MapHold(own->slots[i]);
+    }
+    MapRelease(map);
+    return own;
+}
+
+// Check if node has key of given length (not null terminated)
+static int MapKey(const VNODE *node, const char *key, const size_t length) {
+    return (strncmp(node->key, key, length) == 0 && node->key[length] == '\0') ? (TRUE) : (FALSE);
+}
+
+// Find node by key of given length (not null terminated, NULL if not mapped)
+static const VNODE *MapFind(const VMAP *map, const char *key, const size_t length) {
+    unsigned long hash = HashKeyLength(key, length);
+    unsigned int level,
+                 i;
+
+    for (level = 0; map; ++level) {
+        // Keys of equal hash are listed
+        if (level >= VMAPDEPTH) {
+            for (i = 0; i < map->nodes; ++i) {
+                if (MapKey(map->slots[i], key, length)) {
+                    return map->slots[i];
+                }
+            }
+            return NULL;
+        }
+
+        unsigned int bit = 1U << MapSlot(hash, level);
+        if (map->nodes & bit) {
+            const VNODE *node = map->slots[MapCount(map->nodes & (bit - 1))];
+            return (MapKey(node, key, length)) ? (node) : (NULL);
+        }
+        if (!(map->maps & bit)) {
+            return NULL;
+        }
+        map = map->slots[MapCount(map->nodes) + MapCount(map->maps & (bit - 1))];
+    }
+    return NULL;
+}
+
+// Map key of node to node (replaces node mapped by same key- hash is of key, map node is of level)
+static int MapSet(VMAP **map, const unsigned int level, const unsigned long hash, VNODE *node) {
+    VMAP *current = *map;
+    unsigned int nodes = (current) ? (MapNodes(current, level)) : (0),
+                 used = (current) ? (nodes + MapCount(current->maps)) : (0),
+                 i;
+
+    // Keys of equal hash are listed
+    if (level >= VMAPDEPTH) {
+        for (i = 0; i < nodes && strcmp(((VNODE *) current->slots[i])->key, node->key) != 0; ++i);
+
+        if (!(current = MapOwn(current, used, (i < nodes) ? (used) : (used + 1)))) {
+            return ERROR;
+        }
+        *map = current;
+        current->slots[i] = node;
+        current->nodes = (i < nodes) ? (nodes) : (nodes + 1);
+        return OK;
+    }
+
+    unsigned int bit = 1U << MapSlot(hash, level),
+                 nodeBits = (current) ? (current->nodes) : (0),
+                 mapBits = (current) ? (current->maps) : (0),
+                 at = MapCount(nodeBits & (bit - 1));
+
+    // Slot holds map node- key goes below
+    if (mapBits & bit) {
+        if (!(current = MapOwn(current, used, used))) {
+            return ERROR;
+        }
+        *map = current;
+
+        VMAP **slot = (VMAP **) &current->slots[nodes + MapCount(mapBits & (bit - 1))],
+             *below = *slot;
+        int iRc = MapSet(&below, level + 1, hash, node);
+        *slot = below;
+        return iRc;
+    }
+
+    // Slot is free
+    if (!(nodeBits & bit)) {
+        if (!(current = MapOwn(current, used, used + 1))) {
+            return ERROR;
+        }
+        *map = current;
+        memmove(&current->slots[at + 1], &current->slots[at], sizeof(void *) * (used - at));
+        current->slots[at] = node;
+        current->nodes |= bit;
+        return OK;
+    }
+
+    // Slot holds node of same key
+    VNODE *held = current->slots[at];
+    if (strcmp(held->key, node->key) == 0) {
+        if (!(current = MapOwn(current, used, used))) {
+            return ERROR;
+        }
+        *map = current;
+        current->slots[at] = node;
+        return OK;
+    }
+
+    // Slot holds node of another key- both go one level down
+    VMAP *split = NULL;
+    if (MapSet(&split, level + 1, HashKey(held->key), held) != OK || MapSet(&split, level + 1, hash, node) != OK
+        || !(current = MapOwn(current, used, used))) {
+        MapRelease(split);
+        return ERROR;
+    }
+    *map = current;
+
+    // Node slot goes, map slot comes (nodes come before maps)
+    unsigned int below = (nodes - 1) + MapCount(mapBits & (bit - 1));
+    memmove(&current->slots[at], &current->slots[at + 1], sizeof(void *) * (below - at));
+    current->slots[below] = split;
+    current->nodes &= ~bit;
+    current->maps |= bit;
+    return OK;
+}
+
+// Unmap node (hash is of its key, map node is of level- must be mapped)
+static int MapRemove(VMAP **map, const unsigned int level, const unsigned long hash, const VNODE *node) {
+    VMAP *current = *map;
+    unsigned int nodes = MapNodes(current, level),
+                 used = nodes + MapCount(current->maps),
+                 at;
+
+    if (!(current = MapOwn(current, used, used))) {
+        return ERROR;
+    }
+    *map = current;
+
+    // Keys of equal hash are listed
+    if (level >= VMAPDEPTH) {
+        for (at = 0; current->slots[at] != node; ++at);
+        memmove(&current->slots[at], &current->slots[at + 1], sizeof(void *) * (used - at - 1));
+        current->nodes--;
+    }
+    else {
+        unsigned int bit = 1U << MapSlot(hash, level);
+
+        if (current->nodes & bit) {
+            at = MapCount(current->nodes & (bit - 1));
+            memmove(&current->slots[at], &current->slots[at + 1], sizeof(void *) * (used - at - 1));
+            current->nodes &= ~bit;
+        }
+        else {
+            at = nodes + MapCount(current->maps & (bit - 1));
+
+            VMAP *below = current->slots[at];
+            if (MapRemove(&below, level + 1, hash, node) != OK) {
+                return ERROR;
+            }
+            current->slots[at] = below;
+
+            // Map node below emptied
+            if (!below) {
+                memmove(&current->slots[at], &current->slots[at + 1], sizeof(void *) * (used - at - 1));
+                current->maps &= ~bit;
+            }
+        }
+    }
+
+    if (current->nodes == 0 && current->maps == 0) {
+        MapRelease(current);
+        *map = NULL;
+    }
+    return OK;
+}
+
+// Unmap nodes of subtree dropped from version (keys mapped to a node of the version built already stay so)
+static int VersionUnmap(VMAP **keys, const VNODE *node) {
+    unsigned int i;
+
+    if (MapFind(*keys, node->key, strlen(node->key)) == node && MapRemove(keys, 0, HashKey(node->key), node) != OK) {
+        return ERROR;
+    }
+    for (i = 0; i < node->numChildren; ++i) {
+        if (VersionUnmap(keys, node->children[i]) != OK) {
+            return ERROR;
+        }
+    }
+    return OK;
+}
+
+// Copy node changed since previous version (unchanged subtrees are shared- previous is node of same path, or NULL,
+// keys of nodes copied or dropped are mapped anew)
+static VNODE *VersionCopy(NODE *node, VNODE *previous, VMAP **keys) {
+    if (previous && !(__atomic_load_n(&node->flags, __ATOMIC_SEQ_CST) & NODEDIRTY)) {
+        __atomic_add_fetch(&previous->refs, 1, __ATOMIC_RELAXED);
+        return previous;
+    }
+
+    // Mark is cleared before value is read- a counter updated meanwhile marks node again (see MarkChanged)
+    __atomic_and_fetch(&node->flags, (unsigned char) ~NODEDIRTY, __ATOMIC_SEQ_CST);
+
+    const char *string = (node->type == stringValue) ? (node->value.string) : (NULL);
+    size_t keyLength = strlen(NodeKey(node)) + 1,
+           stringLength = (string) ? (strlen(string) + 1) : (0);
+    VNODE *copy = malloc (sizeof(VNODE) + keyLength + stringLength);
+    if (!copy) {
+        return NULL;
+    }
+
+    copy->refs = 1;
+    copy->type = (unsigned char) NodeType(node);
+    copy->numChildren = 0;
+    copy->children = (node->numChildren) ? (malloc (node->numChildren * sizeof(VNODE *))) : (NULL);
+    memcpy(copy->key, NodeKey(node), keyLength);
+    copy->data.integer = (node->type == integerValue) ? (__atomic_load_n(&node->value.integer, __ATOMIC_SEQ_CST)) : (0);
+    copy->data.string = NULL;
+    if (string) {
+        copy->data.string = copy->key + keyLength;
+        memcpy(copy->data.string, string, stringLength);
+    }
+
+    if ((node->numChildren && !copy->children) || (UNIQUEKEYS == TRUE && MapSet(keys, 0, HashKey(copy->key), copy) != OK)) {
+        free(copy->children);
+        free(copy);
+        return NULL;
+    }
+
+    // Children of both are sorted- walk them side by side to pair nodes of same path
+    unsigned int i,
+                 j = 0;
+    for (i = 0; i < node->numChildren; ++i) {
+        const char *key = NodeKey(node->children[i]);
+        VNODE *match = NULL;
+
+        while (previous && j < previous->numChildren && strcmp(previous->children[j]->key, key) < 0) {
+            // Child dropped since previous version
+            if (UNIQUEKEYS == TRUE && VersionUnmap(keys, previous->children[j]) != OK) {
+                VersionNodeRelease(copy);
+                return NULL;
+            }
+            j++;
+        }
+        if (previous && j < previous->numChildren && strcmp(previous->children[j]->key, key) == 0) {
+            match = previous->children[j++];
+        }
+
+        copy->children[i] = VersionCopy(node->children[i], match, keys);
+        if (!copy->children[i]) {
+            VersionNodeRelease(copy);
+            return NULL;
+        }
+        copy->numChildren++;
+    }
+
+    // Children dropped after the last one kept
+    for (; UNIQUEKEYS == TRUE && previous && j < previous->numChildren; ++j) {
+        if (VersionUnmap(keys, previous->children[j]) != OK) {
+            VersionNodeRelease(copy);
+            return NULL;
+        }
+    }
+
+    return copy;
+}
+
+// Build version of tree (copies nodes changed since previous- caller keeps writers out, previous may be NULL)
+VERSION *VersionBuild(NODE *root, const VERSION *previous) {
+    VERSION *version = malloc (sizeof(VERSION));
+
+    if (version) {
+        version->refs = 1;
+        version->keys = (previous) ? (MapHold(previous->keys)) : (NULL);
+        version->root = VersionCopy(root, (previous) ? (previous->root) : (NULL), &version->keys);
+    }
+    if (!version || !version->root) {
+        // Marks may be cleared below nodes not copied- caller must build the next version from scratch
+        fprintf(stderr, "\nVersion error: allocating memory failed!\n");
+        if (version) {
+            MapRelease(version->keys);
+        }
+        free(version);
+        return NULL;
+    }
+    return version;
+}
+
+// Hold version for another reader
+VERSION *VersionHold(VERSION *version) {
+    __atomic_add_fetch(&version->refs, 1, __ATOMIC_RELAXED);
+    return version;
+}
+
+// Release version (nodes no other version holds go with the last reader, NULL is ignored)
+void VersionRelease(VERSION *version) {
+    if (version && __atomic_sub_fetch(&version->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        MapRelease(version->keys);
+        VersionNodeRelease(version->root);
+        free(version);
+    }
+}
+
+// Find child by key component (not null terminated- binary search of sorted children)
+static const VNODE *VersionFindChild(const VNODE *parent, const char *key, const size_t length) {
+    long low = 0,
+         high = (long) parent->numChildren - 1,
+         mid;
+
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+
+        const char *childKey = parent->children[mid]->key;
+        int cmp = strncmp(childKey, key, length);
+        if (cmp == 0 && childKey[length] != '\0') {
+            cmp = 1;
+        }
+
+        if (cmp == 0) {
+            return parent->children[mid];
+        }
+        else if (cmp < 0) {
+            low = mid + 1;
+        }
+        else {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+// Resolve dotted path one component at a time from root (leading root key and trailing "*" are optional, as by ResolvePath)
+static const VNODE *VersionResolve(const VNODE *root, const char *path) {
+    const VNODE *current = root;
+    const char *component = path,
+               *end;
+    size_t length;
+
+    while (current && *component) {
+        end = strchr(component, '.');
+        length = (end) ? ((size_t) (end - component)) : (strlen(component));
+
+        // Wildcard ends path (enumeration of everything below)
+        if (length == 1 && *component == '*') {
+            break;
+        }
+
+        const VNODE *child = VersionFindChild(current, component, length);
+
+        // Path may start with root key
+        if (!child && current == root && component == path && MapKey(root, component, length)) {
+            child = root;
+        }
+        current = child;
+
+        component += length;
+        if (*component == '.') {
+            component++;
+        }
+    }
+    return current;
+}
+
+// Find node of version by key (same rules as Search- paths are walked through sorted children, else found by end key)
+const VNODE *VersionFind(const VERSION *version, const char *targetKey) {
+    if (!version || !targetKey) {
+        return NULL;
+    }
+
+    size_t length = strlen(targetKey);
+    if (UNIQUEKEYS == FALSE || memchr(targetKey, '.', length)) {
+        const VNODE *node = VersionResolve(version->root, targetKey);
+        if (node || UNIQUEKEYS == FALSE) {
+            return node;
+        }
+
+        // Path not found- unique end key may still be (last component, as by SplitEndKey)
+        while (length && (targetKey[length - 1] == '.' || targetKey[length - 1] == '*')) {
+            length--;
+        }
+        const char *key = targetKey + length;
+        while (key > targetKey && key[-1] != '.' && key[-1] != '*') {
+            key--;
+        }
+        length -= (size_t) (key - targetKey);
+        targetKey = key;
+    }
+    return (length) ? (MapFind(version->keys, targetKey, length)) : (NULL);
+}
+
+// Print value holding nodes below node (last child first- same order as Enumerate)
+static void VersionEnumerateNodes(const VNODE *node) {
+    unsigned int i;
+
+    for (i = node->numChildren; i > 0; --i) {
+        const VNODE *child = node->children[i - 1];
+
+        if (child->type == stringNode || child->type == integerNode) {
+            EnumKeyValue(child->key, &child->data);
+        }
+        VersionEnumerateNodes(child);
+    }
+}
+
+// Enumerate value holding nodes of version below target (same output as Enumerate)
+int VersionEnumerate(const VERSION *version, const char *targetKey) {
+    const VNODE *target = VersionFind(version, targetKey);
+
+    if (!target) {
+        return ERROR;
+    }
+
+    if (target->numChildren == 0) {
+        printf("\nNo value holding nodes found under '%s'.", targetKey);
+        return OK;
+    }
+
+    printf("\nValue holding node(s) enumerated from '%s': ", targetKey);
+    VersionEnumerateNodes(target);
+    printf("\n");
+    return OK;
+}
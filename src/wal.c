@@ -0,0 +1,713 @@
+//
+// Created by morten on 27.10.17.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wal.h"
+#include "index.h"
+
+// Bytes needed for varint
+static size_t VarintLength(unsigned long value) {
+    size_t length = 1;
+
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+// Put varint (7 bits per byte, high bit set if more follow)
+static char *PutVarint(char *out, unsigned long value) {
+    while (value >= 0x80) {
+        *out++ = (char) (value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (char) value;
+    return out;
+}
+
+// Get varint (NULL if cut short)
+static const char *GetVarint(const char *in, const char *end, unsigned long *value) {
+    unsigned int shift = 0;
+
+    *value = 0;
+    while (in < end && shift < 64) {
+        unsigned char byte = (unsigned char) *in++;
+        *value |= (unsigned long) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return in;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+static int WalReplayFile(const char *fileName, REPLAY replay, void *context);
+
+// Replay records of log (returns length of valid records- the rest is a torn write, unless replay failed)
+// Snapshot records are replayed by the records of their snapshot (snapshots hold no snapshot records- wal is NULL)
+static size_t WalReplay(WAL *wal, const char *data, const size_t size, REPLAY replay, void *context, short int *failed) {
+    const char *cursor = data,
+               *end = data + size;
+    char *path = NULL,
+         *text = NULL;
+    size_t capPath = 0,
+           capText = 0;
+
+    while ((size_t) (end - cursor) >= WALHEADER) {
+        uint32_t bodySize,
+                 checksum;
+        memcpy(&bodySize, cursor, sizeof(uint32_t));
+        memcpy(&checksum, cursor + sizeof(uint32_t), sizeof(uint32_t));
+
+        const char *body = cursor + WALHEADER,
+                   *bodyEnd = body + bodySize;
+        if (bodySize < 1 || bodySize > (size_t) (end - body)
+            || (uint32_t) HashKeyLength(body, bodySize) != checksum) {
+            break;
+        }
+
+        // Operation, path, text and integer
+        unsigned long pathLength,
+                      textLength,
+                      integer;
+        enum walOp op = (enum walOp) (unsigned char) *body;
+        const char *field = GetVarint(body + 1, bodyEnd, &pathLength);
+        if (!field || pathLength > (size_t) (bodyEnd - field)) {
+            break;
+        }
+        const char *pathData = field;
+        field = GetVarint(field + pathLength, bodyEnd, &textLength);
+        if (!field || textLength > (size_t) (bodyEnd - field)) {
+            break;
+        }
+        const char *textData = field;
+        if (!GetVarint(field + textLength, bodyEnd, &integer)) {
+            break;
+        }
+
+        // Null terminated copies
+        if (capPath < pathLength + 1) {
+            char *temp = realloc (path, pathLength + 1);
+            if (!temp) {
+                fprintf(stderr, "\nLog error: allocating memory for replay failed!\n");
+                *failed = TRUE;
+                break;
+            }
+            path = temp;
+            capPath = pathLength + 1;
+        }
+        if (capText < textLength + 1) {
+            char *temp = realloc (text, textLength + 1);
+            if (!temp) {
+                fprintf(stderr, "\nLog error: allocating memory for replay failed!\n");
+                *failed = TRUE;
+                break;
+            }
+            text = temp;
+            capText = textLength + 1;
+        }
+        memcpy(path, pathData, pathLength);
+        path[pathLength] = '\0';
+        memcpy(text, textData, textLength);
+        text[textLength] = '\0';
+
+        // Remember snapshot log refers to (next checkpoint writes the other one)
+        if (op == walSnapshot) {
+            char *snapshot = (wal) ? (strdup(text)) : (NULL);
+            if (!snapshot || WalReplayFile(snapshot, replay, context) != OK) {
+                fprintf(stderr, "\nLog error: problem replaying snapshot '%s'.\n", text);
+                free(snapshot);
+                *failed = TRUE;
+                break;
+            }
+            free(wal->snapshot);
+            wal->snapshot = snapshot;
+        }
+        else {
+            replay(context, op, path, (op == walAdd || op == walSetString) ? (text) : (NULL), integer);
+        }
+        cursor = bodyEnd;
+    }
+
+    free(path);
+    free(text);
+    return (size_t) (cursor - data);
+}
+
+// Replay records of snapshot (snapshots are synced before a log refers to them- any torn record fails replay)
+static int WalReplayFile(const char *fileName, REPLAY replay, void *context) {
+    int file = open(fileName, O_RDONLY);
+    struct stat status;
+    short int failed = FALSE;
+
+    if (file < 0 || fstat(file, &status) != 0) {
+        failed = TRUE;
+    }
+    else if (status.st_size > 0) {
+        const char *data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            failed = TRUE;
+        }
+        else {
+            madvise((void *) data, (size_t) status.st_size, MADV_SEQUENTIAL);
+            if (WalReplay(NULL, data, (size_t) status.st_size, replay, context, &failed) < (size_t) status.st_size) {
+                failed = TRUE;
+            }
+            munmap((void *) data, (size_t) status.st_size);
+        }
+    }
+
+    if (file >= 0) {
+        close(file);
+    }
+    return (failed) ? (ERROR) : (OK);
+}
+
+// Write buffered records out (caller holds io- records appended meanwhile go with next write)
+static int WalWriteOut(WAL *wal, const short int sync) {
+    short int iRc = OK;
+
+    // Swap buffers- appending goes on while file is written
+    pthread_mutex_lock(&wal->lock);
+    char *records = wal->buffer;
+    size_t length = wal->length,
+           capacity = wal->capacity;
+    unsigned long target = wal->appended;
+    short int synced = (wal->durable == target) ? (TRUE) : (FALSE);
+
+    wal->buffer = wal->spare;
+    wal->capacity = wal->capSpare;
+    wal->length = 0;
+    wal->written += length;
+    wal->spare = records;
+    wal->capSpare = capacity;
+    pthread_mutex_unlock(&wal->lock);
+
+    size_t written = 0;
+    while (written < length) {
+        ssize_t bytes = write(wal->file, records + written, length - written);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            iRc = ERROR;
+            break;
+        }
+        written += (size_t) bytes;
+    }
+    if (iRc == OK && sync && !synced && fdatasync(wal->file) != 0) {
+        iRc = ERROR;
+    }
+
+    pthread_mutex_lock(&wal->lock);
+    if (iRc == OK && sync) {
+        wal->durable = target;
+    }
+    else if (iRc != OK && !wal->failed) {
+        fprintf(stderr, "\nLog error: writing log failed (records may be lost)!\n");
+        wal->failed = TRUE;
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return iRc;
+}
+
+// Write buffered records out and sync file
+static int WalFlush(WAL *wal) {
+    pthread_mutex_lock(&wal->io);
+    int iRc = WalWriteOut(wal, TRUE);
+    pthread_mutex_unlock(&wal->io);
+    return iRc;
+}
+
+// Flusher thread (one flush per window, starting at first record appended)
+static void *WalFlusher(void *argument) {
+    WAL *wal = argument;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&wal->lock);
+    while (!wal->closing) {
+        // Nothing to write- sleep until a record is appended
+        if (!wal->length) {
+            pthread_cond_wait(&wal->wake, &wal->lock);
+            continue;
+        }
+
+        // Let records gather for a window
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t) (wal->window / 1000000);
+        deadline.tv_nsec += (long) (wal->window % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!wal->closing && pthread_cond_timedwait(&wal->wake, &wal->lock, &deadline) != ETIMEDOUT) {
+        }
+
+        pthread_mutex_unlock(&wal->lock);
+        WalFlush(wal);
+        pthread_mutex_lock(&wal->lock);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return NULL;
+}
+
+// Open log (records already in file are replayed first, torn record at end is cut off)
+WAL *WalOpen(const char *fileName, const unsigned long window, REPLAY replay, void *context) {
+    WAL *wal = calloc (1, sizeof(WAL));
+    if (!wal || !(wal->fileName = strdup(fileName))) {
+        fprintf(stderr, "\nLog error: allocating memory failed!\n");
+        free(wal);
+        return NULL;
+    }
+
+    int file = open(fileName, O_RDWR | O_CREAT | O_APPEND, 0644);
+    struct stat status;
+    short int failed = FALSE;
+
+    if (file < 0 || fstat(file, &status) != 0) {
+        fprintf(stderr, "\nLog error: problem opening file '%s'.\n", fileName);
+        failed = TRUE;
+    }
+
+    // Replay
+    else if (status.st_size > 0) {
+        const char *data = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "\nLog error: problem mapping file '%s'.\n", fileName);
+            failed = TRUE;
+        }
+        else {
+            madvise((void *) data, (size_t) status.st_size, MADV_SEQUENTIAL);
+            wal->written = WalReplay(wal, data, (size_t) status.st_size, replay, context, &failed);
+            munmap((void *) data, (size_t) status.st_size);
+        }
+
+        if (!failed && wal->written < (size_t) status.st_size) {
+            fprintf(stderr, "\nLog: cutting off %lu bytes of torn record(s) from '%s'.\n",
+                    (unsigned long) status.st_size - wal->written, fileName);
+            if (ftruncate(file, (off_t) wal->written) != 0 || fsync(file) != 0) {
+                fprintf(stderr, "\nLog error: problem cutting off torn record(s).\n");
+                failed = TRUE;
+            }
+        }
+    }
+
+    if (failed) {
+        if (file >= 0) {
+            close(file);
+        }
+        free(wal->snapshot);
+        free(wal->fileName);
+        free(wal);
+        return NULL;
+    }
+
+    wal->file = file;
+    wal->window = window;
+    wal->limit = LOGCOMPACT;
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_mutex_init(&wal->io, NULL);
+    pthread_cond_init(&wal->wake, NULL);
+
+    if (window && pthread_create(&wal->flusher, NULL, WalFlusher, wal) != 0) {
+        fprintf(stderr, "\nLog error: starting flusher failed!\n");
+        wal->window = 0;
+        WalClose(wal);
+        return NULL;
+    }
+    return wal;
+}
+
+// Close log (buffered records are written and synced first)
+int WalClose(WAL *wal) {
+    if (!wal) {
+        return OK;
+    }
+
+    // Let running checkpoint finish (log may be replaced meanwhile)
+    WalCheckpointWait(wal);
+
+    if (wal->window) {
+        pthread_mutex_lock(&wal->lock);
+        wal->closing = TRUE;
+        pthread_cond_signal(&wal->wake);
+        pthread_mutex_unlock(&wal->lock);
+        pthread_join(wal->flusher, NULL);
+    }
+
+    short int iRc = (WalFlush(wal) == OK && !wal->failed) ? (OK) : (ERROR);
+    if (close(wal->file) != 0) {
+        iRc = ERROR;
+    }
+    pthread_cond_destroy(&wal->wake);
+    pthread_mutex_destroy(&wal->io);
+    pthread_mutex_destroy(&wal->lock);
+    free(wal->buffer);
+    free(wal->spare);
+    free(wal->fileName);
+    free(wal->snapshot);
+    free(wal);
+    return iRc;
+}
+
+// Length of path of node (keys from root, separated by '.'- 0 if no node)
+static size_t WalPathLength(const NODE *node) {
+    size_t pathLength = 0;
+
+    for ( ; node; node = NodeParent(node)) {
+        pathLength += strlen(NodeKey(node)) + ((NodeParent(node)) ? (1) : (0));
+    }
+    return pathLength;
+}
+
+// Size of record
+static size_t WalRecordSize(const size_t pathLength, const size_t textLength, const unsigned long integer) {
+    return WALHEADER + 1 + VarintLength(pathLength) + pathLength + VarintLength(textLength) + textLength
+           + VarintLength(integer);
+}
+
+// Encode record (record must hold WalRecordSize bytes)
+static void WalEncode(char *record, const enum walOp op, const NODE *node, const size_t pathLength,
+                      const char *text, const size_t textLength, const unsigned long integer) {
+    char *body = record + WALHEADER,
+         *out = body;
+
+    *out++ = (char) op;
+    out = PutVarint(out, pathLength);
+
+    // Keys from node upwards, written back to front
+    char *path = out + pathLength;
+    for ( ; node; node = NodeParent(node)) {
+        size_t keyLength = strlen(NodeKey(node));
+        path -= keyLength;
+        memcpy(path, NodeKey(node), keyLength);
+        if (NodeParent(node)) {
+            *--path = '.';
+        }
+    }
+    out += pathLength;
+
+    out = PutVarint(out, textLength);
+    if (textLength) {
+        memcpy(out, text, textLength);
+        out += textLength;
+    }
+    out = PutVarint(out, integer);
+
+    uint32_t header[2] = { (uint32_t) (out - body), (uint32_t) HashKeyLength(body, (size_t) (out - body)) };
+    memcpy(record, header, WALHEADER);
+}
+
+// Put record of given path (snapshots- pieces go to put as they are, the checksum is taken over them)
+void WalPutRecord(WALPUT put, void *context, const enum walOp op, const char *path, const size_t pathLength,
+                  const char *text, const size_t textLength, const unsigned long integer) {
+    char head[12],
+         middle[10],
+         tail[10],
+         *headEnd = head,
+         *middleEnd,
+         *tailEnd;
+
+    *headEnd++ = (char) op;
+    headEnd = PutVarint(headEnd, pathLength);
+    middleEnd = PutVarint(middle, textLength);
+    tailEnd = PutVarint(tail, integer);
+
+    size_t headLength = (size_t) (headEnd - head),
+           middleLength = (size_t) (middleEnd - middle),
+           tailLength = (size_t) (tailEnd - tail);
+    unsigned long checksum = HashKeyLength(head, headLength);
+    checksum = HashKeyMore(checksum, path, pathLength);
+    checksum = HashKeyMore(checksum, middle, middleLength);
+    checksum = HashKeyMore(checksum, text, textLength);
+    checksum = HashKeyMore(checksum, tail, tailLength);
+
+    uint32_t header[2] = { (uint32_t) (headLength + pathLength + middleLength + textLength + tailLength),
+                           (uint32_t) checksum };
+    put(context, (const char *) header, WALHEADER);
+    put(context, head, headLength);
+    put(context, path, pathLength);
+    put(context, middle, middleLength);
+    put(context, text, textLength);
+    put(context, tail, tailLength);
+}
+
+// Make room for record in buffer (caller holds lock- grows geometrically)
+static int WalReserve(WAL *wal, const size_t size) {
+    if (wal->length + size > wal->capacity) {
+        size_t capacity = (wal->capacity) ? (wal->capacity) : (WALBUFFER / 16);
+        while (capacity < wal->length + size) {
+            capacity *= 2;
+        }
+        char *temp = realloc (wal->buffer, capacity);
+        if (!temp) {
+            fprintf(stderr, "\nLog error: allocating memory for record failed (mutation isn't logged)!\n");
+            return ERROR;
+        }
+        wal->buffer = temp;
+        wal->capacity = capacity;
+    }
+    return OK;
+}
+
+// Count record put at end of buffer, then unlock (written out before returning if there's no window, or buffer is full)
+static int WalAppended(WAL *wal, const size_t size) {
+    // Wake flusher on first record of window
+    if (wal->length == 0 && wal->window) {
+        pthread_cond_signal(&wal->wake);
+    }
+    wal->length += size;
+    wal->appended++;
+
+    short int flush = (!wal->window || wal->length >= WALBUFFER) ? (TRUE) : (FALSE),
+              failed = wal->failed;
+    pthread_mutex_unlock(&wal->lock);
+
+    // No window (or buffer full)- write out before returning
+    if (flush && WalFlush(wal) != OK) {
+        return ERROR;
+    }
+    return (failed) ? (ERROR) : (OK);
+}
+
+// Append record of mutation to node (path is taken from node- add records give parent and added key)
+int WalAppend(WAL *wal, const enum walOp op, const NODE *node, const char *text, const unsigned long integer) {
+    size_t pathLength = WalPathLength(node),
+           textLength = (text) ? (strlen(text)) : (0),
+           size = WalRecordSize(pathLength, textLength, integer);
+
+    pthread_mutex_lock(&wal->lock);
+    if (WalReserve(wal, size) != OK) {
+        pthread_mutex_unlock(&wal->lock);
+        return ERROR;
+    }
+    WalEncode(wal->buffer + wal->length, op, node, pathLength, text, textLength, integer);
+    return WalAppended(wal, size);
+}
+
+// Put bytes of record at cursor (usage is WalAppendInt)
+static void WalPut(void *context, const char *data, size_t length) {
+    char **cursor = context;
+
+    if (length) {
+        memcpy(*cursor, data, length);
+        *cursor += length;
+    }
+}
+
+// Append record setting integer of path to integer read under lock (updates in place- records follow the order of
+// their reads, so the last one holds the latest value, nothing is appended unless read returns TRUE)
+int WalAppendInt(WAL *wal, const char *path, const size_t pathLength, WALREAD read, void *context) {
+    unsigned long integer;
+
+    pthread_mutex_lock(&wal->lock);
+    if (!read(context, &integer)) {
+        pthread_mutex_unlock(&wal->lock);
+        return OK;
+    }
+
+    size_t size = WalRecordSize(pathLength, 0, integer);
+    if (WalReserve(wal, size) != OK) {
+        pthread_mutex_unlock(&wal->lock);
+        return ERROR;
+    }
+    char *cursor = wal->buffer + wal->length;
+    WalPutRecord(WalPut, &cursor, walSetInt, path, pathLength, NULL, 0, integer);
+    return WalAppended(wal, size);
+}
+
+// Write out and sync every record appended so far
+int WalSync(WAL *wal) {
+    if (WalFlush(wal) != OK || wal->failed) {
+        return ERROR;
+    }
+    return OK;
+}
+
+// Sync directory of file (makes rename durable)
+static int WalSyncDirectory(const char *fileName) {
+    const char *slash = strrchr(fileName, '/');
+    char *directory = (slash) ? (strndup(fileName, (size_t) (slash - fileName) + 1)) : (strdup("."));
+    int file = (directory) ? (open(directory, O_RDONLY)) : (-1);
+    short int iRc = (file >= 0 && fsync(file) == 0) ? (OK) : (ERROR);
+
+    if (file >= 0) {
+        close(file);
+    }
+    free(directory);
+    return iRc;
+}
+
+// Replace log by snapshot record and records from pin on (usage is WalCheckpointer, log is replaced by rename)
+static int WalReplace(WAL *wal) {
+    size_t snapshotLength = strlen(wal->pending),
+           size = WalRecordSize(0, snapshotLength, 0);
+    char *compact = malloc (strlen(wal->fileName) + 9),
+         *buffer = malloc ((size > SERIALBUFFER) ? (size) : (SERIALBUFFER));
+    short int iRc = OK;
+    int file = -1;
+
+    if (!compact || !buffer) {
+        fprintf(stderr, "\nLog error: allocating memory for checkpoint failed!\n");
+        free(compact);
+        free(buffer);
+        return ERROR;
+    }
+    sprintf(compact, "%s.compact", wal->fileName);
+
+    // New log starts with snapshot
+    file = open(compact, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    WalEncode(buffer, walSnapshot, NULL, 0, wal->pending, snapshotLength, 0);
+    if (file < 0 || write(file, buffer, size) != (ssize_t) size) {
+        iRc = ERROR;
+    }
+
+    // Writers go on appending to buffer meanwhile- only writing out waits
+    pthread_mutex_lock(&wal->io);
+    if (iRc == OK) {
+        iRc = WalWriteOut(wal, FALSE);
+    }
+
+    // Copy records from pin on
+    size_t offset = wal->boundary,
+           end = wal->written;
+    while (iRc == OK && offset < end) {
+        size_t length = (end - offset < SERIALBUFFER) ? (end - offset) : (SERIALBUFFER);
+        ssize_t bytes = pread(wal->file, buffer, length, (off_t) offset);
+        if (bytes <= 0 || write(file, buffer, (size_t) bytes) != bytes) {
+            iRc = ERROR;
+            break;
+        }
+        offset += (size_t) bytes;
+    }
+
+    if (iRc == OK && (fsync(file) != 0 || rename(compact, wal->fileName) != 0)) {
+        iRc = ERROR;
+    }
+
+    if (iRc == OK) {
+        WalSyncDirectory(wal->fileName);
+        close(wal->file);
+        wal->file = file;
+
+        pthread_mutex_lock(&wal->lock);
+        wal->written = size + (end - wal->boundary);
+        wal->limit = wal->written + LOGCOMPACT;
+        pthread_mutex_unlock(&wal->lock);
+
+        // Snapshot log referred to is no longer needed
+        if (wal->snapshot && strcmp(wal->snapshot, wal->pending) != 0) {
+            unlink(wal->snapshot);
+        }
+        free(wal->snapshot);
+        wal->snapshot = wal->pending;
+        wal->pending = NULL;
+    }
+    else {
+        fprintf(stderr, "\nLog error: problem writing compacted log (log is kept).\n");
+        if (file >= 0) {
+            close(file);
+        }
+        unlink(compact);
+    }
+    pthread_mutex_unlock(&wal->io);
+
+    free(compact);
+    free(buffer);
+    return iRc;
+}
+
+// Checkpointer thread (writes snapshot, then replaces log)
+static void *WalCheckpointer(void *argument) {
+    WAL *wal = argument;
+    short int iRc = ERROR;
+
+    if (wal->writer(wal->source, wal->pending) == OK) {
+        iRc = WalReplace(wal);
+    }
+    else {
+        fprintf(stderr, "\nLog error: writing snapshot failed (log is kept).\n");
+    }
+
+    // Failed snapshot is dropped (log still holds every record), next try waits for log to grow again
+    pthread_mutex_lock(&wal->lock);
+    if (iRc != OK) {
+        unlink(wal->pending);
+        free(wal->pending);
+        wal->pending = NULL;
+        wal->limit = wal->written + wal->length + LOGCOMPACT;
+    }
+    wal->running = FALSE;
+    pthread_mutex_unlock(&wal->lock);
+    return NULL;
+}
+
+// Check if checkpoint may start (none is running) and log has grown past limit (unless forced)
+int WalCompactDue(WAL *wal, const short int force) {
+    pthread_mutex_lock(&wal->lock);
+    int due = (!wal->running && !wal->closing && (force || wal->written + wal->length >= wal->limit)) ?
+              (TRUE) : (FALSE);
+    pthread_mutex_unlock(&wal->lock);
+    return due;
+}
+
+// Name of next snapshot (next to log, not the one log refers to- must be freed)
+char *WalSnapshotName(const WAL *wal) {
+    char *snapshot = malloc (strlen(wal->fileName) + 12);
+
+    if (snapshot) {
+        sprintf(snapshot, "%s.snapshot.0", wal->fileName);
+        if (wal->snapshot && strcmp(wal->snapshot, snapshot) == 0) {
+            snapshot[strlen(snapshot) - 1] = '1';
+        }
+    }
+    return snapshot;
+}
+
+// Start checkpoint of source (pinned by caller, writers held off until now- NULL if it couldn't be pinned)
+int WalCheckpointBegin(WAL *wal, SNAPSHOT writer, void *source, char *snapshot) {
+    // Previous checkpointer is done by now
+    WalCheckpointWait(wal);
+
+    pthread_mutex_lock(&wal->lock);
+    if (!source) {
+        wal->limit = wal->written + wal->length + LOGCOMPACT;
+        pthread_mutex_unlock(&wal->lock);
+        fprintf(stderr, "\nLog error: starting checkpoint failed.\n");
+        free(snapshot);
+        return ERROR;
+    }
+    wal->running = TRUE;
+    wal->writer = writer;
+    wal->source = source;
+    wal->boundary = wal->written + wal->length;
+    wal->pending = snapshot;
+    pthread_mutex_unlock(&wal->lock);
+
+    if (pthread_create(&wal->checkpointer, NULL, WalCheckpointer, wal) != 0) {
+        // No thread- checkpoint here instead
+        WalCheckpointer(wal);
+        return OK;
+    }
+    wal->joining = TRUE;
+    return OK;
+}
+
+// Wait for running checkpoint to finish
+int WalCheckpointWait(WAL *wal) {
+    if (wal->joining) {
+        pthread_join(wal->checkpointer, NULL);
+        wal->joining = FALSE;
+    }
+    return OK;
+}
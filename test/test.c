@@ -0,0 +1,551 @@
+//
+// Created by morten on 27.10.17.
+//
+
+/*
+ *  Tests:
+ *      Write-ahead log round trips- a tree is logged, the process "crashes" (a forked child exits without closing
+ *      the log), and a fresh tree replays the log. It must equal a tree given the same mutations without a log.
+ *      Covers replay, group commit, torn records at the end of the log and checkpoints (compacted logs).
+ *
+ *      Lock free reads- readers of a concurrent tree run alongside writers adding, setting and deleting the keys
+ *      they read. Every value read must be one a writer set.
+ *
+ *      Files are written to a temporary directory, which is removed afterwards.
+ *
+ *  Usage: test (exit status is 0 if every test passed)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "tree.h"
+
+// Defines number of mutations applied by each test
+#define MUTATIONS 2000
+
+// Defines number of threads mutating at once (group commit)
+#define WRITERS 4
+
+// Defines group commit window used by tests (microseconds)
+#define WINDOW 2000
+
+// Defines number of rounds each writer of reader test runs (a key is deleted, added and set per round)
+#define ROUNDS 20000
+
+// Defines number of keys each writer of reader test cycles through
+#define CYCLED 32
+
+// Defines number of threads reading at once (reader test)
+#define READERS 4
+
+// Writer thread of group commit test
+typedef struct _WRITERTASK {
+    NODE            **root;
+    int             from,
+                    to;
+} WRITERTASK;
+
+// Thread of reader test (writers are numbered, readers count the bad values they read)
+typedef struct _READERTASK {
+    NODE            **root;
+    int             number,
+                    *stop,
+                    bad;
+    unsigned long   reads;
+} READERTASK;
+
+static char directory[64];
+
+// Path of file in test directory (static buffer- valid until next call)
+static const char *TestFile(const char *name) {
+    static char path[320];
+
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    return path;
+}
+
+// Remove files of test directory
+static void TestClean(void) {
+    DIR *files = opendir(directory);
+    struct dirent *file;
+
+    while (files && (file = readdir(files))) {
+        if (strcmp(file->d_name, ".") != 0 && strcmp(file->d_name, "..") != 0) {
+            unlink(TestFile(file->d_name));
+        }
+    }
+    if (files) {
+        closedir(files);
+    }
+}
+
+// Apply mutation number i (the same for every tree- adds, sets and deletes)
+static void Mutate(NODE **root, const int i) {
+    char key[32],
+         parent[32],
+         string[64];
+
+    snprintf(key, sizeof(key), "k%d", i % 500);
+    snprintf(parent, sizeof(parent), "g%d", i % 7);
+    switch (i % 6) {
+        case 0:
+        case 1:
+            AddNode(root, parent, key);
+            break;
+        case 2:
+            SetInt(root, key, (unsigned long) i * 7919);
+            break;
+        case 3:
+            snprintf(string, sizeof(string), "string %d", i);
+            SetString(root, key, string);
+            break;
+        case 4:
+            AddNode(root, key, "leaf");
+            break;
+        default:
+            Delete(root, key);
+            break;
+    }
+}
+
+// Apply mutations from .. to (excl.)
+static void MutateRange(NODE **root, const int from, const int to) {
+    int i;
+
+    for (i = from; i < to; ++i) {
+        Mutate(root, i);
+    }
+}
+
+// Tree with parents every test mutates below (not logged)
+static NODE *TestTree(const unsigned int options) {
+    NODE *root = InitTreeEx(options);
+    char parent[32];
+    int i;
+
+    for (i = 0; i < 7; ++i) {
+        snprintf(parent, sizeof(parent), "g%d", i);
+        AddNode(&root, "root", parent);
+    }
+    return root;
+}
+
+// Append node to dump (depth, key, type and value- lengths given, so any key or string is told apart)
+static enum visitResult DumpVisitor(NODE *node, const unsigned long depth, void *context) {
+    FILE *dump = context;
+    const char *key = NodeKey(node);
+    enum nodeType type = NodeType(node);
+
+    fprintf(dump, "%lu %zu:%s %d ", depth, strlen(key), key, type);
+    if (type == stringNode) {
+        fprintf(dump, "%zu:%s\n", strlen(node->value.string), node->value.string);
+    }
+    else {
+        fprintf(dump, "%lu\n", (type == integerNode) ? (node->value.integer) : (0UL));
+    }
+    return visitContinue;
+}
+
+// Dump of tree (must be freed)
+static char *Dump(NODE **root) {
+    char *dump = NULL;
+    size_t length = 0;
+    FILE *stream = open_memstream(&dump, &length);
+
+    Traverse(root, DumpVisitor, stream, preOrder);
+    fclose(stream);
+    return dump;
+}
+
+// Check if logged tree replays to tree given mutations from .. to (excl.) without a log
+static int TestSame(const char *name, const unsigned int options, const char *log, const int from, const int to) {
+    NODE *expected = TestTree(options),
+         *replayed = TestTree(options);
+
+    MutateRange(&expected, from, to);
+
+    // Replay is quiet about mutations that failed when logged (they weren't logged)
+    int iRc = OpenLog(&replayed, log, WINDOW);
+    char *want = Dump(&expected),
+         *got = Dump(&replayed);
+
+    if (iRc == OK) {
+        iRc = (strcmp(want, got) == 0) ? (OK) : (ERROR);
+        CloseLog(&replayed);
+    }
+    printf("%-40s options %2u: %s\n", name, options, (iRc == OK) ? ("ok") : ("FAILED"));
+
+    free(want);
+    free(got);
+    DeinitTree(&expected);
+    DeinitTree(&replayed);
+    return iRc;
+}
+
+// Run mutations in forked child, which "crashes" (exits without closing log- after syncing it, if asked)
+static int TestCrash(const unsigned int options, const char *log, const int to, const int sync, const int checkpoint) {
+    fflush(NULL);
+    pid_t child = fork();
+
+    if (child == 0) {
+        NODE *root = TestTree(options);
+        int stderrFile = open("/dev/null", O_WRONLY);
+
+        // Mutations failing by design (keys deleted or added twice) write to stderr
+        dup2(stderrFile, STDERR_FILENO);
+        if (OpenLog(&root, log, WINDOW) != OK) {
+            _exit(1);
+        }
+        MutateRange(&root, 0, to / 2);
+        if (checkpoint && CheckpointLog(&root) != OK) {
+            _exit(1);
+        }
+        MutateRange(&root, to / 2, to);
+        if (sync && SyncLog(&root) != OK) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+
+    int status = 0;
+    return (child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0) ?
+           (OK) : (ERROR);
+}
+
+// Replay after crash (every mutation synced before crash is replayed)
+static int TestReplay(const unsigned int options) {
+    const char *log = TestFile("replay.log");
+    int iRc = TestCrash(options, log, MUTATIONS, TRUE, FALSE);
+
+    if (iRc != OK) {
+        printf("%-40s options %2u: FAILED (child)\n", "replay after crash", options);
+        return ERROR;
+    }
+    return TestSame("replay after crash", options, log, 0, MUTATIONS);
+}
+
+// Group commit writer (keys of its own, so threads don't depend on each other's order)
+static void *GroupWriter(void *argument) {
+    WRITERTASK *task = argument;
+    char key[32];
+    int i;
+
+    for (i = task->from; i < task->to; ++i) {
+        snprintf(key, sizeof(key), "w%d", i);
+        AddNode(task->root, "g0", key);
+        SetInt(task->root, key, (unsigned long) i);
+    }
+    return NULL;
+}
+
+// Group commit (several writers share syncs- every record appended before SyncLog is replayed)
+static int TestGroupCommit(const unsigned int options) {
+    const char *log = TestFile("group.log");
+    NODE *root = TestTree(options);
+    WRITERTASK tasks[WRITERS];
+    pthread_t threads[WRITERS];
+    int i,
+        iRc = OpenLog(&root, log, WINDOW);
+
+    // Trees that aren't concurrent take one writer at a time
+    int writers = (options & TREECONCURRENT) ? (WRITERS) : (1);
+    for (i = 0; iRc == OK && i < writers; ++i) {
+        tasks[i] = (WRITERTASK) { &root, i * (MUTATIONS / WRITERS), (i + 1) * (MUTATIONS / WRITERS) };
+        pthread_create(&threads[i], NULL, GroupWriter, &tasks[i]);
+    }
+    for (i = 0; iRc == OK && i < writers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    if (iRc == OK) {
+        iRc = SyncLog(&root);
+    }
+    char *want = Dump(&root);
+    if (iRc == OK) {
+        iRc = CloseLog(&root);
+    }
+
+    NODE *replayed = TestTree(options);
+    if (iRc == OK && OpenLog(&replayed, log, WINDOW) == OK) {
+        char *got = Dump(&replayed);
+        iRc = (strcmp(want, got) == 0) ? (OK) : (ERROR);
+        free(got);
+        CloseLog(&replayed);
+    }
+    else {
+        iRc = ERROR;
+    }
+    printf("%-40s options %2u: %s\n", "group commit", options, (iRc == OK) ? ("ok") : ("FAILED"));
+
+    free(want);
+    DeinitTree(&root);
+    DeinitTree(&replayed);
+    return iRc;
+}
+
+// Torn record at end of log (cut off when opened, the records before it are replayed)
+static int TestTornTail(const unsigned int options) {
+    const char *log = TestFile("torn.log");
+    NODE *root = TestTree(options);
+    struct stat status;
+    off_t whole = 0;
+
+    // Log every mutation but the last, then the last one- its record is torn below
+    if (OpenLog(&root, log, 0) != OK) {
+        printf("%-40s options %2u: FAILED (open)\n", "torn record at end of log", options);
+        DeinitTree(&root);
+        return ERROR;
+    }
+    MutateRange(&root, 0, MUTATIONS - 1);
+    SyncLog(&root);
+    stat(log, &status);
+    whole = status.st_size;
+    Mutate(&root, MUTATIONS - 1);
+    CloseLog(&root);
+    DeinitTree(&root);
+
+    // Cut last record short, as a crash while writing it would
+    stat(log, &status);
+    int iRc = (status.st_size > whole + 1 && truncate(log, status.st_size - 1) == 0) ? (OK) : (ERROR);
+    if (iRc == OK) {
+        iRc = TestSame("torn record at end of log", options, log, 0, MUTATIONS - 1);
+    }
+
+    // Torn record is gone from file
+    if (iRc == OK && (stat(log, &status) != 0 || status.st_size != whole)) {
+        printf("%-40s options %2u: FAILED (not cut off)\n", "torn record at end of log", options);
+        iRc = ERROR;
+    }
+    return iRc;
+}
+
+// Checkpoint round trip (log compacted into snapshot while writes go on, then crash)
+static int TestCheckpoint(const unsigned int options) {
+    const char *log = TestFile("checkpoint.log");
+    int iRc = TestCrash(options, log, MUTATIONS, TRUE, TRUE);
+
+    if (iRc != OK) {
+        printf("%-40s options %2u: FAILED (child)\n", "replay after checkpoint", options);
+        return ERROR;
+    }
+    return TestSame("replay after checkpoint", options, log, 0, MUTATIONS);
+}
+
+// Checkpoint, then close and reopen (log of a finished checkpoint starts with its snapshot)
+static int TestCheckpointClosed(const unsigned int options) {
+    const char *log = TestFile("closed.log");
+    NODE *root = TestTree(options);
+    int iRc = OpenLog(&root, log, WINDOW);
+
+    if (iRc == OK) {
+        MutateRange(&root, 0, MUTATIONS / 2);
+        iRc = CheckpointLog(&root);
+        MutateRange(&root, MUTATIONS / 2, MUTATIONS);
+        if (CloseLog(&root) != OK) {
+            iRc = ERROR;
+        }
+    }
+    DeinitTree(&root);
+
+    if (iRc != OK) {
+        printf("%-40s options %2u: FAILED (checkpoint)\n", "replay after checkpoint and close", options);
+        return ERROR;
+    }
+    return TestSame("replay after checkpoint and close", options, log, 0, MUTATIONS);
+}
+
+// Key k of writer (odd keys hold integer k, even keys string "v<k>"- 0 until set)
+static void CycledKey(char *key, const size_t size, const int writer, const int k) {
+    snprintf(key, size, "r%d_%d", writer, k);
+}
+
+// Writer of reader test (deletes, adds and sets its keys over and over- the index fills with tombstones and is rebuilt)
+static void *CycleWriter(void *argument) {
+    READERTASK *task = argument;
+    char key[32],
+         string[32];
+    int i,
+        k;
+
+    for (i = 0; i < ROUNDS; ++i) {
+        k = i % CYCLED;
+        CycledKey(key, sizeof(key), task->number, k);
+        Delete(task->root, key);
+        AddNode(task->root, "g1", key);
+        if (k % 2) {
+            SetInt(task->root, key, (unsigned long) k);
+        }
+        else {
+            snprintf(string, sizeof(string), "v%d", k);
+            SetString(task->root, key, string);
+        }
+    }
+    return NULL;
+}
+
+// Reader of reader test (keys and paths of every writer, values checked while strings are held by ReadLock)
+static void *CycleReader(void *argument) {
+    READERTASK *task = argument;
+    char key[64],
+         string[32];
+    DATA data;
+    unsigned long i;
+    int k;
+
+    for (i = (unsigned long) task->number; !__atomic_load_n(task->stop, __ATOMIC_ACQUIRE); ++i) {
+        k = (int) (i % CYCLED);
+        if (i % 2) {
+            CycledKey(key, sizeof(key), (int) (i / CYCLED) % 2, k);
+        }
+        else {
+            memcpy(key, "g1.", 3);
+            CycledKey(key + 3, sizeof(key) - 3, (int) (i / CYCLED) % 2, k);
+        }
+
+        ReadLock(task->root);
+        if (GetValue(task->root, key, &data)) {
+            snprintf(string, sizeof(string), "v%d", k);
+            if ((data.string && (k % 2 || strcmp(data.string, string) != 0))
+                || (!data.string && data.integer != 0 && (k % 2 == 0 || data.integer != (unsigned long) k))) {
+                task->bad++;
+            }
+        }
+        ReadUnlock(task->root);
+        task->reads++;
+    }
+    return NULL;
+}
+
+// Lock free reads of concurrent tree (readers find keys while writers delete, add and set them)
+static int TestConcurrentReads(const unsigned int options) {
+    NODE *root = TestTree(options);
+    READERTASK writers[2],
+               readers[READERS];
+    pthread_t writerThreads[2],
+              readerThreads[READERS];
+    int i,
+        stop = FALSE,
+        bad = 0;
+    unsigned long reads = 0;
+
+    for (i = 0; i < READERS; ++i) {
+        readers[i] = (READERTASK) { &root, i, &stop, 0, 0 };
+        pthread_create(&readerThreads[i], NULL, CycleReader, &readers[i]);
+    }
+    for (i = 0; i < 2; ++i) {
+        writers[i] = (READERTASK) { &root, i, &stop, 0, 0 };
+        pthread_create(&writerThreads[i], NULL, CycleWriter, &writers[i]);
+    }
+    for (i = 0; i < 2; ++i) {
+        pthread_join(writerThreads[i], NULL);
+    }
+    __atomic_store_n(&stop, TRUE, __ATOMIC_RELEASE);
+    for (i = 0; i < READERS; ++i) {
+        pthread_join(readerThreads[i], NULL);
+        bad += readers[i].bad;
+        reads += readers[i].reads;
+    }
+
+    int iRc = (bad == 0 && reads) ? (OK) : (ERROR);
+    printf("%-40s options %2u: %s\n", "lock free reads alongside writers", options, (iRc == OK) ? ("ok") : ("FAILED"));
+
+    DeinitTree(&root);
+    return iRc;
+}
+
+// Values a text snapshot can't hold (quotes, line breaks that read as further lines, empty strings)
+static void MutateValues(NODE **root) {
+    AddNode(root, "g0", "s0");
+    SetString(root, "s0", "say \"hi\"\nnext = 5");
+    AddNode(root, "g0", "s1");
+    SetString(root, "s1", "");
+    AddNode(root, "g1", "s2");
+    SetString(root, "s2", "\"\n\n\"\\\n");
+    AddNode(root, "g1", "odd \"key\" = 1");
+    SetInt(root, "odd \"key\" = 1", 42);
+}
+
+// Check if values of every kind survive a checkpoint (replayed from snapshot)
+static int TestCheckpointValues(const unsigned int options) {
+    const char *log = TestFile("values.log");
+    NODE *expected = TestTree(options),
+         *root = TestTree(options);
+    int iRc = OpenLog(&root, log, WINDOW);
+
+    if (iRc == OK) {
+        MutateValues(&root);
+        iRc = CheckpointLog(&root);
+        if (CloseLog(&root) != OK) {
+            iRc = ERROR;
+        }
+    }
+    DeinitTree(&root);
+
+    root = TestTree(options);
+    MutateValues(&expected);
+    if (iRc == OK) {
+        iRc = OpenLog(&root, log, WINDOW);
+    }
+
+    char *want = Dump(&expected),
+         *got = Dump(&root);
+    const char *string = (iRc == OK) ? (GetString(&root, "s0")) : (NULL);
+    if (iRc == OK) {
+        iRc = (strcmp(want, got) == 0 && string && strcmp(string, "say \"hi\"\nnext = 5") == 0) ? (OK) : (ERROR);
+        CloseLog(&root);
+    }
+    printf("%-40s options %2u: %s\n", "replay of quotes and line breaks", options, (iRc == OK) ? ("ok") : ("FAILED"));
+
+    free(want);
+    free(got);
+    DeinitTree(&expected);
+    DeinitTree(&root);
+    return iRc;
+}
+
+int main(void) {
+    const unsigned int options[] = { 0, TREECONCURRENT, TREEARENA | TREEINTERN },
+                       concurrent[] = { TREECONCURRENT, TREECONCURRENT | TREEARENA | TREEINTERN,
+                                        TREECONCURRENT | TREEART, TREECONCURRENT | TREEARENA | TREEINTERN | TREEART };
+    unsigned int i;
+    int failed = 0;
+
+    strcpy(directory, "/tmp/treetestXXXXXX");
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "\nTest error: problem creating temporary directory.\n");
+        return 1;
+    }
+
+    // Mutations failing by design (keys deleted or added twice) write to stderr
+    fflush(stderr);
+    int stderrCopy = dup(STDERR_FILENO),
+        stderrFile = open("/dev/null", O_WRONLY);
+    dup2(stderrFile, STDERR_FILENO);
+
+    for (i = 0; i < sizeof(options) / sizeof(options[0]); ++i) {
+        failed += TestReplay(options[i]) != OK;
+        failed += TestGroupCommit(options[i]) != OK;
+        failed += TestTornTail(options[i]) != OK;
+        failed += TestCheckpoint(options[i]) != OK;
+        failed += TestCheckpointClosed(options[i]) != OK;
+        failed += TestCheckpointValues(options[i]) != OK;
+        TestClean();
+    }
+    for (i = 0; i < sizeof(concurrent) / sizeof(concurrent[0]); ++i) {
+        failed += TestConcurrentReads(concurrent[i]) != OK;
+    }
+
+    dup2(stderrCopy, STDERR_FILENO);
+    close(stderrFile);
+    close(stderrCopy);
+    rmdir(directory);
+
+    printf("\n%s (%d failed)\n", (failed) ? ("FAILED") : ("All tests passed"), failed);
+    return (failed) ? (1) : (0);
+}